@@ -0,0 +1,408 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include "structs.h"
+#include "zosfs.h"
+#include "filesystem.h"
+#include "inodes.h"
+#include "clusters.h"
+
+
+// Mikrobenchmarky horkých cest fs. Výsledky jdou na stdout jako JSON (ns/op, u I/O i MB/s),
+// aby se daly porovnat mezi verzemi a mezi způsoby přístupu k obrazu (stdio/mmap).
+
+// velikost testovacího obrazu - řídký soubor, zapisuje se jen malá část
+#define BENCH_FS_SIZE (1024LL * 1024 * 1024)
+// výchozí minimální doba měření jednoho případu
+#define BENCH_MIN_MS 100
+// počet předem vylosovaných indexů pro náhodný přístup
+#define RANDOM_COUNT 4096
+// clustery pro I/O - celé v cache / výrazně větší než výchozí cache
+#define IO_HOT_CLUSTERS 256
+#define IO_STREAM_CLUSTERS 16384
+
+
+static double min_ns = BENCH_MIN_MS * 1e6;
+static bool first_result = true;
+static uint32_t rng_state = 2463534242u;
+static volatile int32_t sink;
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// xorshift - deterministický a levný oproti rand()
+static uint32_t next_random(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+// vypíše jeden výsledek, bytes > 0 přidá propustnost
+static void report(const char *engine, const char *bench, const char *param, const char *value,
+                   int64_t ops, double elapsed, int64_t bytes) {
+    //číselný parametr se vypíše jako číslo, ostatní jako řetězec
+    char *end;
+    strtol(value, &end, 10);
+    bool numeric = value[0] && *end == '\0';
+
+    printf("%s\n    {\"engine\": \"%s\", \"bench\": \"%s\", \"%s\": %s%s%s, \"ops\": %lld, \"ns_per_op\": %.1f",
+           first_result ? "" : ",", engine, bench, param,
+           numeric ? "" : "\"", value, numeric ? "" : "\"",
+           (long long)ops, ops > 0 ? elapsed / ops : 0.0);
+    if (bytes > 0) {
+        printf(", \"mb_per_s\": %.1f", bytes / (1024.0 * 1024.0) / (elapsed / 1e9));
+    }
+    printf("}");
+    fflush(stdout);
+    first_result = false;
+}
+
+static void report_int(const char *engine, const char *bench, const char *param, int64_t value,
+                       int64_t ops, double elapsed, int64_t bytes) {
+    char text[24];
+    snprintf(text, sizeof(text), "%lld", (long long)value);
+    report(engine, bench, param, text, ops, elapsed, bytes);
+}
+
+
+// alloc_cluster / alloc_inode při různém zaplnění
+typedef int32_t (*alloc_fn_t)(filesystem_t *fs);
+typedef void (*free_fn_t)(filesystem_t *fs, int32_t id);
+
+static void bench_alloc(filesystem_t *fs, const char *engine, const char *name,
+                        alloc_fn_t alloc, free_fn_t release, int32_t total) {
+    static const int fills[] = {0, 50, 90, 99};
+    int32_t *taken = malloc(total * sizeof(int32_t));
+    int32_t *batch = malloc(total * sizeof(int32_t));
+    if (!taken || !batch) {
+        free(taken);
+        free(batch);
+        return;
+    }
+
+    for (size_t f = 0; f < sizeof(fills) / sizeof(fills[0]); f++) {
+        //zaplnění celého prostoru a uvolnění náhodné části - volná místa jsou rozházená
+        int32_t count = 0, id;
+        while ((id = alloc(fs)) >= 0) taken[count++] = id;
+        int32_t kept = 0;
+        for (int32_t i = 0; i < count; i++) {
+            if ((int)(next_random() % 100) < fills[f]) taken[kept++] = taken[i];
+            else release(fs, taken[i]);
+        }
+        count = kept;
+        //uvolněné clustery alokátor přidělí, až je uvolnění trvalé
+        zosfs_sync(fs);
+
+        //měří se alokace poloviny volného místa (nejvýš 50000), potom se vrátí
+        int32_t ops = (total - count) / 2;
+        if (ops > 50000) ops = 50000;
+        if (ops < 1) ops = 1;
+        int32_t done = 0;
+        double start = now_ns();
+        while (done < ops && (id = alloc(fs)) >= 0) batch[done++] = id;
+        double elapsed = now_ns() - start;
+        for (int32_t i = 0; i < done; i++) release(fs, batch[i]);
+
+        report_int(engine, name, "fill_pct", fills[f], done, elapsed, 0);
+
+        for (int32_t i = 0; i < count; i++) release(fs, taken[i]);
+        zosfs_sync(fs);
+    }
+    free(taken);
+    free(batch);
+}
+
+
+// find_in_dir / add_to_dir pro adresáře různé velikosti
+static void bench_dirs(session_t *session, const char *engine) {
+    static const int32_t sizes[] = {10, 100, 1000, 10000, 100000};
+    filesystem_t *fs = session->fs;
+
+    //všechny položky ukazují na jeden soubor
+    zosfs_file_t target;
+    if (zosfs_create(session, "target", &target) != ZOSFS_OK) return;
+
+    int32_t max_size = sizes[sizeof(sizes) / sizeof(sizes[0]) - 1];
+    char (*names)[NAME_SIZE] = malloc(max_size * sizeof(*names));
+    char (*extra)[NAME_SIZE] = malloc(1000 * sizeof(*extra));
+    int32_t *picks = malloc(RANDOM_COUNT * sizeof(int32_t));
+    if (!names || !extra || !picks) goto done;
+    for (int32_t i = 0; i < max_size; i++) snprintf(names[i], NAME_SIZE, "e%d", i);
+    for (int32_t i = 0; i < 1000; i++) snprintf(extra[i], NAME_SIZE, "n%d", i);
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        int32_t size = sizes[s];
+        char path[NAME_SIZE];
+        snprintf(path, sizeof(path), "d%d", size);
+        if (zosfs_mkdir(session, path) != ZOSFS_OK) break;
+        int32_t dir = resolve_path(fs, session->current_inode, path);
+        for (int32_t i = 0; i < size; i++) add_to_dir(fs, dir, names[i], target.inode);
+        zosfs_sync(fs);
+
+        //nalezené jméno
+        for (int32_t i = 0; i < RANDOM_COUNT; i++) picks[i] = next_random() % size;
+        int64_t ops = 0;
+        double start = now_ns(), elapsed;
+        do {
+            for (int32_t i = 0; i < RANDOM_COUNT; i++) sink = find_in_dir(fs, dir, names[picks[i]]);
+            ops += RANDOM_COUNT;
+        } while ((elapsed = now_ns() - start) < min_ns);
+        report_int(engine, "find_in_dir", "size", size, ops, elapsed, 0);
+
+        //jméno, které v adresáři není
+        ops = 0;
+        start = now_ns();
+        do {
+            for (int32_t i = 0; i < 1000; i++) sink = find_in_dir(fs, dir, extra[i]);
+            ops += 1000;
+        } while ((elapsed = now_ns() - start) < min_ns);
+        report_int(engine, "find_in_dir_miss", "size", size, ops, elapsed, 0);
+
+        //první hledání po zahození indexu - sestavení indexu čtením adresáře
+        ops = 0;
+        elapsed = 0;
+        do {
+            forget_dir(fs, dir);
+            start = now_ns();
+            sink = find_in_dir(fs, dir, names[0]);
+            elapsed += now_ns() - start;
+            ops++;
+        } while (elapsed < min_ns && ops < 1000);
+        report_int(engine, "find_in_dir_cold", "size", size, ops, elapsed, 0);
+
+        //přidání nových jmen, mezi koly se zase odeberou (mimo měření)
+        int32_t round = size < 1000 ? size : 1000;
+        ops = 0;
+        elapsed = 0;
+        do {
+            start = now_ns();
+            for (int32_t i = 0; i < round; i++) add_to_dir(fs, dir, extra[i], target.inode);
+            elapsed += now_ns() - start;
+            ops += round;
+            for (int32_t i = 0; i < round; i++) remove_from_dir(fs, dir, extra[i]);
+        } while (elapsed < min_ns);
+        report_int(engine, "add_to_dir", "size", size, ops, elapsed, 0);
+        zosfs_sync(fs);
+    }
+
+done:
+    free(names);
+    free(extra);
+    free(picks);
+}
+
+
+// resolve_path pro absolutní cesty hloubky 1-32
+static void bench_paths(session_t *session, const char *engine) {
+    static const int32_t depths[] = {1, 2, 4, 8, 16, 32};
+    char path[256] = "";
+    int32_t depth = 0;
+
+    for (size_t d = 0; d < sizeof(depths) / sizeof(depths[0]); d++) {
+        while (depth < depths[d]) {
+            depth++;
+            size_t len = strlen(path);
+            snprintf(path + len, sizeof(path) - len, "/p%d", depth);
+            if (zosfs_mkdir(session, path) != ZOSFS_OK) return;
+        }
+        zosfs_sync(session->fs);
+
+        int64_t ops = 0;
+        double start = now_ns(), elapsed;
+        do {
+            for (int32_t i = 0; i < 1000; i++) sink = resolve_path(session->fs, session->current_inode, path);
+            ops += 1000;
+        } while ((elapsed = now_ns() - start) < min_ns);
+        report_int(engine, "resolve_path", "depth", depth, ops, elapsed, 0);
+    }
+}
+
+
+// náhodné get_file_cluster v rozsahu first..last-1
+static void bench_lookup_range(filesystem_t *fs, inode_t *inode, const char *engine,
+                               const char *range, int32_t first, int32_t last) {
+    int32_t picks[RANDOM_COUNT];
+    for (int32_t i = 0; i < RANDOM_COUNT; i++) picks[i] = first + next_random() % (last - first);
+
+    int64_t ops = 0;
+    double start = now_ns(), elapsed;
+    do {
+        for (int32_t i = 0; i < RANDOM_COUNT; i++) sink = get_file_cluster(fs, inode, picks[i]);
+        ops += RANDOM_COUNT;
+    } while ((elapsed = now_ns() - start) < min_ns);
+    report(engine, "get_file_cluster", "range", range, ops, elapsed, 0);
+}
+
+// get_file_cluster v přímých a nepřímých odkazech a v úsecích (inline / ve stromu)
+static void bench_file_map(session_t *session, const char *engine) {
+    filesystem_t *fs = session->fs;
+    int32_t indirect2_start = DIRECT_LINKS + PTRS_PER_CLUSTER;
+    int32_t count = indirect2_start + 4 * PTRS_PER_CLUSTER;
+
+    //soubor ve formátu přímých a nepřímých odkazů
+    zosfs_file_t file;
+    inode_t inode;
+    if (zosfs_create(session, "blockmap", &file) != ZOSFS_OK || !read_inode(fs, file.inode, &inode)) return;
+    memset(inode.map, 0, sizeof(inode.map));
+    inode.format = INODE_FORMAT_BLOCKMAP;
+    for (int32_t i = 0; i < count; i++) {
+        int32_t cluster = alloc_cluster(fs);
+        if (cluster < 0 || set_file_cluster(fs, &inode, i, cluster) < 0) return;
+    }
+    inode.file_size = (int64_t)count * CLUSTER_SIZE;
+    write_inode(fs, file.inode, &inode);
+    zosfs_sync(fs);
+
+    bench_lookup_range(fs, &inode, engine, "direct", 0, DIRECT_LINKS);
+    bench_lookup_range(fs, &inode, engine, "indirect1", DIRECT_LINKS, indirect2_start);
+    bench_lookup_range(fs, &inode, engine, "indirect2", indirect2_start, count);
+
+    //soubor z úseků po 16 clusterech oddělených volným clusterem - úseky se nespojí
+    if (zosfs_create(session, "extents", &file) != ZOSFS_OK || !read_inode(fs, file.inode, &inode)) return;
+    int32_t runs = count / 16;
+    for (int32_t r = 0; r < runs; r++) {
+        cluster_run_t *allocated;
+        int32_t run_count = alloc_clusters(fs, 17, 0, &allocated);
+        if (run_count < 0) return;
+        int32_t start = allocated[0].start, length = allocated[0].length;
+        free(allocated);
+        if (length < 17 || set_file_run(fs, &inode, r * 16, start, 16) < 0) return;
+    }
+    inode.file_size = (int64_t)runs * 16 * CLUSTER_SIZE;
+    write_inode(fs, file.inode, &inode);
+    zosfs_sync(fs);
+    if (inode.format != INODE_FORMAT_EXTENTS) return;
+
+    int32_t inline_end = inode.extents[INLINE_EXTENTS - 1].logical + inode.extents[INLINE_EXTENTS - 1].length;
+    bench_lookup_range(fs, &inode, engine, "extent_inline", 0, inline_end);
+    bench_lookup_range(fs, &inode, engine, "extent_tree", inline_end, runs * 16);
+}
+
+
+// propustnost read_cluster/write_cluster
+static void bench_io_set(filesystem_t *fs, const char *engine, const char *set, const int32_t *clusters, int32_t count) {
+    uint8_t buffer[CLUSTER_SIZE];
+    for (int32_t i = 0; i < CLUSTER_SIZE; i++) buffer[i] = next_random();
+
+    //celé průchody sadou, aspoň jeden i u velké sady
+    int64_t ops = 0;
+    double start = now_ns(), elapsed;
+    do {
+        for (int32_t i = 0; i < count; i++) {
+            buffer[0] = i;
+            write_cluster(fs, clusters[i], buffer);
+        }
+        ops += count;
+    } while ((elapsed = now_ns() - start) < min_ns);
+    report(engine, "write_cluster", "set", set, ops, elapsed, ops * CLUSTER_SIZE);
+    zosfs_sync(fs);
+
+    ops = 0;
+    start = now_ns();
+    do {
+        for (int32_t i = 0; i < count; i++) {
+            read_cluster(fs, clusters[i], buffer);
+            sink = buffer[0];
+        }
+        ops += count;
+    } while ((elapsed = now_ns() - start) < min_ns);
+    report(engine, "read_cluster", "set", set, ops, elapsed, ops * CLUSTER_SIZE);
+}
+
+static void bench_io(filesystem_t *fs, const char *engine) {
+    int32_t *clusters = malloc(IO_STREAM_CLUSTERS * sizeof(int32_t));
+    if (!clusters) return;
+    for (int32_t i = 0; i < IO_STREAM_CLUSTERS; i++) {
+        clusters[i] = alloc_cluster(fs);
+        if (clusters[i] < 0) {
+            free(clusters);
+            return;
+        }
+    }
+
+    //hot se vejde do cache, stream ji několikrát přeplní (u stdio se měří i vyhazování)
+    bench_io_set(fs, engine, "hot", clusters, IO_HOT_CLUSTERS);
+    bench_io_set(fs, engine, "stream", clusters, IO_STREAM_CLUSTERS);
+    free(clusters);
+}
+
+
+// celá sada nad nově naformátovaným obrazem
+static bool run_engine(const char *image, zosfs_engine_t engine) {
+    const char *engine_name = engine == ZOSFS_ENGINE_MMAP ? "mmap" : "stdio";
+    zosfs_options_t options;
+    zosfs_default_options(&options);
+    options.engine = engine;
+    //metadata se zapisují jen při explicitním zosfs_sync mimo měření
+    options.sync_policy = ZOSFS_SYNC_MANUAL;
+
+    remove(image);
+    zosfs_t *fs;
+    zosfs_session_t *session = NULL;
+    zosfs_status_t status = zosfs_mount(image, &options, &fs, NULL);
+    if (status == ZOSFS_OK || status == ZOSFS_ENOTFORMATTED) status = zosfs_session_open(fs, &session);
+    if (status == ZOSFS_OK) status = zosfs_format(session, BENCH_FS_SIZE);
+    if (status != ZOSFS_OK) {
+        fprintf(stderr, "%s: %s\n", image, zosfs_strerror(status));
+        zosfs_session_close(session);
+        zosfs_unmount(fs);
+        remove(image);
+        return false;
+    }
+
+    bench_alloc(fs, engine_name, "alloc_cluster", alloc_cluster, free_cluster, fs->sb.cluster_count);
+    bench_alloc(fs, engine_name, "alloc_inode", alloc_inode, free_inode, fs->sb.inode_count);
+    zosfs_sync(fs);
+    bench_dirs(session, engine_name);
+    bench_paths(session, engine_name);
+    bench_file_map(session, engine_name);
+    bench_io(fs, engine_name);
+
+    zosfs_session_close(session);
+    zosfs_unmount(fs);
+    remove(image);
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    const char *image = "bench.img";
+    bool stdio_engine = true, mmap_engine = true;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-e") == 0 && i + 1 < argc) {
+            //jen jeden způsob přístupu: stdio nebo mmap
+            i++;
+            stdio_engine = strcmp(argv[i], "stdio") == 0;
+            mmap_engine = strcmp(argv[i], "mmap") == 0;
+            if (!stdio_engine && !mmap_engine) {
+                fprintf(stderr, "Neznámý způsob přístupu '%s'\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            //minimální doba měření jednoho případu v ms
+            int ms;
+            if (sscanf(argv[++i], "%d", &ms) != 1 || ms < 1) {
+                fprintf(stderr, "Neplatná doba měření '%s'\n", argv[i]);
+                return 1;
+            }
+            min_ns = ms * 1e6;
+        } else {
+            image = argv[i];
+        }
+    }
+
+    printf("{\n  \"cluster_size\": %d,\n  \"fs_size\": %lld,\n  \"min_ms\": %.0f,\n  \"results\": [",
+           CLUSTER_SIZE, (long long)BENCH_FS_SIZE, min_ns / 1e6);
+    bool ok = true;
+    if (stdio_engine) ok = run_engine(image, ZOSFS_ENGINE_STDIO) && ok;
+    if (mmap_engine) ok = run_engine(image, ZOSFS_ENGINE_MMAP) && ok;
+    printf("\n  ]\n}\n");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,302 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "structs.h"
+#include "bitmap.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_AVX2_KERNEL 1
+#endif
+
+
+#define WORD_BITS 64
+#define FULL_WORD UINT64_MAX
+
+
+// nastaví souhrnný bit slova podle toho, zda slovo obsahuje volný bit
+static void update_summary(bitmap_t *bitmap, int32_t word) {
+    uint64_t mask = 1ULL << (word % WORD_BITS);
+
+    if (bitmap->words[word] == FULL_WORD) {
+        bitmap->summary[word / WORD_BITS] &= ~mask;
+    } else {
+        bitmap->summary[word / WORD_BITS] |= mask;
+    }
+}
+
+// označí úsek s daným bitem jako změněný
+static void mark_dirty(bitmap_t *bitmap, int32_t index) {
+    bitmap->dirty[index / 8 / BITMAP_DIRTY_CHUNK] = 1;
+    bitmap->any_dirty = true;
+}
+
+static uint64_t popcount_scalar(const uint64_t *words, int32_t count) {
+    uint64_t total = 0;
+    for (int32_t i = 0; i < count; i++) {
+        total += __builtin_popcountll(words[i]);
+    }
+    return total;
+}
+
+#ifdef HAVE_AVX2_KERNEL
+// počty bitů po půlbytech přes tabulku v registru (vpshufb), součty bytů přes vpsadbw
+__attribute__((target("avx2")))
+static uint64_t popcount_avx2(const uint64_t *words, int32_t count) {
+    const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low_mask = _mm256_set1_epi8(0x0f);
+    __m256i total = _mm256_setzero_si256();
+    int32_t i = 0;
+
+    while (i + 4 <= count) {
+        //bytové čítače přetečou nejdříve po 31 krocích (8 bitů na byte za krok)
+        int32_t end = count - i > 4 * 31 ? i + 4 * 31 : count;
+        __m256i bytes = _mm256_setzero_si256();
+        for (; i + 4 <= end; i += 4) {
+            __m256i v = _mm256_loadu_si256((const __m256i *)(words + i));
+            __m256i low = _mm256_and_si256(v, low_mask);
+            __m256i high = _mm256_and_si256(_mm256_srli_epi16(v, 4), low_mask);
+            bytes = _mm256_add_epi8(bytes, _mm256_add_epi8(_mm256_shuffle_epi8(lookup, low),
+                                                           _mm256_shuffle_epi8(lookup, high)));
+        }
+        total = _mm256_add_epi64(total, _mm256_sad_epu8(bytes, _mm256_setzero_si256()));
+    }
+
+    uint64_t lanes[4];
+    _mm256_storeu_si256((__m256i *)lanes, total);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + popcount_scalar(words + i, count - i);
+}
+#endif
+
+uint64_t popcount_words(const uint64_t *words, int32_t count) {
+#ifdef HAVE_AVX2_KERNEL
+    if (__builtin_cpu_supports("avx2")) return popcount_avx2(words, count);
+#endif
+    return popcount_scalar(words, count);
+}
+
+bitmap_t *bitmap_create(int32_t bit_count) {
+    bitmap_t *bitmap = calloc(1, sizeof(bitmap_t));
+    if (!bitmap) return NULL;
+
+    bitmap->bit_count = bit_count;
+    bitmap->word_count = (bit_count + WORD_BITS - 1) / WORD_BITS;
+    bitmap->summary_count = (bitmap->word_count + WORD_BITS - 1) / WORD_BITS;
+    //alespoň jedno slovo, aby nebylo nutné ošetřovat prázdnou bitmapu
+    bitmap->words = calloc(bitmap->word_count + 1, sizeof(uint64_t));
+    bitmap->summary = calloc(bitmap->summary_count + 1, sizeof(uint64_t));
+    bitmap->dirty_count = (bitmap_bytes(bitmap) + BITMAP_DIRTY_CHUNK - 1) / BITMAP_DIRTY_CHUNK;
+    bitmap->dirty = calloc(bitmap->dirty_count + 1, 1);
+
+    if (!bitmap->words || !bitmap->summary || !bitmap->dirty) {
+        bitmap_destroy(bitmap);
+        return NULL;
+    }
+
+    bitmap_rebuild_summary(bitmap);
+    bitmap_mark_all_dirty(bitmap);
+    return bitmap;
+}
+
+void bitmap_destroy(bitmap_t *bitmap) {
+    if (!bitmap) return;
+    free(bitmap->words);
+    free(bitmap->summary);
+    free(bitmap->dirty);
+    free(bitmap->reserved);
+    free(bitmap);
+}
+
+int32_t bitmap_bytes(const bitmap_t *bitmap) {
+    return (bitmap->bit_count + 7) / 8;
+}
+
+void bitmap_mark_all_dirty(bitmap_t *bitmap) {
+    memset(bitmap->dirty, 1, bitmap->dirty_count);
+    bitmap->any_dirty = bitmap->dirty_count > 0;
+}
+
+bool bitmap_next_dirty(const bitmap_t *bitmap, int32_t *pos, int32_t *offset, int32_t *size) {
+    int32_t chunk = *pos / BITMAP_DIRTY_CHUNK;
+    while (chunk < bitmap->dirty_count && !bitmap->dirty[chunk]) chunk++;
+    if (chunk >= bitmap->dirty_count) return false;
+
+    //sousední změněné úseky se zapíší jedním zápisem
+    int32_t end = chunk;
+    while (end < bitmap->dirty_count && bitmap->dirty[end]) end++;
+
+    *offset = chunk * BITMAP_DIRTY_CHUNK;
+    *size = end * BITMAP_DIRTY_CHUNK;
+    if (*size > bitmap_bytes(bitmap)) *size = bitmap_bytes(bitmap);
+    *size -= *offset;
+    *pos = end * BITMAP_DIRTY_CHUNK;
+    return true;
+}
+
+int32_t bitmap_dirty_bytes(const bitmap_t *bitmap) {
+    if (!bitmap->any_dirty) return 0;
+    int32_t chunks = 0;
+    for (int32_t i = 0; i < bitmap->dirty_count; i++) {
+        if (bitmap->dirty[i]) chunks++;
+    }
+    return chunks * BITMAP_DIRTY_CHUNK;
+}
+
+void bitmap_clear_dirty(bitmap_t *bitmap) {
+    memset(bitmap->dirty, 0, bitmap->dirty_count);
+    bitmap->any_dirty = false;
+}
+
+void bitmap_rebuild_summary(bitmap_t *bitmap) {
+    //bity za koncem bitmapy jsou vždy obsazené, aby je hledání nikdy nevrátilo
+    int32_t tail = bitmap->bit_count % WORD_BITS;
+    if (tail != 0) {
+        bitmap->words[bitmap->word_count - 1] |= FULL_WORD << tail;
+    }
+
+    memset(bitmap->summary, 0, bitmap->summary_count * sizeof(uint64_t));
+    for (int32_t w = 0; w < bitmap->word_count; w++) {
+        update_summary(bitmap, w);
+    }
+
+    //obsazené bity za koncem se nepočítají
+    int32_t padding = bitmap->word_count * WORD_BITS - bitmap->bit_count;
+    bitmap->used = popcount_words(bitmap->words, bitmap->word_count) - padding;
+}
+
+int32_t bitmap_used(const bitmap_t *bitmap) {
+    return bitmap->used;
+}
+
+// slovo pro hledání - rezervované bity se berou jako obsazené
+static inline uint64_t taken_word(const bitmap_t *bitmap, int32_t word) {
+    if (bitmap->reserved_count == 0) return bitmap->words[word];
+    return bitmap->words[word] | bitmap->reserved[word];
+}
+
+// první volný bit na pozici >= start, bez přetečení
+static int32_t find_free_from(const bitmap_t *bitmap, int32_t start) {
+    if (start >= bitmap->bit_count) return -1;
+
+    //zbytek počátečního slova
+    int32_t word = start / WORD_BITS;
+    uint64_t free_bits = ~taken_word(bitmap, word) & (FULL_WORD << (start % WORD_BITS));
+    if (free_bits) {
+        return word * WORD_BITS + __builtin_ctzll(free_bits);
+    }
+
+    //další slova hledáme přes souhrnnou bitmapu
+    word++;
+    if (word >= bitmap->word_count) return -1;
+
+    int32_t s = word / WORD_BITS;
+    uint64_t summary = bitmap->summary[s] & (FULL_WORD << (word % WORD_BITS));
+    while (1) {
+        while (summary) {
+            int32_t w = s * WORD_BITS + __builtin_ctzll(summary);
+            //souhrn nezná rezervace - slovo s jen rezervovanými volnými bity se přeskočí
+            free_bits = ~taken_word(bitmap, w);
+            if (free_bits) return w * WORD_BITS + __builtin_ctzll(free_bits);
+            summary &= summary - 1;
+        }
+        if (++s >= bitmap->summary_count) return -1;
+        summary = bitmap->summary[s];
+    }
+}
+
+// první obsazený bit na pozici >= start, bit_count pokud až do konce nic obsazeno není
+static int32_t find_used_from(const bitmap_t *bitmap, int32_t start) {
+    int32_t word = start / WORD_BITS;
+    uint64_t used_bits = taken_word(bitmap, word) & (FULL_WORD << (start % WORD_BITS));
+    while (!used_bits) {
+        if (++word >= bitmap->word_count) return bitmap->bit_count;
+        used_bits = taken_word(bitmap, word);
+    }
+
+    int32_t index = word * WORD_BITS + __builtin_ctzll(used_bits);
+    return index < bitmap->bit_count ? index : bitmap->bit_count;
+}
+
+int32_t bitmap_free_run(const bitmap_t *bitmap, int32_t start, int32_t *length) {
+    if (start < 0) start = 0;
+
+    int32_t first = find_free_from(bitmap, start);
+    if (first < 0) return -1;
+    *length = find_used_from(bitmap, first) - first;
+    return first;
+}
+
+int32_t bitmap_find_free(const bitmap_t *bitmap, int32_t start) {
+    if (start < 0 || start >= bitmap->bit_count) start = 0;
+
+    int32_t index = find_free_from(bitmap, start);
+    if (index < 0 && start > 0) {
+        index = find_free_from(bitmap, 0);
+    }
+    return index;
+}
+
+bool is_bit_set(const bitmap_t *bitmap, int32_t index) {
+    return (bitmap->words[index / WORD_BITS] >> (index % WORD_BITS)) & 1;
+}
+
+void set_bit(bitmap_t *bitmap, int32_t index) {
+    int32_t word = index / WORD_BITS;
+
+    if (!is_bit_set(bitmap, index)) bitmap->used++;
+    bitmap->words[word] |= 1ULL << (index % WORD_BITS);
+    mark_dirty(bitmap, index);
+    if (bitmap->words[word] == FULL_WORD) {
+        update_summary(bitmap, word);
+    }
+}
+
+void clear_bit(bitmap_t *bitmap, int32_t index) {
+    int32_t word = index / WORD_BITS;
+
+    if (is_bit_set(bitmap, index)) bitmap->used--;
+    bitmap->words[word] &= ~(1ULL << (index % WORD_BITS));
+    mark_dirty(bitmap, index);
+    update_summary(bitmap, word);
+}
+
+bool bitmap_reserve(bitmap_t *bitmap, int32_t index) {
+    if (!bitmap->reserved) {
+        bitmap->reserved = calloc(bitmap->word_count + 1, sizeof(uint64_t));
+        if (!bitmap->reserved) return false;
+    }
+
+    uint64_t mask = 1ULL << (index % WORD_BITS);
+    if (!(bitmap->reserved[index / WORD_BITS] & mask)) bitmap->reserved_count++;
+    bitmap->reserved[index / WORD_BITS] |= mask;
+    return true;
+}
+
+void bitmap_unreserve(bitmap_t *bitmap, int32_t index) {
+    uint64_t mask = 1ULL << (index % WORD_BITS);
+    if (!bitmap->reserved || !(bitmap->reserved[index / WORD_BITS] & mask)) return;
+    bitmap->reserved[index / WORD_BITS] &= ~mask;
+    bitmap->reserved_count--;
+}
+
+void bitmap_set_range(bitmap_t *bitmap, int32_t start, int32_t length) {
+    if (length <= 0) return;
+
+    int32_t end = start + length;
+    for (int32_t word = start / WORD_BITS; word * WORD_BITS < end; word++) {
+        int32_t from = word * WORD_BITS > start ? 0 : start % WORD_BITS;
+        int32_t to = (word + 1) * WORD_BITS < end ? WORD_BITS : end - word * WORD_BITS;
+        uint64_t mask = (to - from == WORD_BITS) ? FULL_WORD : ((1ULL << (to - from)) - 1) << from;
+
+        bitmap->used += __builtin_popcountll(mask & ~bitmap->words[word]);
+        bitmap->words[word] |= mask;
+        update_summary(bitmap, word);
+    }
+
+    for (int32_t chunk = start / 8 / BITMAP_DIRTY_CHUNK; chunk <= (end - 1) / 8 / BITMAP_DIRTY_CHUNK; chunk++) {
+        bitmap->dirty[chunk] = 1;
+    }
+    bitmap->any_dirty = true;
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include "structs.h"
+#include <stdbool.h>
+
+// Vytvoří bitmapu se zadaným počtem bitů, všechny bity jsou volné
+bitmap_t *bitmap_create(int32_t bit_count);
+
+// Uvolní paměť bitmapy
+void bitmap_destroy(bitmap_t *bitmap);
+
+// Velikost bitmapy na disku v bytech
+int32_t bitmap_bytes(const bitmap_t *bitmap);
+
+// Označí celou bitmapu jako změněnou (nová bitmapa ještě není na disku)
+void bitmap_mark_all_dirty(bitmap_t *bitmap);
+
+// Vrátí další souvislý změněný úsek od pozice *pos (v bytech), false pokud už žádný není
+bool bitmap_next_dirty(const bitmap_t *bitmap, int32_t *pos, int32_t *offset, int32_t *size);
+
+// Počet bytů změněných úseků, které čekají na uložení
+int32_t bitmap_dirty_bytes(const bitmap_t *bitmap);
+
+// Zapomene všechny změny (po uložení na disk)
+void bitmap_clear_dirty(bitmap_t *bitmap);
+
+// Přepočítá souhrnnou bitmapu a počet nastavených bitů po načtení slov z disku
+void bitmap_rebuild_summary(bitmap_t *bitmap);
+
+// Počet nastavených bitů (udržovaný při každé změně, O(1))
+int32_t bitmap_used(const bitmap_t *bitmap);
+
+// Spočítá nastavené bity v poli slov (AVX2, pokud ho procesor má, jinak skalárně)
+uint64_t popcount_words(const uint64_t *words, int32_t count);
+
+// Najde první volný bit od pozice start (s přetečením na začátek), -1 pokud není volný žádný
+int32_t bitmap_find_free(const bitmap_t *bitmap, int32_t start);
+
+// Najde první volný úsek od pozice start (bez přetečení), do *length uloží jeho délku, -1 pokud není
+int32_t bitmap_free_run(const bitmap_t *bitmap, int32_t start, int32_t *length);
+
+// Rezervuje volný bit - hledání ho přeskočí, bitmapa, její změny ani počet obsazených se nemění
+bool bitmap_reserve(bitmap_t *bitmap, int32_t index);
+
+// Zruší rezervaci bitu
+void bitmap_unreserve(bitmap_t *bitmap, int32_t index);
+
+// Nastaví souvislý úsek bitů na 1
+void bitmap_set_range(bitmap_t *bitmap, int32_t start, int32_t length);
+
+//testování hodnoty bitu
+bool is_bit_set(const bitmap_t *bitmap, int32_t index);
+
+//nastavení hodnoty bitu na 1
+void set_bit(bitmap_t *bitmap, int32_t index);
+
+//vymazání hodnoty bitu (nastavení na 0)
+void clear_bit(bitmap_t *bitmap, int32_t index);
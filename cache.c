@@ -0,0 +1,265 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "structs.h"
+#include "cache.h"
+#include "clusters.h"
+#include "filesystem.h"
+#include "locks.h"
+
+
+static int32_t hash_cluster(const cluster_cache_t *cache, int32_t cluster_num) {
+    return ((uint32_t)cluster_num * 2654435761u) & cache->bucket_mask;
+}
+
+static cache_entry_t *lookup(cluster_cache_t *cache, int32_t cluster_num) {
+    cache_entry_t *entry = cache->buckets[hash_cluster(cache, cluster_num)];
+    while (entry && entry->cluster != cluster_num) {
+        entry = entry->next;
+    }
+    return entry;
+}
+
+static void unlink_entry(cluster_cache_t *cache, cache_entry_t *entry) {
+    cache_entry_t **link = &cache->buckets[hash_cluster(cache, entry->cluster)];
+    while (*link != entry) {
+        link = &(*link)->next;
+    }
+    *link = entry->next;
+    entry->next = NULL;
+}
+
+static bool write_back(filesystem_t *fs, cache_entry_t *entry) {
+    if (!write_bytes(fs, cluster_offset(fs, entry->cluster), entry->data, fs->sb.cluster_size)) {
+        return false;
+    }
+    entry->dirty = false;
+    fs->cache->writebacks++;
+    return true;
+}
+
+// najde volnou položku nebo vyřadí nepřipnutou položku algoritmem CLOCK
+static cache_entry_t *find_victim(filesystem_t *fs) {
+    cluster_cache_t *cache = fs->cache;
+
+    //dvě otáčky stačí - v první se nulují příznaky použití
+    for (int32_t i = 0; i < 2 * cache->capacity; i++) {
+        cache_entry_t *entry = &cache->entries[cache->hand];
+        cache->hand = (cache->hand + 1) % cache->capacity;
+
+        if (entry->cluster < 0) return entry;
+        if (entry->pins > 0) continue;
+        if (entry->referenced) {
+            entry->referenced = false;
+            continue;
+        }
+
+        if (entry->dirty && !write_back(fs, entry)) continue;
+        unlink_entry(cache, entry);
+        entry->cluster = -1;
+        cache->evictions++;
+        return entry;
+    }
+    return NULL;
+}
+
+
+cluster_cache_t *cache_create(size_t budget) {
+    cluster_cache_t *cache = calloc(1, sizeof(cluster_cache_t));
+    if (!cache) return NULL;
+
+    cache->capacity = budget / CLUSTER_SIZE;
+    if (cache->capacity < MIN_CACHE_ENTRIES) cache->capacity = MIN_CACHE_ENTRIES;
+
+    int32_t buckets = 1;
+    while (buckets < cache->capacity) buckets <<= 1;
+    cache->bucket_mask = buckets - 1;
+
+    cache->entries = calloc(cache->capacity, sizeof(cache_entry_t));
+    cache->buckets = calloc(buckets, sizeof(cache_entry_t *));
+    cache->memory = malloc((size_t)cache->capacity * CLUSTER_SIZE);
+    if (!cache->entries || !cache->buckets || !cache->memory) {
+        cache_destroy(cache);
+        return NULL;
+    }
+
+    for (int32_t i = 0; i < cache->capacity; i++) {
+        cache->entries[i].cluster = -1;
+        cache->entries[i].data = cache->memory + (size_t)i * CLUSTER_SIZE;
+    }
+    return cache;
+}
+
+void cache_destroy(cluster_cache_t *cache) {
+    if (!cache) return;
+    free(cache->entries);
+    free(cache->buckets);
+    free(cache->memory);
+    free(cache);
+}
+
+// připnutí, volající drží LOCK_CACHE
+static cache_entry_t *pin_locked(filesystem_t *fs, int32_t cluster_num, bool load) {
+    cluster_cache_t *cache = fs->cache;
+    cache_entry_t *entry = lookup(cache, cluster_num);
+    if (entry) {
+        cache->hits++;
+    } else {
+        entry = find_victim(fs);
+        if (!entry) return NULL;
+
+        if (load && !read_bytes(fs, cluster_offset(fs, cluster_num), entry->data, fs->sb.cluster_size)) {
+            return NULL;
+        }
+        cache->misses++;
+
+        entry->cluster = cluster_num;
+        entry->dirty = false;
+        int32_t bucket = hash_cluster(cache, cluster_num);
+        entry->next = cache->buckets[bucket];
+        cache->buckets[bucket] = entry;
+    }
+
+    entry->pins++;
+    entry->referenced = true;
+    return entry;
+}
+
+cache_entry_t *cache_pin(filesystem_t *fs, int32_t cluster_num, bool load) {
+    if (!fs->cache) return NULL;
+
+    //připnutou položku nelze vyřadit, obsah se pak kopíruje bez zámku
+    fs_lock(fs, LOCK_CACHE);
+    cache_entry_t *entry = pin_locked(fs, cluster_num, load);
+    fs_unlock(fs, LOCK_CACHE);
+    return entry;
+}
+
+void cache_unpin(filesystem_t *fs, cache_entry_t *entry, bool dirty) {
+    fs_lock(fs, LOCK_CACHE);
+    if (dirty) {
+        entry->dirty = true;
+        //původní chování - každá změna jde hned na disk
+        if (fs->sync_policy == SYNC_ALWAYS) write_back(fs, entry);
+    }
+    entry->pins--;
+    fs_unlock(fs, LOCK_CACHE);
+}
+
+// řazení změněných clusterů podle pozice na disku
+static int compare_entries(const void *a, const void *b) {
+    const cache_entry_t *ea = *(cache_entry_t * const *)a;
+    const cache_entry_t *eb = *(cache_entry_t * const *)b;
+    return (ea->cluster > eb->cluster) - (ea->cluster < eb->cluster);
+}
+
+bool cache_sync(filesystem_t *fs) {
+    cluster_cache_t *cache = fs->cache;
+    if (!cache) return true;
+
+    cache_entry_t **dirty = malloc(cache->capacity * sizeof(cache_entry_t *));
+    if (!dirty) return false;
+
+    fs_lock(fs, LOCK_CACHE);
+    int32_t count = 0;
+    for (int32_t i = 0; i < cache->capacity; i++) {
+        if (cache->entries[i].cluster >= 0 && cache->entries[i].dirty) {
+            dirty[count++] = &cache->entries[i];
+        }
+    }
+
+    //zápis ve vzestupném pořadí clusterů
+    qsort(dirty, count, sizeof(cache_entry_t *), compare_entries);
+    bool ok = true;
+    for (int32_t i = 0; i < count; i++) {
+        if (!write_back(fs, dirty[i])) ok = false;
+    }
+    fs_unlock(fs, LOCK_CACHE);
+
+    free(dirty);
+    return ok;
+}
+
+size_t cache_dirty_bytes(filesystem_t *fs) {
+    cluster_cache_t *cache = fs->cache;
+    if (!cache) return 0;
+
+    size_t size = 0;
+    fs_lock(fs, LOCK_CACHE);
+    for (int32_t i = 0; i < cache->capacity; i++) {
+        if (cache->entries[i].cluster >= 0 && cache->entries[i].dirty) size += fs->sb.cluster_size;
+    }
+    fs_unlock(fs, LOCK_CACHE);
+    return size;
+}
+
+bool cache_flush_range(filesystem_t *fs, int32_t start, int32_t count) {
+    cluster_cache_t *cache = fs->cache;
+    if (!cache) return true;
+
+    bool ok = true;
+    fs_lock(fs, LOCK_CACHE);
+    for (int32_t i = 0; i < count; i++) {
+        cache_entry_t *entry = lookup(cache, start + i);
+        if (entry && entry->dirty && !write_back(fs, entry)) ok = false;
+    }
+    fs_unlock(fs, LOCK_CACHE);
+    return ok;
+}
+
+void cache_invalidate(filesystem_t *fs) {
+    cluster_cache_t *cache = fs->cache;
+    if (!cache) return;
+
+    fs_lock(fs, LOCK_CACHE);
+    for (int32_t i = 0; i < cache->capacity; i++) {
+        cache->entries[i].cluster = -1;
+        cache->entries[i].dirty = false;
+        cache->entries[i].pins = 0;
+        cache->entries[i].next = NULL;
+    }
+    memset(cache->buckets, 0, (cache->bucket_mask + 1) * sizeof(cache_entry_t *));
+    cache->hand = 0;
+    fs_unlock(fs, LOCK_CACHE);
+}
+
+void cache_overlay(filesystem_t *fs, int32_t start, int32_t count, void *buffer, size_t size) {
+    cluster_cache_t *cache = fs->cache;
+    if (!cache) return;
+
+    fs_lock(fs, LOCK_CACHE);
+    for (int32_t i = 0; i < count; i++) {
+        cache_entry_t *entry = lookup(cache, start + i);
+        if (!entry) continue;
+
+        size_t offset = (size_t)i * fs->sb.cluster_size;
+        if (offset >= size) break;
+        size_t length = size - offset < (size_t)fs->sb.cluster_size ? size - offset : (size_t)fs->sb.cluster_size;
+        memcpy((uint8_t *)buffer + offset, entry->data, length);
+    }
+    fs_unlock(fs, LOCK_CACHE);
+}
+
+void cache_update(filesystem_t *fs, int32_t start, int32_t count, const void *buffer, size_t size) {
+    cluster_cache_t *cache = fs->cache;
+    if (!cache) return;
+
+    fs_lock(fs, LOCK_CACHE);
+    for (int32_t i = 0; i < count; i++) {
+        cache_entry_t *entry = lookup(cache, start + i);
+        if (!entry) continue;
+
+        size_t offset = (size_t)i * fs->sb.cluster_size;
+        size_t length = 0;
+        if (offset < size) {
+            length = size - offset < (size_t)fs->sb.cluster_size ? size - offset : (size_t)fs->sb.cluster_size;
+            memcpy(entry->data, (const uint8_t *)buffer + offset, length);
+        }
+        memset(entry->data + length, 0, fs->sb.cluster_size - length);
+        //obsah odpovídá disku
+        entry->dirty = false;
+    }
+    fs_unlock(fs, LOCK_CACHE);
+}
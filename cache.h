@@ -0,0 +1,39 @@
+#pragma once
+#include "structs.h"
+#include <stdbool.h>
+
+// Výchozí paměťový rozpočet cache clusterů
+#define DEFAULT_CACHE_SIZE (8 * 1024 * 1024)
+
+// Minimální počet položek cache, aby se vešly současně připnuté clustery
+#define MIN_CACHE_ENTRIES 16
+
+// Vytvoří cache clusterů s daným rozpočtem paměti v bytech
+cluster_cache_t *cache_create(size_t budget);
+
+// Uvolní cache (neuložené změny se zahodí, před tím je nutné zavolat cache_sync)
+void cache_destroy(cluster_cache_t *cache);
+
+// Připne cluster v cache, při load == false se obsah nenačítá z disku (bude celý přepsán)
+cache_entry_t *cache_pin(filesystem_t *fs, int32_t cluster_num, bool load);
+
+// Odepne cluster, dirty označuje změněný obsah
+void cache_unpin(filesystem_t *fs, cache_entry_t *entry, bool dirty);
+
+// Zapíše všechny změněné clustery na disk
+bool cache_sync(filesystem_t *fs);
+
+// Počet bytů změněných clusterů, které čekají na zápis
+size_t cache_dirty_bytes(filesystem_t *fs);
+
+// Zapíše změněné clustery start..start+count-1 (před čtením úseku mimo cache, např. jádrem)
+bool cache_flush_range(filesystem_t *fs, int32_t start, int32_t count);
+
+// Zahodí obsah cache včetně neuložených změn (např. po formátování)
+void cache_invalidate(filesystem_t *fs);
+
+// Přepíše data přečtená přímo z disku novějším obsahem clusterů start..start+count-1 z cache
+void cache_overlay(filesystem_t *fs, int32_t start, int32_t count, void *buffer, size_t size);
+
+// Srovná clustery v cache s daty zapsanými přímo na disk (zbytek posledního clusteru jsou nuly)
+void cache_update(filesystem_t *fs, int32_t start, int32_t count, const void *buffer, size_t size);
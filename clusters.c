@@ -7,46 +7,242 @@
 #include "structs.h"
 #include "commandline.h"
 #include "filesystem.h"
+#include "cache.h"
+#include "refcount.h"
+#include "trace.h"
+#include "locks.h"
+#include "journal.h"
 
 
 
 
+// místo uvolněné zapsanými transakcemi se zpřístupní checkpointem (jejich fdatasync),
+// volající drží LOCK_ALLOC, false = žádný cluster nepřibyl
+static bool release_held(filesystem_t *fs) {
+    if (journal_held_count(fs) == 0) return false;
+    journal_checkpoint(fs);
+    return journal_release_freed(fs) > 0;
+}
+
 int32_t alloc_cluster(filesystem_t *fs) {
-    printf("[DEBUG] alloc_cluster called\n");
-    // začátek od 1, 0 je rezervováno pro "null" ukazatel
-    for (int32_t i = 1; i < fs->sb.cluster_count; i++) {
-        if (!is_bit_set(fs->data_bitmap, i)) {
-            printf("[DEBUG] Found free cluster: %d\n", i);
-            set_bit(fs->data_bitmap, i);
-            save_bitmaps(fs);
-            return i;
+    fs_lock(fs, LOCK_ALLOC);
+    // hledání od next-fit kurzoru, cluster 0 je rezervováno pro "null" ukazatel
+    journal_release_freed(fs);
+    int32_t cluster = bitmap_find_free(fs->data_bitmap, fs->sb.cluster_cursor);
+    if (cluster < 0 && release_held(fs)) {
+        cluster = bitmap_find_free(fs->data_bitmap, fs->sb.cluster_cursor);
+    }
+    if (cluster < 0) {
+        fs_unlock(fs, LOCK_ALLOC);
+        TRACE(TRACE_ALLOC, TRACE_ERROR, "alloc_cluster: no free cluster");
+        return -1;
+    }
+
+    TRACE(TRACE_ALLOC, TRACE_DEBUG, "alloc_cluster: %d", cluster);
+    set_bit(fs->data_bitmap, cluster);
+    fs->sb.cluster_cursor = cluster + 1;
+    fs->sb_dirty = true;
+    bitmaps_changed(fs);
+    fs_unlock(fs, LOCK_ALLOC);
+    return cluster;
+}
+
+static int compare_run_length(const void *a, const void *b) {
+    const cluster_run_t *ra = a, *rb = b;
+    if (ra->length != rb->length) return ra->length < rb->length ? 1 : -1;
+    return ra->start < rb->start ? -1 : ra->start > rb->start;
+}
+
+static int compare_run_start(const void *a, const void *b) {
+    const cluster_run_t *ra = a, *rb = b;
+    return ra->start < rb->start ? -1 : ra->start > rb->start;
+}
+
+// alloc_clusters, volající drží LOCK_ALLOC
+static int32_t alloc_runs(filesystem_t *fs, int32_t count, int32_t hint, cluster_run_t **out_runs) {
+    *out_runs = NULL;
+    if (count <= 0) return 0;
+
+    cluster_run_t *runs = malloc(count * sizeof(cluster_run_t));
+    if (!runs) return -1;
+    int32_t run_count = 0;
+    int32_t length;
+
+    if (hint > 0 && bitmap_free_run(fs->data_bitmap, hint, &length) == hint && length >= count) {
+        //navázání na hint (např. původní místo souboru) má přednost
+        runs[run_count++] = (cluster_run_t){hint, count};
+    } else {
+        //jeden průchod bitmapou - seznam všech volných úseků
+        int32_t free_capacity = 64, free_count = 0, free_total = 0;
+        cluster_run_t *free_runs = malloc(free_capacity * sizeof(cluster_run_t));
+        int32_t best = -1;
+        int32_t pos = 1;
+        int32_t start;
+        while (free_runs && (start = bitmap_free_run(fs->data_bitmap, pos, &length)) >= 0) {
+            if (free_count == free_capacity) {
+                free_capacity *= 2;
+                cluster_run_t *grown = realloc(free_runs, free_capacity * sizeof(cluster_run_t));
+                if (!grown) {
+                    free(free_runs);
+                    free_runs = NULL;
+                    break;
+                }
+                free_runs = grown;
+            }
+            //best-fit - nejmenší úsek, do kterého se vejde celý soubor
+            if (length >= count && (best < 0 || length < free_runs[best].length)) {
+                best = free_count;
+            }
+            free_runs[free_count++] = (cluster_run_t){start, length};
+            free_total += length;
+            pos = start + length;
+        }
+
+        if (!free_runs || free_total < count) {
+            TRACE(TRACE_ALLOC, TRACE_ERROR, "alloc_clusters: not enough free clusters for %d", count);
+            free(free_runs);
+            free(runs);
+            return -1;
+        }
+
+        if (best >= 0) {
+            runs[run_count++] = (cluster_run_t){free_runs[best].start, count};
+        } else {
+            //fragmenty - od největších úseků, zbytek do nejmenšího úseku, kam se vejde
+            qsort(free_runs, free_count, sizeof(cluster_run_t), compare_run_length);
+            int32_t remaining = count;
+            for (int32_t i = 0; remaining > 0; i++) {
+                int32_t pick = i;
+                while (pick + 1 < free_count && free_runs[pick + 1].length >= remaining) pick++;
+
+                int32_t take = free_runs[pick].length < remaining ? free_runs[pick].length : remaining;
+                runs[run_count++] = (cluster_run_t){free_runs[pick].start, take};
+                remaining -= take;
+            }
+            //soubor se pak zapisuje ve směru rostoucích adres
+            qsort(runs, run_count, sizeof(cluster_run_t), compare_run_start);
+        }
+        free(free_runs);
+    }
+
+    for (int32_t i = 0; i < run_count; i++) {
+        bitmap_set_range(fs->data_bitmap, runs[i].start, runs[i].length);
+    }
+    fs->sb.cluster_cursor = runs[run_count - 1].start + runs[run_count - 1].length;
+    fs->sb_dirty = true;
+    bitmaps_changed(fs);
+
+    TRACE(TRACE_ALLOC, TRACE_INFO, "alloc_clusters: %d clusters in %d runs from %d", count, run_count, runs[0].start);
+    *out_runs = runs;
+    return run_count;
+}
+
+int32_t alloc_clusters(filesystem_t *fs, int32_t count, int32_t hint, cluster_run_t **out_runs) {
+    fs_lock(fs, LOCK_ALLOC);
+    journal_release_freed(fs);
+    int32_t run_count = alloc_runs(fs, count, hint, out_runs);
+    if (run_count < 0 && release_held(fs)) run_count = alloc_runs(fs, count, hint, out_runs);
+    fs_unlock(fs, LOCK_ALLOC);
+    return run_count;
+}
+
+void free_clusters(filesystem_t *fs, const cluster_run_t *runs, int32_t run_count) {
+    for (int32_t r = 0; r < run_count; r++) {
+        for (int32_t cluster = runs[r].start; cluster < runs[r].start + runs[r].length; cluster++) {
+            free_cluster(fs, cluster);
         }
     }
-    
-    printf("[DEBUG] No free clusters found!\n");
-    return -1;
 }
 
 void free_cluster(filesystem_t *fs, int32_t cluster) {
-    if (cluster >= 0 && cluster < fs->sb.cluster_count) {
-        clear_bit(fs->data_bitmap, cluster);
-        save_bitmaps(fs);
+    if (cluster > 0 && cluster < fs->sb.cluster_count) {
+        fs_lock(fs, LOCK_ALLOC);
+        //sdílený cluster (cp --reflink) dál patří ostatním souborům
+        if (!unshare_cluster(fs, cluster)) {
+            clear_bit(fs->data_bitmap, cluster);
+            //znovu se přidělí, až bude uvolnění trvalé
+            journal_defer_free(fs, cluster);
+            bitmaps_changed(fs);
+        }
+        fs_unlock(fs, LOCK_ALLOC);
     }
 }
 
 
+int64_t cluster_offset(filesystem_t *fs, int32_t cluster_num) {
+    return fs->sb.data_start + (int64_t)cluster_num * fs->sb.cluster_size;
+}
+
 bool read_cluster(filesystem_t *fs, int32_t cluster_num, void *buffer) {
-    int32_t offset = fs->sb.data_start + cluster_num * fs->sb.cluster_size;
-    return read_bytes(fs, offset, buffer, fs->sb.cluster_size);
+    cache_entry_t *entry = cache_pin(fs, cluster_num, true);
+    if (!entry) {
+        //cache není k dispozici nebo je celá připnutá - přímé čtení
+        return read_bytes(fs, cluster_offset(fs, cluster_num), buffer, fs->sb.cluster_size);
+    }
+
+    memcpy(buffer, entry->data, fs->sb.cluster_size);
+    cache_unpin(fs, entry, false);
+    return true;
 }
 
 bool write_cluster(filesystem_t *fs, int32_t cluster_num, const void *buffer) {
-    int32_t offset = fs->sb.data_start + cluster_num * fs->sb.cluster_size;
-    return write_bytes(fs, offset, buffer, fs->sb.cluster_size);
+    cache_entry_t *entry = cache_pin(fs, cluster_num, false);
+    if (!entry) {
+        return write_bytes(fs, cluster_offset(fs, cluster_num), buffer, fs->sb.cluster_size);
+    }
+
+    memcpy(entry->data, buffer, fs->sb.cluster_size);
+    cache_unpin(fs, entry, true);
+    return true;
 }
 
+bool read_clusters(filesystem_t *fs, int32_t start, int32_t count, void *buffer, size_t size) {
+    size_t run_size = (size_t)count * fs->sb.cluster_size;
+    uint8_t tail[CLUSTER_SIZE];
+    //zbytek posledního clusteru za koncem bufferu se čte do pomocného bufferu
+    struct iovec iov[2] = { { buffer, size }, { tail, run_size - size } };
 
-int32_t get_file_cluster(filesystem_t *fs, inode_t *inode, int32_t cluster_index) {
+    if (!read_vec(fs, cluster_offset(fs, start), iov, run_size > size ? 2 : 1)) return false;
+    cache_overlay(fs, start, count, buffer, size);
+    return true;
+}
+
+bool write_clusters(filesystem_t *fs, int32_t start, int32_t count, const void *buffer, size_t size) {
+    size_t run_size = (size_t)count * fs->sb.cluster_size;
+    static const uint8_t zeros[CLUSTER_SIZE];
+    struct iovec iov[2] = { { (void *)buffer, size }, { (void *)zeros, run_size - size } };
+
+    if (!write_data_vec(fs, cluster_offset(fs, start), iov, run_size > size ? 2 : 1)) return false;
+    cache_update(fs, start, count, buffer, size);
+    return true;
+}
+
+bool export_clusters(filesystem_t *fs, int32_t start, int32_t count, size_t size, int out_fd) {
+    //jádro čte přímo ze souboru - neuložené změny z cache musí být na disku
+    if (!cache_flush_range(fs, start, count)) return false;
+    return copy_out_bytes(fs, cluster_offset(fs, start), size, out_fd);
+}
+
+// přečte jeden ukazatel z nepřímého bloku bez kopírování celého clusteru
+static int32_t read_pointer(filesystem_t *fs, int32_t cluster_num, int32_t index) {
+    int32_t *mapped = image_ptr(fs, cluster_offset(fs, cluster_num), fs->sb.cluster_size);
+    if (mapped) return mapped[index];
+
+    cache_entry_t *entry = cache_pin(fs, cluster_num, true);
+    if (!entry) {
+        int32_t pointer = 0;
+        read_bytes(fs, cluster_offset(fs, cluster_num) + index * sizeof(int32_t), &pointer, sizeof(int32_t));
+        return pointer;
+    }
+
+    int32_t pointer = ((int32_t *)entry->data)[index];
+    cache_unpin(fs, entry, false);
+    return pointer;
+}
+
+
+// mapování v původním formátu - přímé a nepřímé odkazy
+static int32_t get_blockmap_cluster(filesystem_t *fs, inode_t *inode, int32_t cluster_index) {
     if (cluster_index == 0 && inode->direct1) return inode->direct1;
     if (cluster_index == 1 && inode->direct2) return inode->direct2;
     if (cluster_index == 2 && inode->direct3) return inode->direct3;
@@ -58,9 +254,7 @@ int32_t get_file_cluster(filesystem_t *fs, inode_t *inode, int32_t cluster_index
     
     //Nepřímé bloky
     if (cluster_index < (int32_t)PTRS_PER_CLUSTER && inode->indirect1) {
-        int32_t pointers[PTRS_PER_CLUSTER];
-        read_cluster(fs, inode->indirect1, pointers);
-        return pointers[cluster_index];
+        return read_pointer(fs, inode->indirect1, cluster_index);
     }
     
     //pozice indexu ve druhém nepřímém bloku
@@ -68,47 +262,39 @@ int32_t get_file_cluster(filesystem_t *fs, inode_t *inode, int32_t cluster_index
     
 
     if (inode->indirect2 == 0) return 0;
-    int32_t l1_pointers[PTRS_PER_CLUSTER];
-    read_cluster(fs, inode->indirect2, l1_pointers);
 
     int32_t l1_index = cluster_index / PTRS_PER_CLUSTER;//kolikátý l2 blok hledáme
     int32_t l2_index = cluster_index % PTRS_PER_CLUSTER;//pozice v něm
 
-    if (l1_index >= (int32_t)PTRS_PER_CLUSTER || l1_pointers[l1_index] == 0) return 0;
+    if (l1_index >= (int32_t)PTRS_PER_CLUSTER) return 0;
+    int32_t l2_cluster = read_pointer(fs, inode->indirect2, l1_index);
+    if (l2_cluster == 0) return 0;
 
-    int32_t l2_pointers[PTRS_PER_CLUSTER];
-    read_cluster(fs, l1_pointers[l1_index], l2_pointers);
-    return l2_pointers[l2_index];
+    return read_pointer(fs, l2_cluster, l2_index);
 
     
 }
 
-int set_file_cluster(filesystem_t *fs, inode_t *inode, int32_t cluster_index, int32_t cluster_num) {
-    printf("[DEBUG] set_file_cluster: index=%d, cluster=%d\n", cluster_index, cluster_num);
+static int set_blockmap_cluster(filesystem_t *fs, inode_t *inode, int32_t cluster_index, int32_t cluster_num) {
     //přímé odkazy
     if (cluster_index == 0) { 
         inode->direct1 = cluster_num; 
-        printf("[DEBUG] Set direct1 = %d\n", cluster_num);
         return 0; 
     }
     if (cluster_index == 1) { 
         inode->direct2 = cluster_num; 
-        printf("[DEBUG] Set direct2 = %d\n", cluster_num);
         return 0; 
     }
     if (cluster_index == 2) { 
         inode->direct3 = cluster_num; 
-        printf("[DEBUG] Set direct3 = %d\n", cluster_num);
         return 0; 
     }
     if (cluster_index == 3) { 
         inode->direct4 = cluster_num; 
-        printf("[DEBUG] Set direct4 = %d\n", cluster_num);
         return 0; 
     }
     if (cluster_index == 4) { 
         inode->direct5 = cluster_num; 
-        printf("[DEBUG] Set direct5 = %d\n", cluster_num);
         return 0; 
     }
     
@@ -157,4 +343,478 @@ int set_file_cluster(filesystem_t *fs, inode_t *inode, int32_t cluster_index, in
     write_cluster(fs, l1_pointers[l1_index], l2_pointers);
 
     return 0;
-}
\ No newline at end of file
+}
+
+
+// index za posledním namapovaným clusterem úseku
+static int32_t extent_end(const extent_t *extent) {
+    return extent->logical + extent->length;
+}
+
+// vyhledání v seřazeném poli úseků, vrací pozici úseku nebo -1
+static int32_t find_extent_index(const extent_t *extents, int32_t count, int32_t cluster_index) {
+    int32_t low = 0, high = count - 1;
+    while (low <= high) {
+        int32_t mid = (low + high) / 2;
+        if (cluster_index < extents[mid].logical) {
+            high = mid - 1;
+        } else if (cluster_index >= extent_end(&extents[mid])) {
+            low = mid + 1;
+        } else {
+            return mid;
+        }
+    }
+    return -1;
+}
+
+// cluster pro index a v *length počet clusterů do konce jeho úseku (0 = nenamapovaný, délka 1)
+static int32_t get_extent_run(filesystem_t *fs, inode_t *inode, int32_t cluster_index, int32_t *length) {
+    *length = 1;
+    //úseky v i-uzlu - souvislý soubor se namapuje bez dalšího čtení
+    for (int32_t i = 0; i < INLINE_EXTENTS; i++) {
+        const extent_t *extent = &inode->extents[i];
+        if (extent->length > 0 && cluster_index >= extent->logical && cluster_index < extent_end(extent)) {
+            *length = extent_end(extent) - cluster_index;
+            return extent->physical + (cluster_index - extent->logical);
+        }
+    }
+    if (inode->extent_tree == 0) return 0;
+
+    uint8_t buffer[CLUSTER_SIZE];
+    extent_block_t *block = (extent_block_t *)buffer;
+    if (!read_cluster(fs, inode->extent_tree, buffer)) return 0;
+    int32_t i = find_extent_index(block->extents, block->count, cluster_index);
+    if (i < 0) return 0;
+    *length = extent_end(&block->extents[i]) - cluster_index;
+    return block->extents[i].physical + (cluster_index - block->extents[i].logical);
+}
+
+static int32_t get_extent_cluster(filesystem_t *fs, inode_t *inode, int32_t cluster_index) {
+    int32_t length;
+    return get_extent_run(fs, inode, cluster_index, &length);
+}
+
+// převede i-uzel z úseků na přímé a nepřímé odkazy (příliš fragmentovaný soubor)
+static int convert_to_blockmap(filesystem_t *fs, inode_t *inode, int32_t mapped_end) {
+    TRACE(TRACE_ALLOC, TRACE_INFO, "inode %d converted to block map", inode->nodeid);
+
+    int32_t *clusters = calloc(mapped_end > 0 ? mapped_end : 1, sizeof(int32_t));
+    if (!clusters) return -1;
+    for (int32_t i = 0; i < mapped_end; i++) {
+        clusters[i] = get_extent_cluster(fs, inode, i);
+    }
+
+    if (inode->extent_tree > 0) free_cluster(fs, inode->extent_tree);
+    memset(inode->extents, 0, sizeof(inode->extents));
+    inode->extent_tree = 0;
+    inode->format = INODE_FORMAT_BLOCKMAP;
+
+    for (int32_t i = 0; i < mapped_end; i++) {
+        if (clusters[i] != 0 && set_blockmap_cluster(fs, inode, i, clusters[i]) < 0) {
+            free(clusters);
+            return -1;
+        }
+    }
+    free(clusters);
+    return 0;
+}
+
+// namapuje length clusterů od cluster_num na indexy od cluster_index
+static int set_extent_run(filesystem_t *fs, inode_t *inode, int32_t cluster_index, int32_t cluster_num, int32_t length) {
+    uint8_t buffer[CLUSTER_SIZE];
+    extent_block_t *block = (extent_block_t *)buffer;
+    extent_t *last = NULL;
+    int32_t free_inline = -1;
+
+    //poslední úsek souboru - v clusteru s úseky, nebo v i-uzlu
+    if (inode->extent_tree > 0) {
+        if (!read_cluster(fs, inode->extent_tree, buffer)) return -1;
+        if (block->count > 0) last = &block->extents[block->count - 1];
+    }
+    for (int32_t i = 0; i < INLINE_EXTENTS; i++) {
+        if (inode->extents[i].length == 0) {
+            if (free_inline < 0) free_inline = i;
+        } else if (!last || inode->extent_tree == 0) {
+            last = &inode->extents[i];
+        }
+    }
+    int32_t mapped_end = last ? extent_end(last) : 0;
+
+    //nové umístění posledního clusteru (kopie sdíleného clusteru při zápisu) - zkrácení posledního úseku
+    if (length == 1 && last && cluster_index == mapped_end - 1 && get_extent_cluster(fs, inode, cluster_index) != cluster_num) {
+        last->length--;
+        if (last->length == 0) memset(last, 0, sizeof(extent_t));
+        if (inode->extent_tree > 0 && block->count > 0 && last == &block->extents[block->count - 1]) {
+            if (last->length == 0) block->count--;
+            if (!write_cluster(fs, inode->extent_tree, buffer)) return -1;
+        }
+        return set_extent_run(fs, inode, cluster_index, cluster_num, 1);
+    }
+
+    //přepis již namapovaného clusteru úseky neumí
+    if (cluster_index < mapped_end) {
+        for (int32_t i = 0; i < length; i++) {
+            if (get_file_cluster(fs, inode, cluster_index + i) == cluster_num + i) continue;
+            if (inode->format == INODE_FORMAT_EXTENTS && convert_to_blockmap(fs, inode, mapped_end) < 0) return -1;
+            if (set_blockmap_cluster(fs, inode, cluster_index + i, cluster_num + i) < 0) return -1;
+        }
+        return 0;
+    }
+
+    //prodloužení posledního úseku
+    if (last && cluster_index == mapped_end && last->physical + last->length == cluster_num) {
+        last->length += length;
+        if (inode->extent_tree > 0 && last == &block->extents[block->count - 1]) {
+            return write_cluster(fs, inode->extent_tree, buffer) ? 0 : -1;
+        }
+        return 0;
+    }
+
+    extent_t extent = { cluster_index, cluster_num, length };
+    if (inode->extent_tree == 0 && free_inline >= 0) {
+        inode->extents[free_inline] = extent;
+        return 0;
+    }
+
+    //další úseky do samostatného clusteru
+    if (inode->extent_tree == 0) {
+        int32_t tree = alloc_cluster(fs);
+        if (tree < 0) return -1;
+        memset(buffer, 0, sizeof(buffer));
+        inode->extent_tree = tree;
+    }
+    if (block->count >= (int32_t)EXTENTS_PER_CLUSTER) {
+        if (convert_to_blockmap(fs, inode, mapped_end) < 0) return -1;
+        for (int32_t i = 0; i < length; i++) {
+            if (set_blockmap_cluster(fs, inode, cluster_index + i, cluster_num + i) < 0) return -1;
+        }
+        return 0;
+    }
+
+    block->extents[block->count++] = extent;
+    return write_cluster(fs, inode->extent_tree, buffer) ? 0 : -1;
+}
+
+
+int32_t get_file_cluster(filesystem_t *fs, inode_t *inode, int32_t cluster_index) {
+    if (inode->format == INODE_FORMAT_EXTENTS) {
+        return get_extent_cluster(fs, inode, cluster_index);
+    }
+    return get_blockmap_cluster(fs, inode, cluster_index);
+}
+
+int32_t get_file_run(filesystem_t *fs, inode_t *inode, int32_t cluster_index, int32_t max_length, int32_t *length) {
+    int32_t start;
+    if (inode->format == INODE_FORMAT_EXTENTS) {
+        start = get_extent_run(fs, inode, cluster_index, length);
+    } else {
+        //bloky ukazatelů jsou po prvním čtení v cache clusterů
+        start = get_blockmap_cluster(fs, inode, cluster_index);
+        *length = 1;
+        while (start > 0 && *length < max_length &&
+               get_blockmap_cluster(fs, inode, cluster_index + *length) == start + *length) {
+            (*length)++;
+        }
+    }
+    if (*length > max_length) *length = max_length;
+    return start;
+}
+
+int set_file_cluster(filesystem_t *fs, inode_t *inode, int32_t cluster_index, int32_t cluster_num) {
+    TRACE(TRACE_ALLOC, TRACE_DEBUG, "set_file_cluster: inode %d index %d -> %d", inode->nodeid, cluster_index, cluster_num);
+    if (inode->format == INODE_FORMAT_EXTENTS) {
+        return set_extent_run(fs, inode, cluster_index, cluster_num, 1);
+    }
+    return set_blockmap_cluster(fs, inode, cluster_index, cluster_num);
+}
+
+int set_file_run(filesystem_t *fs, inode_t *inode, int32_t cluster_index, int32_t start, int32_t length) {
+    if (inode->format == INODE_FORMAT_EXTENTS) {
+        return set_extent_run(fs, inode, cluster_index, start, length);
+    }
+    for (int32_t i = 0; i < length; i++) {
+        if (set_blockmap_cluster(fs, inode, cluster_index + i, start + i) < 0) return -1;
+    }
+    return 0;
+}
+
+// own_file_cluster, volající drží LOCK_ALLOC
+static int32_t own_cluster(filesystem_t *fs, inode_t *inode, int32_t cluster_index) {
+    int32_t cluster = get_file_cluster(fs, inode, cluster_index);
+    if (cluster <= 0 || cluster_refs(fs, cluster) == 0) return cluster;
+
+    //sdílený cluster - zápis jde do vlastní kopie, ostatní soubory vidí původní data
+    cluster_run_t *runs;
+    journal_release_freed(fs);
+    int32_t run_count = alloc_runs(fs, 1, cluster + 1, &runs);
+    if (run_count < 0) return -1;
+    int32_t copy = runs[0].start;
+    free(runs);
+
+    uint8_t buffer[CLUSTER_SIZE];
+    if (!read_cluster(fs, cluster, buffer) || !write_cluster(fs, copy, buffer) ||
+        set_file_cluster(fs, inode, cluster_index, copy) < 0) {
+        free_cluster(fs, copy);
+        return -1;
+    }
+    unshare_cluster(fs, cluster);
+    return copy;
+}
+
+int32_t own_file_cluster(filesystem_t *fs, inode_t *inode, int32_t cluster_index) {
+    //čítač se nesmí změnit mezi kontrolou sdílení a kopií (souběžné rm druhého souboru)
+    fs_lock(fs, LOCK_ALLOC);
+    int32_t cluster = own_cluster(fs, inode, cluster_index);
+    fs_unlock(fs, LOCK_ALLOC);
+    return cluster;
+}
+
+void init_file_map(inode_t *inode) {
+    memset(inode->extents, 0, sizeof(inode->extents));
+    inode->extent_tree = 0;
+    inode->format = INODE_FORMAT_EXTENTS;
+}
+
+void free_file_clusters(filesystem_t *fs, inode_t *inode) {
+    if (inode->format == INODE_FORMAT_EXTENTS) {
+        for (int32_t i = 0; i < INLINE_EXTENTS; i++) {
+            for (int32_t j = 0; j < inode->extents[i].length; j++) {
+                free_cluster(fs, inode->extents[i].physical + j);
+            }
+        }
+
+        if (inode->extent_tree > 0) {
+            uint8_t buffer[CLUSTER_SIZE];
+            extent_block_t *block = (extent_block_t *)buffer;
+            if (read_cluster(fs, inode->extent_tree, buffer)) {
+                for (int32_t i = 0; i < block->count; i++) {
+                    for (int32_t j = 0; j < block->extents[i].length; j++) {
+                        free_cluster(fs, block->extents[i].physical + j);
+                    }
+                }
+            }
+            free_cluster(fs, inode->extent_tree);
+        }
+
+        init_file_map(inode);
+        return;
+    }
+
+    if (inode->direct1 > 0) free_cluster(fs, inode->direct1);
+    if (inode->direct2 > 0) free_cluster(fs, inode->direct2);
+    if (inode->direct3 > 0) free_cluster(fs, inode->direct3);
+    if (inode->direct4 > 0) free_cluster(fs, inode->direct4);
+    if (inode->direct5 > 0) free_cluster(fs, inode->direct5);
+
+    if (inode->indirect1 > 0) {
+        int32_t pointers[PTRS_PER_CLUSTER];
+        read_cluster(fs, inode->indirect1, pointers);
+        for (int i = 0; i < (int32_t)PTRS_PER_CLUSTER && pointers[i] > 0; i++) {
+            free_cluster(fs, pointers[i]);
+        }
+        free_cluster(fs, inode->indirect1);
+    }
+
+    if (inode->indirect2 > 0) {
+        int32_t l1_pointers[PTRS_PER_CLUSTER];
+        read_cluster(fs, inode->indirect2, l1_pointers);
+
+        for (int i = 0; i < (int32_t)PTRS_PER_CLUSTER && l1_pointers[i] > 0; i++) {
+            int32_t l2_pointers[PTRS_PER_CLUSTER];
+            read_cluster(fs, l1_pointers[i], l2_pointers);
+
+            for (int j = 0; j < (int32_t)PTRS_PER_CLUSTER && l2_pointers[j] > 0; j++) {
+                free_cluster(fs, l2_pointers[j]);
+            }
+
+            free_cluster(fs, l1_pointers[i]);
+        }
+
+        free_cluster(fs, inode->indirect2);
+    }
+
+    inode->direct1 = 0;
+    inode->direct2 = 0;
+    inode->direct3 = 0;
+    inode->direct4 = 0;
+    inode->direct5 = 0;
+    inode->indirect1 = 0;
+    inode->indirect2 = 0;
+}
+
+
+void bmap_iter_init(bmap_iter_t *it, filesystem_t *fs, const inode_t *inode) {
+    it->fs = fs;
+    it->inode = *inode;
+    it->index = 0;
+    it->count = (inode->file_size + fs->sb.cluster_size - 1) / fs->sb.cluster_size;
+    it->indirect1_loaded = false;
+    it->l1_loaded = false;
+    it->l2_loaded = -1;
+    it->inline_count = 0;
+    it->extent_count = 0;
+    it->extent_pos = 0;
+
+    if (inode->format != INODE_FORMAT_EXTENTS) return;
+
+    while (it->inline_count < INLINE_EXTENTS && inode->extents[it->inline_count].length > 0) {
+        it->inline_count++;
+    }
+    it->block.count = 0;
+    if (inode->extent_tree > 0 && !read_cluster(fs, inode->extent_tree, &it->block)) {
+        it->block.count = 0;
+    }
+    it->extent_count = it->inline_count + it->block.count;
+}
+
+static const extent_t *iter_extent(const bmap_iter_t *it, int32_t pos) {
+    if (pos < it->inline_count) return &it->inode.extents[pos];
+    return &it->block.extents[pos - it->inline_count];
+}
+
+static int32_t iter_extent_cluster(bmap_iter_t *it, int32_t index) {
+    while (it->extent_pos < it->extent_count && index >= extent_end(iter_extent(it, it->extent_pos))) {
+        it->extent_pos++;
+    }
+    if (it->extent_pos >= it->extent_count) return 0;
+
+    const extent_t *extent = iter_extent(it, it->extent_pos);
+    if (index < extent->logical) return 0;
+    return extent->physical + (index - extent->logical);
+}
+
+static int32_t iter_blockmap_cluster(bmap_iter_t *it, int32_t index) {
+    inode_t *inode = &it->inode;
+    switch (index) {
+        case 0: return inode->direct1;
+        case 1: return inode->direct2;
+        case 2: return inode->direct3;
+        case 3: return inode->direct4;
+        case 4: return inode->direct5;
+    }
+
+    index -= DIRECT_LINKS;
+    if (index < (int32_t)PTRS_PER_CLUSTER) {
+        if (inode->indirect1 == 0) return 0;
+        if (!it->indirect1_loaded) {
+            if (!read_cluster(it->fs, inode->indirect1, it->indirect1)) return 0;
+            it->indirect1_loaded = true;
+        }
+        return it->indirect1[index];
+    }
+
+    index -= PTRS_PER_CLUSTER;
+    int32_t l1_index = index / PTRS_PER_CLUSTER;
+    int32_t l2_index = index % PTRS_PER_CLUSTER;
+    if (inode->indirect2 == 0 || l1_index >= (int32_t)PTRS_PER_CLUSTER) return 0;
+
+    if (!it->l1_loaded) {
+        if (!read_cluster(it->fs, inode->indirect2, it->l1_pointers)) return 0;
+        it->l1_loaded = true;
+    }
+    if (it->l1_pointers[l1_index] == 0) return 0;
+    if (it->l2_loaded != l1_index) {
+        if (!read_cluster(it->fs, it->l1_pointers[l1_index], it->l2_pointers)) return 0;
+        it->l2_loaded = l1_index;
+    }
+    return it->l2_pointers[l2_index];
+}
+
+bool bmap_next(bmap_iter_t *it, int32_t *cluster) {
+    if (it->index >= it->count) return false;
+
+    if (it->inode.format == INODE_FORMAT_EXTENTS) {
+        *cluster = iter_extent_cluster(it, it->index);
+    } else {
+        *cluster = iter_blockmap_cluster(it, it->index);
+    }
+    it->index++;
+    return true;
+}
+
+bool bmap_next_run(bmap_iter_t *it, int32_t max_length, int32_t *start, int32_t *length) {
+    int32_t cluster;
+    if (!bmap_next(it, &cluster)) return false;
+
+    *start = cluster;
+    *length = 1;
+    //nenamapované clustery se vrací po jednom
+    if (cluster == 0) return true;
+
+    while (*length < max_length && it->index < it->count) {
+        int32_t saved_index = it->index;
+        int32_t saved_pos = it->extent_pos;
+        int32_t next;
+        if (!bmap_next(it, &next)) break;
+        if (next != cluster + *length) {
+            //cluster nenavazuje, vrátí se do dalšího volání
+            it->index = saved_index;
+            it->extent_pos = saved_pos;
+            break;
+        }
+        (*length)++;
+    }
+    return true;
+}
+
+
+bool file_reader_open(file_reader_t *reader, filesystem_t *fs, const inode_t *inode) {
+    bmap_iter_init(&reader->it, fs, inode);
+    reader->pos = 0;
+    reader->length = 0;
+    reader->remaining = inode->file_size;
+    reader->buffer = malloc(IO_RUN_CLUSTERS * fs->sb.cluster_size);
+    return reader->buffer != NULL;
+}
+
+// načte do bufferu další fyzicky souvislý úsek souboru
+static bool file_reader_fill(file_reader_t *reader) {
+    filesystem_t *fs = reader->it.fs;
+    int32_t start, length;
+    if (!bmap_next_run(&reader->it, IO_RUN_CLUSTERS, &start, &length)) return false;
+
+    int64_t size = (int64_t)length * fs->sb.cluster_size;
+    if (size > reader->remaining) size = reader->remaining;
+
+    //nenamapovaný cluster se čte jako nuly
+    if (start == 0) {
+        memset(reader->buffer, 0, size);
+    } else if (!read_clusters(fs, start, length, reader->buffer, size)) {
+        return false;
+    }
+    reader->pos = 0;
+    reader->length = size;
+    reader->remaining -= size;
+    return true;
+}
+
+int64_t file_reader_read(file_reader_t *reader, void *data, size_t size) {
+    size_t done = 0;
+    while (done < size) {
+        if (reader->pos == reader->length) {
+            if (reader->remaining == 0) break;
+            if (!file_reader_fill(reader)) return -1;
+        }
+
+        size_t chunk = reader->length - reader->pos;
+        if (chunk > size - done) chunk = size - done;
+        memcpy((uint8_t *)data + done, reader->buffer + reader->pos, chunk);
+        reader->pos += chunk;
+        done += chunk;
+    }
+    return done;
+}
+
+bool file_reader_take_run(file_reader_t *reader, int32_t max_length, int32_t *start, int32_t *length) {
+    if (reader->pos != reader->length) return false;
+    if (!bmap_next_run(&reader->it, max_length, start, length)) return false;
+
+    int64_t size = (int64_t)*length * reader->it.fs->sb.cluster_size;
+    reader->remaining -= size < reader->remaining ? size : reader->remaining;
+    return true;
+}
+
+void file_reader_close(file_reader_t *reader) {
+    free(reader->buffer);
+    reader->buffer = NULL;
+}
@@ -11,20 +11,120 @@
 // Počet ukazatelů na jeden cluster
 #define PTRS_PER_CLUSTER (CLUSTER_SIZE / sizeof(int32_t))
 
+// Nejdelší úsek clusterů přenášený jedním voláním přes pomocný buffer
+#define IO_RUN_CLUSTERS 64
+
+// Souvislý úsek clusterů
+typedef struct {
+    int32_t start;
+    int32_t length;
+} cluster_run_t;
+
+// Stav průchodu mapováním clusterů souboru - každý blok ukazatelů se čte jen jednou
+typedef struct {
+    filesystem_t *fs;
+    inode_t inode;                      //kopie i-uzlu procházeného souboru
+    int32_t index;                      //další logický index
+    int32_t count;                      //počet clusterů souboru
+    //formát INODE_FORMAT_BLOCKMAP
+    int32_t indirect1[PTRS_PER_CLUSTER];
+    int32_t l1_pointers[PTRS_PER_CLUSTER];
+    int32_t l2_pointers[PTRS_PER_CLUSTER];
+    bool indirect1_loaded;
+    bool l1_loaded;
+    int32_t l2_loaded;                  //index načteného bloku l2_pointers, -1 = žádný
+    //formát INODE_FORMAT_EXTENTS
+    union {
+        extent_block_t block;           //úseky z clusteru extent_tree
+        uint8_t block_data[CLUSTER_SIZE];   //read_cluster čte celý cluster
+    };
+    int32_t inline_count;               //počet úseků v i-uzlu
+    int32_t extent_count;               //celkový počet úseků
+    int32_t extent_pos;                 //aktuální úsek
+} bmap_iter_t;
+
+// Sekvenční čtení obsahu souboru ve fs po libovolně dlouhých částech přes buffer pevné velikosti
+typedef struct {
+    bmap_iter_t it;
+    uint8_t *buffer;                    //IO_RUN_CLUSTERS clusterů
+    size_t pos;                         //první nepředaný byte v bufferu
+    size_t length;                      //počet platných bytů v bufferu
+    int64_t remaining;                  //kolik bytů souboru ještě nebylo načteno do bufferu
+} file_reader_t;
+
 // Alokuje volný cluster pro uložení souboru
 int32_t alloc_cluster(filesystem_t *fs);
 
+// Alokuje count clusterů v co nejmenším počtu souvislých úseků (best-fit, jinak po fragmentech).
+// Úseky seřazené podle pozice vrací v *out_runs (uvolní volající), vrací jejich počet nebo -1
+int32_t alloc_clusters(filesystem_t *fs, int32_t count, int32_t hint, cluster_run_t **out_runs);
+
+// Uvolní všechny clustery úseků (např. nevyužitou alokaci)
+void free_clusters(filesystem_t *fs, const cluster_run_t *runs, int32_t run_count);
+
 // Uvolní cluster pro další použití
 void free_cluster(filesystem_t *fs, int32_t cluster);
 
+// pozice clusteru v souboru s fs
+int64_t cluster_offset(filesystem_t *fs, int32_t cluster_num);
+
 // najde pozici clusteru v souboru a přečte jeho obsah
 bool read_cluster(filesystem_t *fs, int32_t cluster_num, void *buffer);
 
 // najde pozici clusteru v souboru a zapíše jeho obsah
 bool write_cluster(filesystem_t *fs, int32_t cluster_num, const void *buffer);
 
+// přečte souvislý úsek count clusterů od start jedním voláním, do bufferu jde prvních size bytů
+// (size > (count - 1) * velikost clusteru, zbytek posledního clusteru se zahodí)
+bool read_clusters(filesystem_t *fs, int32_t start, int32_t count, void *buffer, size_t size);
+
+// zapíše size bytů do souvislého úseku count clusterů od start, zbytek posledního clusteru vynuluje
+bool write_clusters(filesystem_t *fs, int32_t start, int32_t count, const void *buffer, size_t size);
+
+// zapíše prvních size bytů souvislého úseku count clusterů do souboru out_fd bez kopie přes uživatelský prostor
+bool export_clusters(filesystem_t *fs, int32_t start, int32_t count, size_t size, int out_fd);
+
 // Vrací číslo clusteru pro daný index v souboru - mapuje relativní index na fyzický cluster
 int32_t get_file_cluster(filesystem_t *fs, inode_t *inode, int32_t cluster_index);
 
-// Přiřazuje clustery ukazatelům
-int set_file_cluster(filesystem_t *fs, inode_t *inode, int32_t cluster_index, int32_t cluster_num);
\ No newline at end of file
+// Vrací cluster pro daný index a v *length počet fyzicky navazujících clusterů od něj (nejvýše max_length),
+// 0 = nenamapovaný cluster (délka 1)
+int32_t get_file_run(filesystem_t *fs, inode_t *inode, int32_t cluster_index, int32_t max_length, int32_t *length);
+
+// Přiřazuje clustery ukazatelům (nebo úsekům u formátu INODE_FORMAT_EXTENTS)
+int set_file_cluster(filesystem_t *fs, inode_t *inode, int32_t cluster_index, int32_t cluster_num);
+
+// Namapuje souvislý úsek length clusterů od start na indexy od cluster_index (jedním úsekem, pokud to jde)
+int set_file_run(filesystem_t *fs, inode_t *inode, int32_t cluster_index, int32_t start, int32_t length);
+
+// Před zápisem do clusteru souboru zruší jeho sdílení s jinými soubory (kopie při zápisu).
+// Vrací cluster, do kterého lze zapisovat (0 = nenamapovaný), nebo -1
+int32_t own_file_cluster(filesystem_t *fs, inode_t *inode, int32_t cluster_index);
+
+// Připraví prázdné mapování clusterů nového souboru (formát úseků)
+void init_file_map(inode_t *inode);
+
+// Uvolní všechny datové clustery souboru i clustery s metadaty mapování
+void free_file_clusters(filesystem_t *fs, inode_t *inode);
+
+// Připraví průchod clustery souboru od indexu 0
+void bmap_iter_init(bmap_iter_t *it, filesystem_t *fs, const inode_t *inode);
+
+// Vrátí další cluster souboru (0 = nenamapovaný), false na konci souboru
+bool bmap_next(bmap_iter_t *it, int32_t *cluster);
+
+// Vrátí další souvislý úsek fyzicky navazujících clusterů (nejvýše max_length), false na konci
+bool bmap_next_run(bmap_iter_t *it, int32_t max_length, int32_t *start, int32_t *length);
+
+// Připraví sekvenční čtení souboru od začátku, false pokud nelze alokovat buffer
+bool file_reader_open(file_reader_t *reader, filesystem_t *fs, const inode_t *inode);
+
+// Přečte až size bytů souboru, vrací počet přečtených bytů (0 na konci souboru) nebo -1 při chybě
+int64_t file_reader_read(file_reader_t *reader, void *data, size_t size);
+
+// Přeskočí další úsek fyzicky navazujících clusterů (nejvýše max_length) bez čtení dat a vrátí ho,
+// false na konci souboru nebo pokud v bufferu zbývají nepřečtená data
+bool file_reader_take_run(file_reader_t *reader, int32_t max_length, int32_t *start, int32_t *length);
+
+// Uvolní buffer čtení souboru
+void file_reader_close(file_reader_t *reader);
\ No newline at end of file
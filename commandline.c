@@ -4,132 +4,86 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <ctype.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include "structs.h"
 #include "commandline.h"
 #include "inodes.h"
+#include "refcount.h"
+#include "journal.h"
 #include "clusters.h"
 #include "filesystem.h"
+#include "cache.h"
+#include "dirindex.h"
+#include "dcache.h"
+#include "stream.h"
+#include "trace.h"
+#include "locks.h"
+#include "zosfs.h"
 
 
 
-void pwd(filesystem_t *fs) {
-    printf("%s\n", fs->current_path);
+// vypíše OK nebo hlášku chyby knihovny, not_found (je-li zadaná) nahrazuje hlášku ZOSFS_ENOENT
+static bool report(zosfs_status_t status, const char *not_found) {
+    if (status == ZOSFS_ENOENT && not_found) printf("%s\n", not_found);
+    else printf("%s\n", zosfs_strerror(status));
+    return status == ZOSFS_OK;
 }
 
-bool ls(filesystem_t *fs, const char *path) {
-    int32_t dir_id = path && path[0] ? find_in_dir(fs, fs->current_inode, path) : fs->current_inode;
-    
-    if (dir_id < 0) {
-        printf("PATH NOT FOUND\n");
-        return false;
-    }
-    
-    inode_t dir_inode;
-    if (!read_inode(fs, dir_id, &dir_inode) || !dir_inode.is_directory) {
-        printf("PATH NOT FOUND\n");
-        return false;
-    }
-    
-    
-    printf("[DEBUG] Listing directory inode %d, size=%d bytes\n", dir_id, dir_inode.file_size);
-    
-    
-    int32_t cluster_count = (dir_inode.file_size + fs->sb.cluster_size - 1) / fs->sb.cluster_size;
-    
-    if (cluster_count == 0) {
-        // složka je prázdná
-        return true;
-    }
-    
-    dir_item_t entries[ENTRIES_PER_CLUSTER];
-    
-    for (int32_t i = 0; i < cluster_count; i++) {
-        int32_t cluster = get_file_cluster(fs, &dir_inode, i);
-        if (cluster == 0) continue;
-        
-        read_cluster(fs, cluster, entries);
-        for (int j = 0; j < (int32_t)ENTRIES_PER_CLUSTER; j++) {
-            if (entries[j].inode != 0) {
-                inode_t entry_inode;
-                read_inode(fs, entries[j].inode, &entry_inode);
-                printf("%s: %s\n", entry_inode.is_directory ? "DIR" : "FILE", entries[j].name);
-            }
-        }
-    }
-    return true;
+void pwd(session_t *session) {
+    printf("%s\n", session->current_path);
 }
 
-bool mkdir(filesystem_t *fs, const char *name) {
-    printf("[DEBUG] mkdir called for '%s'\n", name);
-    printf("[DEBUG] Current inode: %d\n", fs->current_inode);
-    
-    if (find_in_dir(fs, fs->current_inode, name) >= 0) {
-        printf("EXIST\n");
-        return false;
-    }
-    
-    int32_t new_inode_id = alloc_inode(fs);
-    if (new_inode_id < 0) {
-        printf("CANNOT CREATE FILE\n");
-        return false;
+bool ls(session_t *session, const char *path) {
+    //položky se čtou po dávkách do bufferu, adresář je zamčený jen během čtení dávky
+    zosfs_dirent_t entries[ENTRIES_PER_CLUSTER];
+    int32_t cursor = 0, count;
+    zosfs_status_t status;
+    while ((status = zosfs_readdir(session, path, &cursor, entries, ENTRIES_PER_CLUSTER, &count)) == ZOSFS_OK && count > 0) {
+        for (int32_t i = 0; i < count; i++) {
+            printf("%s: %s\n", entries[i].is_directory ? "DIR" : "FILE", entries[i].name);
+        }
     }
-    
-    printf("[DEBUG] Allocated inode: %d\n", new_inode_id);
-    
-    inode_t new_inode = {0};
-    new_inode.nodeid = new_inode_id;
-    new_inode.is_directory = true;
-    new_inode.references = 1;
-    new_inode.file_size = 0;
-    new_inode.parent = fs->current_inode;
-    write_inode(fs, new_inode_id, &new_inode);
-    
-    printf("[DEBUG] Wrote inode %d, calling add_to_dir\n", new_inode_id);
-    
-    if (add_to_dir(fs, fs->current_inode, name, new_inode_id) == false) {
+
+    if (status != ZOSFS_OK) {
         printf("PATH NOT FOUND\n");
         return false;
     }
-
-    printf("[DEBUG] add_to_dir completed successfully\n");
-    
-    //TODO smazat
-    inode_t parent;
-    read_inode(fs, fs->current_inode, &parent);
-    printf("[DEBUG] Parent dir inode %d now has size: %d bytes\n", 
-           fs->current_inode, parent.file_size);
-    
-    printf("OK\n");
     return true;
 }
 
-bool incp(filesystem_t *fs, const char *src, const char *dest) {
+bool mkdir(session_t *session, const char *name) {
+    return report(zosfs_mkdir(session, name), "PATH NOT FOUND");
+}
+
+bool incp(session_t *session, const char *src, const char *dest) {
+    filesystem_t *fs = session->fs;
     int32_t dest_parent_id;
     char clean_filename[NAME_SIZE];
 
-    if (!split_path(fs, dest, &dest_parent_id, clean_filename)) {
+    if (!split_path(fs, session->current_inode, dest, &dest_parent_id, clean_filename)) {
         printf("PATH NOT FOUND\n");
         return false;
     }
 
 
-    FILE *f = fopen(src, "rb");
-    if (!f) {
+    //čtecí vlákno začne načítat soubor hned, souběžně s alokací
+    stream_reader_t reader;
+    if (!stream_open(&reader, src, IO_RUN_CLUSTERS * fs->sb.cluster_size)) {
         printf("FILE NOT FOUND\n");
         return false;
     }
-    
-    fseek(f, 0, SEEK_END);
-    int32_t size = ftell(f);
-    fseek(f, 0, SEEK_SET);
-    
-    uint8_t *data = malloc(size);
-    fread(data, 1, size, f);
-    fclose(f);
+    //obrazy formátu 1 mají v i-uzlu jen 32bitovou velikost
+    off_t size = reader.size;
+    if (size > max_file_size(fs)) {
+        stream_close(&reader);
+        printf("FILE TOO LARGE\n");
+        return false;
+    }
     
     int32_t new_inode_id = alloc_inode(fs);
     if (new_inode_id < 0) {
-        free(data);
+        stream_close(&reader);
         printf("CANNOT CREATE FILE\n");
         return false;
     }
@@ -138,292 +92,199 @@ bool incp(filesystem_t *fs, const char *src, const char *dest) {
     new_inode.nodeid = new_inode_id;
     new_inode.is_directory = false;
     new_inode.references = 1;
+    init_file_map(&new_inode);
     new_inode.file_size = size;
     
-    // zápis dat do clusterů
+    // clustery pro celý soubor se alokují předem, aby byl co nejvíce souvislý
     int32_t clusters_needed = (size + fs->sb.cluster_size - 1) / fs->sb.cluster_size;
-    for (int32_t i = 0; i < clusters_needed; i++) {
-        int32_t cluster = alloc_cluster(fs);
-        if (cluster < 0) {
-            free(data);
-            printf("CANNOT CREATE FILE\n");
-            return false;
-        }
-        
-        int32_t offset = i * fs->sb.cluster_size;
-        int32_t to_write;
-        if (size - offset > fs->sb.cluster_size) {
-            to_write = fs->sb.cluster_size;
-        } else {
-            to_write = size - offset;
-        }
-
-        uint8_t buffer[CLUSTER_SIZE] = {0};
-        memcpy(buffer, data + offset, to_write);
-        write_cluster(fs, cluster, buffer);
-        set_file_cluster(fs, &new_inode, i, cluster);
+    cluster_run_t *runs;
+    int32_t run_count = alloc_clusters(fs, clusters_needed, 0, &runs);
+    if (run_count < 0) {
+        stream_close(&reader);
+        free_inode(fs, new_inode_id);
+        printf("CANNOT CREATE FILE\n");
+        return false;
     }
-    
-    
 
+    int32_t i = 0, r = 0, run_offset = 0;
+    bool write_ok = true;
+    const uint8_t *chunk;
+    size_t chunk_length;
+    while (write_ok && stream_next(&reader, &chunk, &chunk_length)) {
+        //blok se rozdělí podle úseků alokovaných clusterů
+        size_t pos = 0;
+        while (pos < chunk_length) {
+            int32_t count = (chunk_length - pos + fs->sb.cluster_size - 1) / fs->sb.cluster_size;
+            if (count > runs[r].length - run_offset) count = runs[r].length - run_offset;
+            size_t bytes = (size_t)count * fs->sb.cluster_size;
+            if (bytes > chunk_length - pos) bytes = chunk_length - pos;
+
+            int32_t start = runs[r].start + run_offset;
+            if (!write_clusters(fs, start, count, chunk + pos, bytes)) {
+                write_ok = false;
+                break;
+            }
+            for (int32_t cluster = start; cluster < start + count; cluster++, i++) {
+                set_file_cluster(fs, &new_inode, i, cluster);
+            }
+
+            pos += bytes;
+            run_offset += count;
+            if (run_offset == runs[r].length) {
+                r++;
+                run_offset = 0;
+            }
+        }
+    }
+    //po chybě zápisu se čtení zastaví předčasně a hlásí se chyba zápisu
+    bool read_ok = stream_close(&reader);
 
+    if (!read_ok || !write_ok) {
+        //namapované clustery uvolní mapa souboru, zbytek úseků se uvolní přímo
+        free_file_clusters(fs, &new_inode);
+        if (r < run_count) {
+            runs[r].start += run_offset;
+            runs[r].length -= run_offset;
+            free_clusters(fs, runs + r, run_count - r);
+        }
+        free(runs);
+        free_inode(fs, new_inode_id);
+        printf(write_ok ? "READING FILE FAILED\n" : "WRITING FILE FAILED\n");
+        return false;
+    }
+    free(runs);
 
     write_inode(fs, new_inode_id, &new_inode);
 
-
-    if (!add_to_dir(fs, dest_parent_id, clean_filename, new_inode_id)) {
+    //cílový adresář se zamyká jen na přidání položky, data se zapisují souběžně
+    inode_lock_set_t locks;
+    lock_set_init(&locks);
+    lock_set_add(&locks, dest_parent_id, true);
+    bool added = lock_set_acquire_checked(fs, &locks);
+    if (added) {
+        added = add_to_dir(fs, dest_parent_id, clean_filename, new_inode_id);
+        lock_set_release(fs, &locks);
+    }
+    if (!added) {
+        free_file_clusters(fs, &new_inode);
+        free_inode(fs, new_inode_id);
         printf("ADDING TO DIRECTORY FAILED\n");
-        free(data);
         return false;
     }
     
-    free(data);
     printf("OK\n");
     return true;
 }
 
-bool format(filesystem_t *fs, const char *size_str) {
-    int32_t size_mb = DEFAULT_FS_SIZE;
+bool format(session_t *session, const char *size_str) {
+    long long size = DEFAULT_FS_SIZE;
+    char unit[3] = "MB";
     if (size_str && *size_str) {
-        if (sscanf(size_str, "%dMB", &size_mb) != 1 || size_mb <= 0) {
+        int parsed = sscanf(size_str, "%lld%2s", &size, unit);
+        if (parsed < 1 || size <= 0 || (parsed == 2 && strcmp(unit, "MB") != 0 && strcmp(unit, "GB") != 0)) {
             printf("INVALID SIZE FORMAT WHILE FORMATTING\n");
             return false;
         }
     }
     
-    int32_t total_size = size_mb * 1024 * 1024;
-    int32_t cluster_count = total_size / CLUSTER_SIZE;
-    int32_t inode_count = cluster_count / 8;
-    
-    int32_t ibitmap_size = (inode_count + 7) / 8;
-    int32_t dbitmap_size = (cluster_count + 7) / 8;
-    int32_t inode_table_size = inode_count * sizeof(inode_t);
-    
-    memset(&fs->sb, 0, sizeof(superblock_t));
-    strcpy(fs->sb.signature, SIGNATURE);
-    strcpy(fs->sb.description, "ZOS Inodesystem");
-    fs->sb.disk_size = total_size;
-    fs->sb.cluster_size = CLUSTER_SIZE;
-    fs->sb.cluster_count = cluster_count;
-    fs->sb.inode_count = inode_count;
-    
-    int32_t offset = sizeof(superblock_t);
-    fs->sb.bitmapi_start = offset; offset += ibitmap_size;
-    fs->sb.bitmap_start = offset; offset += dbitmap_size;
-    fs->sb.inode_start = offset; offset += inode_table_size;
-    fs->sb.data_start = offset;
-    
-    save_superblock(fs);
-
-    if (fs->inode_bitmap != NULL) {
-        free(fs->inode_bitmap);
-        fs->inode_bitmap = NULL;
-    }
-    if (fs->data_bitmap != NULL) {
-        free(fs->data_bitmap);
-        fs->data_bitmap = NULL;
-    }
-    
-    // vytvoření bitmap
-    fs->inode_bitmap = calloc(1, ibitmap_size);
-    fs->data_bitmap = calloc(1, dbitmap_size);
-    save_bitmaps(fs);
-    
-    // vytvoření root adresáře
-    int32_t root_id = alloc_inode(fs);
-    if (root_id < 0) {
-        printf("CANNOT ALLOCATE ROOT INODE, MAYBE THE SIZE IS TOO BIG\n");
-        return false;
-    }
+    int64_t total_size = size * 1024 * 1024;
+    if (strcmp(unit, "GB") == 0) total_size *= 1024;
 
-    inode_t root = {0};
-    root.nodeid = root_id;
-    root.is_directory = true;
-    root.references = 1;
-    root.parent = root_id;
-
-    if (!write_inode(fs, root_id, &root)) {
-        printf("WRITING TO INODE FAILED\n");
-        return false;
+    switch (zosfs_format(session, total_size)) {
+        case ZOSFS_OK:
+            printf("OK\n");
+            return true;
+        case ZOSFS_EINVAL:
+            printf("INVALID SIZE FORMAT WHILE FORMATTING\n");
+            return false;
+        case ZOSFS_ENOSPC:
+            printf("CANNOT ALLOCATE ROOT INODE, MAYBE THE SIZE IS TOO BIG\n");
+            return false;
+        default:
+            printf("CANNOT MAP FILESYSTEM\n");
+            return false;
     }
-
-    
-    
-    fs->current_inode = root_id;
-    strcpy(fs->current_path, "/");
-    
-    printf("OK\n");
-    return true;
 }
 
 
 
-bool cd(filesystem_t *fs, const char *path) {
-    if (strcmp(path, "/") == 0) {  // jedná se o root složku
-        fs->current_inode = 0; 
-        strcpy(fs->current_path, "/");
-        printf("OK\n");
-        return true;
-    }
-    
-    // hledání cílové složky
-    int32_t target_inode = resolve_path(fs, path);
-    
-    if (target_inode < 0) {
-        printf("PATH NOT FOUND\n");
-        return false;
-    }
-    
-    // načtení i-uzlu cílové složky
-    inode_t target;
-    if (!read_inode(fs, target_inode, &target)) {
-        printf("READING INODE FAILED\n");
-        return false;
-    }
-
-
-    // test, jestli se vůbec jedná o složku
-    if (!target.is_directory) {
+bool cd(session_t *session, const char *path) {
+    zosfs_status_t status = zosfs_chdir(session, path);
+    if (status == ZOSFS_ENOTDIR) {
         printf("TARGET IS NOT A DIRECTORY\n");
         return false;
     }
-    
-
-    // absolutní cesta, začínáme od rootu
-    if (path[0] == '/') {
-        strcpy(fs->current_path, "/");
-    }
-
-
-    char path_copy[256];
-    strncpy(path_copy, path, sizeof(path_copy) - 1);
-    
-    char *token = strtok(path_copy, "/");
-    while (token != NULL) {
-        // aktualizace cesty po zpracování každého tokenu
-        update_path(fs->current_path, token); 
-        token = strtok(NULL, "/");
-    }
-
-
-    //aktualizace adresáře ve filesysztému
-    fs->current_inode = target_inode;
-        
-    printf("OK\n");
-    return true;
+    return report(status, "PATH NOT FOUND");
 }
 
 
 
-bool cat(filesystem_t *fs, const char *filename) {
-    // hledání souboru
-    int32_t file_inode_id = find_in_dir(fs, fs->current_inode, filename);
-    
-    if (file_inode_id < 0) {
-        printf("FILE NOT FOUND\n");
+bool cat(session_t *session, const char *filename) {
+    filesystem_t *fs = session->fs;
+    zosfs_file_t file;
+    zosfs_status_t status = zosfs_open(session, filename, &file);
+    if (status == ZOSFS_EISDIR) {
+        printf("ERROR - FILE IS A DIRECTORY\n");
         return false;
     }
-    
-    inode_t file_inode;
-    if (!read_inode(fs, file_inode_id, &file_inode)) {
-        printf("READING INODE FAILED\n");
+    if (status != ZOSFS_OK) return report(status, NULL);
+
+    size_t buffer_size = IO_RUN_CLUSTERS * fs->sb.cluster_size;
+    uint8_t *buffer = malloc(buffer_size);
+    if (!buffer) {
+        printf("READING FILE FAILED\n");
         return false;
     }
-    
-    if (file_inode.is_directory) {
-        printf("ERROR - FILE IS A DIRECTORY\n");
-        return false;
+
+    //fyzicky souvislé clustery čte knihovna jedním voláním
+    int64_t offset = 0;
+    size_t bytes;
+    while ((status = zosfs_read(fs, &file, offset, buffer, buffer_size, &bytes)) == ZOSFS_OK && bytes > 0) {
+        fwrite(buffer, 1, bytes, stdout);
+        offset += bytes;
     }
-    
-    int32_t clusters_needed = (file_inode.file_size + fs->sb.cluster_size - 1) / fs->sb.cluster_size;
-    uint8_t buffer[CLUSTER_SIZE];
-    int32_t bytes_read = 0;
-    
-    for (int32_t i = 0; i < clusters_needed; i++) {
-        int32_t cluster = get_file_cluster(fs, &file_inode, i);
-        if (cluster == 0) break;
-        
-        read_cluster(fs, cluster, buffer);
-        
-        // velikost vypsané zprávy - ošetření posledního clusteru
-        int32_t bytes_remaining = file_inode.file_size - bytes_read;
-        if (bytes_remaining > fs->sb.cluster_size) {
-            bytes_remaining = fs->sb.cluster_size;
-        }
-        
-        fwrite(buffer, 1, bytes_remaining, stdout);
-        bytes_read += bytes_remaining;
+    free(buffer);
+    if (status != ZOSFS_OK) {
+        printf("READING FILE FAILED\n");
+        return false;
     }
     
     printf("\n");
     return true;
 }
 
-void statfs(filesystem_t *fs) {
-    int32_t used_inodes = 0;
-    int32_t used_clusters = 0;
-    int32_t dir_count = 0;
-    
-//výpočet použitých inodů a clusterů
-    for (int32_t i = 0; i < fs->sb.inode_count; i++) {
-        if (is_bit_set(fs->inode_bitmap, i)) {
-            used_inodes++;
-            
-            inode_t inode;
-            if (!read_inode(fs, i, &inode) && inode.is_directory) {
-                dir_count++;
-            }
-        }
-    }
-    
-    for (int32_t i = 1; i < fs->sb.cluster_count; i++) {
-        if (is_bit_set(fs->data_bitmap, i)) {
-            used_clusters++;
-        }
-    }
-    
-    int32_t free_inodes = fs->sb.inode_count - used_inodes;
-    int32_t free_clusters = fs->sb.cluster_count - 1 - used_clusters;
+void statfs(session_t *session) {
+    zosfs_statfs_t st;
+    zosfs_statfs(session->fs, &st);
     
     printf("Statfs:\n");
     printf("----------------------\n");
-    printf("Velikost disku:        %.2f MB\n", fs->sb.disk_size / (1024.0 * 1024.0));      
-    printf("Velikost clusteru:     %d bytů\n", fs->sb.cluster_size);
-    printf("Počet clusterů:   %d\n", fs->sb.cluster_count - 1);
-    printf("Obsazené clustery:    %d\n", used_clusters);
-    printf("Volné clustery:    %d\n", free_clusters);
-    printf("Počet inodů:     %d\n", fs->sb.inode_count);
-    printf("Obsazené inody:      %d\n", used_inodes);
-    printf("Volné inody:      %d\n", free_inodes);
-    printf("Počet složek:      %d\n", dir_count);
+    printf("Velikost disku:        %.2f MB\n", st.disk_size / (1024.0 * 1024.0));      
+    printf("Velikost clusteru:     %d bytů\n", st.cluster_size);
+    printf("Počet clusterů:   %d\n", st.cluster_count);
+    printf("Obsazené clustery:    %d\n", st.used_clusters);
+    printf("Volné clustery:    %d\n", st.free_clusters);
+    printf("Počet inodů:     %d\n", st.inode_count);
+    printf("Obsazené inody:      %d\n", st.used_inodes);
+    printf("Volné inody:      %d\n", st.free_inodes);
+    printf("Počet složek:      %d\n", st.dir_count);
     
     // výpočet použitého místa
-    int32_t data_space = (fs->sb.cluster_count - 1) * fs->sb.cluster_size;
-    int32_t used_space = used_clusters * fs->sb.cluster_size;
-    int32_t free_space = free_clusters * fs->sb.cluster_size;
+    int64_t data_space = (int64_t)st.cluster_count * st.cluster_size;
+    int64_t used_space = (int64_t)st.used_clusters * st.cluster_size;
+    int64_t free_space = (int64_t)st.free_clusters * st.cluster_size;
     
     printf("\nPoužití místa:\n");
     printf("Celkové místo: %.2f MB\n", data_space / (1024.0 * 1024.0));        
     printf("Obsazené místo:       %.2f MB\n", used_space / (1024.0 * 1024.0));    
     printf("Volné místo:       %.2f MB\n", free_space / (1024.0 * 1024.0)); 
-    printf("Obsazenost:            %.1f%%\n", (used_clusters * 100.0) / (fs->sb.cluster_count - 1));
+    printf("Obsazenost:            %.1f%%\n", (st.used_clusters * 100.0) / st.cluster_count);
            
 }
 
 
-bool info(filesystem_t *fs, const char *path) {
-    if (!path || !path[0]) {
-        printf("FILE NOT FOUND\n");
-        return false;
-    }
-    
-    // najití souboru
-    int32_t inode_id = resolve_path(fs, path);
-    if (inode_id < 0) {
-        printf("FILE NOT FOUND\n");
-        return false;
-    }
-    
+// výpis informací o zamčeném i-uzlu
+static bool print_info(filesystem_t *fs, int32_t inode_id, const char *path) {
     inode_t inode;
     if (!read_inode(fs, inode_id, &inode)) {
         printf("READING INODE FAILED\n");
@@ -441,7 +302,29 @@ bool info(filesystem_t *fs, const char *path) {
     filename[sizeof(filename) - 1] = '\0';
     
 // Výpis veškerých informací o souboru
-    printf("%s - Velikost: %d B - i-node %d - ", filename, inode.file_size, inode_id);
+    printf("%s - Velikost: %lld B - i-node %d - ", filename, (long long)inode.file_size, inode_id);
+
+    //soubor mapovaný úseky (logický index, cluster, délka)
+    if (inode.format == INODE_FORMAT_EXTENTS) {
+        printf("Úseky:");
+        for (int i = 0; i < INLINE_EXTENTS && inode.extents[i].length > 0; i++) {
+            printf(" [%d: %d+%d]", inode.extents[i].logical, inode.extents[i].physical, inode.extents[i].length);
+        }
+        printf("\n");
+
+        if (inode.extent_tree > 0) {
+            uint8_t buffer[CLUSTER_SIZE];
+            extent_block_t *block = (extent_block_t *)buffer;
+            read_cluster(fs, inode.extent_tree, buffer);
+            printf("Cluster s úseky %d:", inode.extent_tree);
+            for (int i = 0; i < block->count && i < 10; i++) {
+                printf(" [%d: %d+%d]", block->extents[i].logical, block->extents[i].physical, block->extents[i].length);
+            }
+            if (block->count > 10) printf(" ... (%d dalších)", block->count - 10);
+            printf("\n");
+        }
+        return true;
+    }
     
     printf("Přímé odkazy: %d, %d, %d, %d, %d\n", 
            inode.direct1, inode.direct2, inode.direct3, inode.direct4, inode.direct5);
@@ -472,18 +355,61 @@ bool info(filesystem_t *fs, const char *path) {
     return true;
 }
 
-bool cp(filesystem_t *fs, const char *src_path, const char *dest_path) {
-    if (!src_path || !src_path[0] || !dest_path || !dest_path[0]) {
+bool info(session_t *session, const char *path) {
+    filesystem_t *fs = session->fs;
+    if (!path || !path[0]) {
         printf("FILE NOT FOUND\n");
         return false;
     }
     
-    int32_t src_inode_id = resolve_path(fs, src_path);
-    if (src_inode_id < 0) {
+    // najití souboru
+    int32_t inode_id = resolve_path(fs, session->current_inode, path);
+
+    inode_lock_set_t locks;
+    lock_set_init(&locks);
+    lock_set_add(&locks, inode_id, false);
+    if (inode_id < 0 || !lock_set_acquire_checked(fs, &locks)) {
         printf("FILE NOT FOUND\n");
         return false;
     }
-    
+
+    bool ok = print_info(fs, inode_id, path);
+    lock_set_release(fs, &locks);
+    return ok;
+}
+
+// zamkne zdrojový soubor (sdíleně) a cílový adresář (výhradně) příkazu cp
+static bool lock_copy(session_t *session, inode_lock_set_t *locks, const char *src_path, const char *dest_path,
+                      int32_t *src_inode_id, int32_t *dest_parent, char *dest_filename) {
+    filesystem_t *fs = session->fs;
+    if (!src_path || !src_path[0] || !dest_path || !dest_path[0]) {
+        printf("FILE NOT FOUND\n");
+        return false;
+    }
+
+    *src_inode_id = resolve_path(fs, session->current_inode, src_path);
+    if (*src_inode_id < 0) {
+        printf("FILE NOT FOUND\n");
+        return false;
+    }
+
+    if (!split_path(fs, session->current_inode, dest_path, dest_parent, dest_filename)) {
+        printf("PATH NOT FOUND\n");
+        return false;
+    }
+
+    lock_set_init(locks);
+    lock_set_add(locks, *src_inode_id, false);
+    lock_set_add(locks, *dest_parent, true);
+    if (!lock_set_acquire_checked(fs, locks)) {
+        printf("FILE NOT FOUND\n");
+        return false;
+    }
+    return true;
+}
+
+// kopie zamčeného souboru do zamčeného adresáře
+static bool copy_file(filesystem_t *fs, int32_t src_inode_id, int32_t dest_parent, const char *dest_filename) {
     inode_t src_inode;
     if (!read_inode(fs, src_inode_id, &src_inode)) {
         printf("READING INODE FAILED\n");
@@ -503,35 +429,27 @@ bool cp(filesystem_t *fs, const char *src_path, const char *dest_path) {
         return false;
     }
     
-    int32_t bytes_read = 0;
+    int64_t bytes_read = 0;
     int32_t clusters_needed = (src_inode.file_size + fs->sb.cluster_size - 1) / fs->sb.cluster_size;
-    uint8_t buffer[CLUSTER_SIZE];
     //přečtení clusterů a kopírování do paměti
-    for (int32_t i = 0; i < clusters_needed; i++) {
-        int32_t cluster = get_file_cluster(fs, &src_inode, i);
-        if (cluster == 0) break;
-        
-        read_cluster(fs, cluster, buffer);
+    bmap_iter_t it;
+    bmap_iter_init(&it, fs, &src_inode);
+    int32_t start, length;
+    while (bmap_next_run(&it, it.count, &start, &length)) {
+        if (start == 0) break;
         
-        int32_t bytes_to_copy = src_inode.file_size - bytes_read;
-        if (bytes_to_copy > fs->sb.cluster_size) {
-            bytes_to_copy = fs->sb.cluster_size;
+        //souvislý úsek se čte rovnou do cílového bufferu
+        int64_t bytes_to_copy = src_inode.file_size - bytes_read;
+        if (bytes_to_copy > (int64_t)length * fs->sb.cluster_size) {
+            bytes_to_copy = (int64_t)length * fs->sb.cluster_size;
         }
         
-        memcpy(file_data + bytes_read, buffer, bytes_to_copy);
+        read_clusters(fs, start, length, file_data + bytes_read, bytes_to_copy);
         bytes_read += bytes_to_copy;
     }
     
 //Vytvoření cílového souboru
 
-    int32_t dest_parent;
-    char dest_filename[NAME_SIZE];
-    
-    if (!split_path(fs, dest_path, &dest_parent, dest_filename)) {
-        printf("PATH NOT FOUND\n");
-        return false;
-    }
-    
     // Kontrola, zda cílový soubor neexistuje
     if (find_in_dir(fs, dest_parent, dest_filename) >= 0) {
         free(file_data);
@@ -551,35 +469,52 @@ bool cp(filesystem_t *fs, const char *src_path, const char *dest_path) {
     dest_inode.nodeid = dest_inode_id;
     dest_inode.is_directory = false;
     dest_inode.references = 1;
+    init_file_map(&dest_inode);
     dest_inode.file_size = src_inode.file_size;
     
     //Zapsání dat do alokovaných clusterů
     clusters_needed = (src_inode.file_size + fs->sb.cluster_size - 1) / fs->sb.cluster_size;
-    for (int32_t i = 0; i < clusters_needed; i++) {
-        int32_t cluster = alloc_cluster(fs);
-        if (cluster < 0) {
+    cluster_run_t *runs;
+    int32_t run_count = alloc_clusters(fs, clusters_needed, 0, &runs);
+    if (run_count < 0) {
+        free(file_data);
+        free_inode(fs, dest_inode_id);
+        printf("CANNOT CREATE FILE\n");
+        return false;
+    }
+
+    int32_t i = 0;
+    for (int32_t r = 0; r < run_count; r++) {
+        //celý úsek jedním zápisem, poslední cluster se doplní nulami
+        int64_t offset = (int64_t)i * fs->sb.cluster_size;
+        int64_t to_write = src_inode.file_size - offset;
+        if (to_write > (int64_t)runs[r].length * fs->sb.cluster_size) {
+            to_write = (int64_t)runs[r].length * fs->sb.cluster_size;
+        }
+        if (!write_clusters(fs, runs[r].start, runs[r].length, file_data + offset, to_write)) {
+            //namapované úseky uvolní mapa souboru, zbylé se uvolní přímo
+            free_file_clusters(fs, &dest_inode);
+            free_clusters(fs, runs + r, run_count - r);
+            free(runs);
+            free_inode(fs, dest_inode_id);
             free(file_data);
-            printf("CANNOT CREATE FILE\n");
+            printf("WRITING FILE FAILED\n");
             return false;
         }
-        
-        int32_t offset = i * fs->sb.cluster_size;
-        int32_t to_write = src_inode.file_size - offset;
-        if (to_write > fs->sb.cluster_size) {
-            to_write = fs->sb.cluster_size;
+
+        for (int32_t cluster = runs[r].start; cluster < runs[r].start + runs[r].length; cluster++, i++) {
+            set_file_cluster(fs, &dest_inode, i, cluster);
         }
-        
-        memset(buffer, 0, CLUSTER_SIZE);
-        memcpy(buffer, file_data + offset, to_write);
-        write_cluster(fs, cluster, buffer);
-        set_file_cluster(fs, &dest_inode, i, cluster);
     }
+    free(runs);
     
 
     write_inode(fs, dest_inode_id, &dest_inode);
     
     //přidání do adresáře
     if (add_to_dir(fs, dest_parent, dest_filename, dest_inode_id) == false) {
+        free_file_clusters(fs, &dest_inode);
+        free_inode(fs, dest_inode_id);
         free(file_data);
         printf("ERROR - ADD TO DIRECTORY FAILED\n");
         return false;
@@ -590,246 +525,139 @@ bool cp(filesystem_t *fs, const char *src_path, const char *dest_path) {
     return true;
 }
 
+bool cp(session_t *session, const char *src_path, const char *dest_path) {
+    int32_t src_inode_id, dest_parent;
+    char dest_filename[NAME_SIZE];
+    inode_lock_set_t locks;
+    if (!lock_copy(session, &locks, src_path, dest_path, &src_inode_id, &dest_parent, dest_filename)) return false;
 
-bool rm(filesystem_t *fs, const char *path) {
-    if (!path || !path[0]) {
-        printf("FILE NOT FOUND\n");
-        return false;
-    }
-    
-    //nalezení inodu souboru
-    int32_t file_inode_id = resolve_path(fs, path);
-    
-    if (file_inode_id < 0) {
-        printf("FILE NOT FOUND\n");
+    bool ok = copy_file(session->fs, src_inode_id, dest_parent, dest_filename);
+    lock_set_release(session->fs, &locks);
+    return ok;
+}
+
+
+// namapuje úsek clusterů jiného souboru do i-uzlu bez kopírování dat, čítače odkazů se zvýší
+static bool share_file_run(filesystem_t *fs, inode_t *inode, int32_t index, int32_t start, int32_t length) {
+    //díra v souboru zůstane dírou
+    if (start == 0) return true;
+
+    int32_t shared = 0;
+    while (shared < length && share_cluster(fs, start + shared)) shared++;
+
+    if (shared < length || set_file_run(fs, inode, index, start, length) < 0) {
+        //čítače úseku, který se nenamapoval, se vrátí zpět
+        for (int32_t i = 0; i < shared; i++) unshare_cluster(fs, start + i);
         return false;
     }
-    
-    inode_t file_inode;
-    if (!read_inode(fs, file_inode_id, &file_inode)) {
+    return true;
+}
+
+// kopie zamčeného souboru sdílením clusterů
+static bool reflink_file(filesystem_t *fs, int32_t src_inode_id, int32_t dest_parent, const char *dest_filename) {
+    inode_t src_inode;
+    if (!read_inode(fs, src_inode_id, &src_inode)) {
         printf("READING INODE FAILED\n");
         return false;
     }
-    
-    //jedná se o adresář - špatný příkaz
-    if (file_inode.is_directory) {
-        printf("ERROR - TARGET IS A DIRECTORY\n");
+
+    if (src_inode.is_directory) {
+        printf("ERROR - SOURCE IS A DIRECTORY\n");
         return false;
     }
-    
-    
-    //int32_t clusters_needed = (file_inode.file_size + fs->sb.cluster_size - 1) / fs->sb.cluster_size;
-    //Uvolnění clusteru a všech obsazených datových bloků
-    
-    if (file_inode.direct1 > 0) free_cluster(fs, file_inode.direct1);
-    if (file_inode.direct2 > 0) free_cluster(fs, file_inode.direct2);
-    if (file_inode.direct3 > 0) free_cluster(fs, file_inode.direct3);
-    if (file_inode.direct4 > 0) free_cluster(fs, file_inode.direct4);
-    if (file_inode.direct5 > 0) free_cluster(fs, file_inode.direct5);
-    
-
-    if (file_inode.indirect1 > 0) {
 
-        int32_t pointers[PTRS_PER_CLUSTER];
-        read_cluster(fs, file_inode.indirect1, pointers);
-        
-        for (int i = 0; i < (int32_t)PTRS_PER_CLUSTER && pointers[i] > 0; i++) {
-            free_cluster(fs, pointers[i]);
-        }
-        
-
-        free_cluster(fs, file_inode.indirect1);
+    if (find_in_dir(fs, dest_parent, dest_filename) >= 0) {
+        printf("DESTINATION ALREADY EXISTS\n");
+        return false;
     }
-    
-    if (file_inode.indirect2 > 0) {
 
-        int32_t l1_pointers[PTRS_PER_CLUSTER];
-        read_cluster(fs, file_inode.indirect2, l1_pointers);
-        
-        for (int i = 0; i < (int32_t)PTRS_PER_CLUSTER && l1_pointers[i] > 0; i++) {
+    int32_t dest_inode_id = alloc_inode(fs);
+    if (dest_inode_id < 0) {
+        printf("CANNOT CREATE FILE\n");
+        return false;
+    }
 
-            int32_t l2_pointers[PTRS_PER_CLUSTER];
-            read_cluster(fs, l1_pointers[i], l2_pointers);
-            
-            for (int j = 0; j < (int32_t)PTRS_PER_CLUSTER && l2_pointers[j] > 0; j++) {
-                free_cluster(fs, l2_pointers[j]);
-            }
-            
-            free_cluster(fs, l1_pointers[i]);
-        }
+    inode_t dest_inode = {0};
+    dest_inode.nodeid = dest_inode_id;
+    dest_inode.is_directory = false;
+    dest_inode.references = 1;
+    init_file_map(&dest_inode);
+    dest_inode.file_size = src_inode.file_size;
 
-        free_cluster(fs, file_inode.indirect2);
+    //data se nečtou ani nezapisují - cíl dostane stejné clustery a jejich čítače se zvýší
+    bool ok = true;
+    int32_t index = 0;
+    bmap_iter_t it;
+    bmap_iter_init(&it, fs, &src_inode);
+    int32_t start, length;
+    while (ok && bmap_next_run(&it, it.count, &start, &length)) {
+        ok = share_file_run(fs, &dest_inode, index, start, length);
+        index += length;
+    }
+
+    if (!ok) {
+        //již namapované úseky - uvolnění jen sníží jejich čítače
+        free_file_clusters(fs, &dest_inode);
+        free_inode(fs, dest_inode_id);
+        printf("CANNOT CREATE FILE\n");
+        return false;
     }
-    
-
-    clear_bit(fs->inode_bitmap, file_inode_id);
-    save_bitmaps(fs);
-    
 
-    //zjištění jména souboru a cílového umístění
+    write_inode(fs, dest_inode_id, &dest_inode);
 
-    int32_t parent_inode;
-    char filename[NAME_SIZE];
-    
-    if (!split_path(fs, path, &parent_inode, filename)) {
-        printf("FILE NOT FOUND\n");
-        return false;
-    }
-    
-    // odstranění z nadřazeného adresáře
-    if (!remove_from_dir(fs, parent_inode, filename)) {
-        printf("REMOVING FROM DIRECTORY FAILED\n");
+    if (add_to_dir(fs, dest_parent, dest_filename, dest_inode_id) == false) {
+        //uvolnění sdílených clusterů jen vrátí jejich čítače
+        free_file_clusters(fs, &dest_inode);
+        free_inode(fs, dest_inode_id);
+        printf("ERROR - ADD TO DIRECTORY FAILED\n");
         return false;
     }
-    
+
     printf("OK\n");
     return true;
 }
 
-bool rmdir(filesystem_t *fs, const char *path) {
-    if (!path || !path[0]) {
-        printf("FILE NOT FOUND\n");
-        return false;
-    }
-    
-    //nalezení inodu
-    int32_t dir_inode_id = resolve_path(fs, path);
-    
-    if (dir_inode_id < 0) {
-        printf("FILE NOT FOUND\n");
-        return false;
-    }
-    
-    //nemůže se jednat o root adresář
-    if (dir_inode_id == 0) {
-        printf("FILE NOT FOUND\n");
-        return false;
-    }
-    
-
-    inode_t dir_inode;
-    if (!read_inode(fs, dir_inode_id, &dir_inode)) {
-        printf("READING INODE FAILED\n");
-        return false;
-    }
-    
-    //musí se jednat o adresář
-    if (!dir_inode.is_directory) {
-        printf("ERROR - TARGET IS NOT A DIRECTORY\n");
+bool cp_reflink(session_t *session, const char *src_path, const char *dest_path) {
+    //obraz bez tabulky čítačů (starší formát) clustery sdílet neumí
+    if (src_path && src_path[0] && dest_path && dest_path[0] && !refcount_supported(session->fs)) {
+        printf("REFLINK NOT SUPPORTED BY THIS FILESYSTEM\n");
         return false;
     }
-    
-
-    int32_t cluster_count = (dir_inode.file_size + fs->sb.cluster_size - 1) / fs->sb.cluster_size;
-    dir_item_t entries[ENTRIES_PER_CLUSTER];
-    
-    for (int32_t i = 0; i < cluster_count; i++) {
-        int32_t cluster = get_file_cluster(fs, &dir_inode, i);
-        if (cluster == 0) continue;
-        read_cluster(fs, cluster, entries);
-        
-        for (int j = 0; j < (int32_t)ENTRIES_PER_CLUSTER; j++) {
-            if (entries[j].inode != 0) {
-                //Složka není prázdná
-                printf("ERROR - DIRECTORY IS NOT EMPTY\n");
-                return false;
-            }
-        }
-    }
-    
-    //uvolnění inodu a clusterů
-    if (dir_inode.direct1 > 0) free_cluster(fs, dir_inode.direct1);
-    if (dir_inode.direct2 > 0) free_cluster(fs, dir_inode.direct2);
-    if (dir_inode.direct3 > 0) free_cluster(fs, dir_inode.direct3);
-    if (dir_inode.direct4 > 0) free_cluster(fs, dir_inode.direct4);
-    if (dir_inode.direct5 > 0) free_cluster(fs, dir_inode.direct5);
-    
 
-    clear_bit(fs->inode_bitmap, dir_inode_id);
-    save_bitmaps(fs);
+    int32_t src_inode_id, dest_parent;
+    char dest_filename[NAME_SIZE];
+    inode_lock_set_t locks;
+    if (!lock_copy(session, &locks, src_path, dest_path, &src_inode_id, &dest_parent, dest_filename)) return false;
 
-    
-    int32_t parent_inode;
-    char dirname[NAME_SIZE];
-    
-    if (!split_path(fs, path, &parent_inode, dirname)) {
-        printf("FILE NOT FOUND\n");
-        return false;
-    }
-    
-    if (!remove_from_dir(fs, parent_inode, dirname)) {
-        printf("REMOVING FROM DIRECTORY FAILED\n");
-        return false;
-    }
-    
-    printf("OK\n");
-    return true;
+    bool ok = reflink_file(session->fs, src_inode_id, dest_parent, dest_filename);
+    lock_set_release(session->fs, &locks);
+    return ok;
 }
 
 
+bool rm(session_t *session, const char *path) {
+    return report(zosfs_unlink(session, path), NULL);
+}
 
-bool mv(filesystem_t *fs, const char *src_path, const char *dest_path) {
-    int32_t src_parent, src_id;
-    char src_name[NAME_SIZE];
+bool rmdir(session_t *session, const char *path) {
+    return report(zosfs_rmdir(session, path), NULL);
+}
 
-    if (!split_path(fs, src_path, &src_parent, src_name)) {
-        printf("FILE NOT FOUND\n");
-        return false;
-    }
 
-    src_id = find_in_dir(fs, src_parent, src_name);
-    if (src_id <= 0) {
-        printf("FILE NOT FOUND\n");
-        return false;
-    }
-
-    int32_t dest_parent;
-    char dest_name[NAME_SIZE];
-
-    //KOntrola, zda cílová cesta již existuje
-    int32_t dest_check = resolve_path(fs, dest_path);
-    if (dest_check >= 0) {
-        inode_t d_node;
-        read_inode(fs, dest_check, &d_node);
-        if (d_node.is_directory) {
-            dest_parent = dest_check;
-            strcpy(dest_name, src_name);
-        } else {
-            printf("FILE ALREADY EXISTS\n");
-            return false;
-        }
-    } else {
-        if (!split_path(fs, dest_path, &dest_parent, dest_name)) {
-            printf("PATH NOT FOUND\n");
-            return false;
-        }
-    }
 
-    if (find_in_dir(fs, dest_parent, dest_name) >= 0) {
-        printf("FILE WITH THIS NAME ALREADY EXISTS\n");
+bool mv(session_t *session, const char *src_path, const char *dest_path) {
+    zosfs_status_t status = zosfs_rename(session, src_path, dest_path);
+    if (status == ZOSFS_EEXIST) {
+        printf("FILE ALREADY EXISTS\n");
         return false;
     }
-
-    if (remove_from_dir(fs, src_parent, src_name)) {
-        add_to_dir(fs, dest_parent, dest_name, src_id);
-        printf("OK\n");
-        return true;
-    }
-    return false;
+    return report(status, NULL);
 }
 
 
 
-bool outcp(filesystem_t *fs, const char *src, const char *dest) {
-    //Nalezení souboru ve filewsystému
-    int32_t file_inode_id = resolve_path(fs, src);
-    
-    if (file_inode_id < 0) {
-        printf("FILE NOT FOUND\n");
-        return false;
-    }
-    
-
+// export zamčeného souboru
+static bool export_file(filesystem_t *fs, int32_t file_inode_id, const char *dest) {
     inode_t file_inode;
     if (!read_inode(fs, file_inode_id, &file_inode)) {
         printf("READING INODE FAILED\n");
@@ -848,31 +676,22 @@ bool outcp(filesystem_t *fs, const char *src, const char *dest) {
         return false;
     }
     
-    int32_t clusters_needed = (file_inode.file_size + fs->sb.cluster_size - 1) / fs->sb.cluster_size;
-    uint8_t buffer[CLUSTER_SIZE];
-    int32_t bytes_written = 0;
+    int64_t bytes_written = 0;
     
-    //Čtení dat z clusterů a zápis do výsledného souboru
-    for (int32_t i = 0; i < clusters_needed; i++) {
-        int32_t cluster = get_file_cluster(fs, &file_inode, i);
-        if (cluster == 0) break;
-        
-        if (!read_cluster(fs, cluster, buffer)) {
-            fclose(dest_file);
-            printf("READING CLUSTER FAILED\n");
-            return false;
-        }
+    //souvislé úseky clusterů kopíruje rovnou jádro z obrazu do výsledného souboru
+    bmap_iter_t it;
+    bmap_iter_init(&it, fs, &file_inode);
+    int32_t start, length;
+    while (bmap_next_run(&it, it.count, &start, &length)) {
+        if (start == 0) break;
         
-        //poslední cluster
-        int32_t bytes_remaining = file_inode.file_size - bytes_written;
-        int32_t to_write;
-        if (bytes_remaining > fs->sb.cluster_size) {
-            to_write = fs->sb.cluster_size;
-        } else {
-            to_write = bytes_remaining;
+        //z posledního clusteru jen platná část
+        int64_t to_write = file_inode.file_size - bytes_written;
+        if (to_write > (int64_t)length * fs->sb.cluster_size) {
+            to_write = (int64_t)length * fs->sb.cluster_size;
         }
 
-        if (fwrite(buffer, 1, to_write, dest_file) != (size_t)to_write) {
+        if (!export_clusters(fs, start, length, to_write, fileno(dest_file))) {
             fclose(dest_file);
             printf("ERROR\n");
             return false;
@@ -886,9 +705,122 @@ bool outcp(filesystem_t *fs, const char *src, const char *dest) {
     return true;
 }
 
+bool outcp(session_t *session, const char *src, const char *dest) {
+    filesystem_t *fs = session->fs;
+    //Nalezení souboru ve filewsystému
+    int32_t file_inode_id = resolve_path(fs, session->current_inode, src);
+    
+    inode_lock_set_t locks;
+    lock_set_init(&locks);
+    lock_set_add(&locks, file_inode_id, false);
+    if (file_inode_id < 0 || !lock_set_acquire_checked(fs, &locks)) {
+        printf("FILE NOT FOUND\n");
+        return false;
+    }
 
+    bool ok = export_file(fs, file_inode_id, dest);
+    lock_set_release(fs, &locks);
+    return ok;
+}
 
-bool load(filesystem_t *fs, const char *filename) {
+
+
+bool execute_line(session_t *session, const char *line) {
+    filesystem_t *fs = session->fs;
+
+    // načtení příkazů a jejich argumentů
+    char cmd[64] = {0}, arg1[256] = {0}, arg2[256] = {0}, arg3[256] = {0}, arg4[256] = {0};
+    sscanf(line, "%63s %255s %255s %255s %255s", cmd, arg1, arg2, arg3, arg4);
+    
+    if (cmd[0] == '\0') {
+        return true;
+    }
+    
+    bool success = false;
+    
+    if (strcmp(cmd, "format") == 0) {
+        success = format(session, arg1);
+    }
+    else if (strcmp(cmd, "mkdir") == 0) {
+        success = mkdir(session, arg1);
+    }
+    else if (strcmp(cmd, "pwd") == 0) {
+        pwd(session);
+        success = true;
+    }
+    else if (strcmp(cmd, "ls") == 0) {
+        success = ls(session, arg1[0] ? arg1 : NULL);
+    }
+    else if (strcmp(cmd, "cd") == 0) {
+        success = cd(session, arg1);
+    }
+    else if (strcmp(cmd, "cat") == 0) {
+        success = cat(session, arg1);
+    }
+    else if (strcmp(cmd, "incp") == 0) {
+        success = incp(session, arg1, arg2);
+    }
+    else if (strcmp(cmd, "outcp") == 0) {
+        success = outcp(session, arg1, arg2);
+    }
+    else if (strcmp(cmd, "statfs") == 0) {
+        statfs(session);
+        success = true;
+    }
+    else if (strcmp(cmd, "info") == 0) {
+        success = info(session, arg1);
+    }
+    else if (strcmp(cmd, "cp") == 0 && strcmp(arg1, "--reflink") == 0) {
+        success = cp_reflink(session, arg2, arg3);
+    }
+    else if (strcmp(cmd, "cp") == 0) {
+        success = cp(session, arg1, arg2);
+    }
+    else if (strcmp(cmd, "rm") == 0) {
+        success = rm(session, arg1);
+    }
+    else if (strcmp(cmd, "rmdir") == 0) {
+        success = rmdir(session, arg1);
+    }
+    else if (strcmp(cmd, "mv") == 0) {
+        success = mv(session, arg1, arg2);
+    }
+    else if (strcmp(cmd, "xcp") == 0 && strcmp(arg1, "--reflink") == 0) {
+        success = xcp_reflink(session, arg2, arg3, arg4);
+    }
+    else if (strcmp(cmd, "xcp") == 0) {
+        success = xcp(session, arg1, arg2, arg3);
+    }
+    else if (strcmp(cmd, "add") == 0) {
+        success = add(session, arg1, arg2);
+    }
+    else if (strcmp(cmd, "sync") == 0) {
+        success = report(zosfs_sync(fs), NULL);
+    }
+    else if (strcmp(cmd, "cachestat") == 0) {
+        cachestat(session);
+        success = true;
+    }
+    else if (strcmp(cmd, "trace") == 0) {
+        success = trace(session, arg1, arg2);
+    }
+    else {
+        printf("Unknown command: %s\n", cmd);
+        success = false;
+    }
+    command_done(fs);
+    return success;
+}
+
+// prázdný řádek nebo řádek jen s mezerami
+static bool blank_line(const char *line) {
+    return line[strspn(line, " \t\r")] == '\0';
+}
+
+// vykoná příkazy ze souboru, batch < 0 = každý příkaz se ukládá sám,
+// jinak se změny ukládají po batch příkazech (0 = až na konci souboru)
+static bool run_script(session_t *session, const char *filename, int32_t batch) {
+    filesystem_t *fs = session->fs;
     if (!filename || !filename[0]) {
         printf("FILE NOT FOUND\n");
         return false;
@@ -901,92 +833,60 @@ bool load(filesystem_t *fs, const char *filename) {
     }
     
     char line[512];
-    //int line_number = 0;
-    bool ok = false;
+    int line_number = 0;
+    bool ok = true;
+
+    //v dávce command_done nic neukládá
+    bool outer_batch = fs->in_batch;
+    int32_t commands = 0, failed = 0, in_batch = 0, splits = 0;
+    uint64_t oversized = fs->journal ? fs->journal->oversized : 0;
+    if (batch >= 0) fs->in_batch = true;
     
     //čtení a vykonávání kódu po řádcích
     while (fgets(line, sizeof(line), file)) {
-        //line_number++;
+        line_number++;
         size_t len = strlen(line);
         if (len > 0 && line[len - 1] == '\n') {
             line[len - 1] = '\0';
         }
         
-        if (line[0] == '\0') {
-            continue;
-        }
-        
-        // načtení příkazů a jejich argumentů
-        char cmd[64] = {0}, arg1[256] = {0}, arg2[256] = {0}, arg3[256] = {0};
-        sscanf(line, "%s %s %s %s", cmd, arg1, arg2, arg3);
-        
-        if (cmd[0] == '\0') {
+        if (blank_line(line)) {
             continue;
         }
         
-        bool success = false;
-        
-        if (strcmp(cmd, "format") == 0) {
-            success = format(fs, arg1);
-        }
-        else if (strcmp(cmd, "mkdir") == 0) {
-            success = mkdir(fs, arg1);
-        }
-        else if (strcmp(cmd, "pwd") == 0) {
-            pwd(fs);
-            success = true;
-        }
-        else if (strcmp(cmd, "ls") == 0) {
-            success = ls(fs, arg1[0] ? arg1 : NULL);
-        }
-        else if (strcmp(cmd, "cd") == 0) {
-            success = cd(fs, arg1);
-        }
-        else if (strcmp(cmd, "cat") == 0) {
-            success = cat(fs, arg1);
-        }
-        else if (strcmp(cmd, "incp") == 0) {
-            success = incp(fs, arg1, arg2);
-        }
-        else if (strcmp(cmd, "outcp") == 0) {
-            success = outcp(fs, arg1, arg2);
-        }
-        else if (strcmp(cmd, "statfs") == 0) {
-            statfs(fs);
-            success = true;
-        }
-        else if (strcmp(cmd, "info") == 0) {
-            success = info(fs, arg1);
-        }
-        else if (strcmp(cmd, "cp") == 0) {
-            success = cp(fs, arg1, arg2);
-        }
-        else if (strcmp(cmd, "rm") == 0) {
-            success = rm(fs, arg1);
-        }
-        else if (strcmp(cmd, "rmdir") == 0) {
-            success = rmdir(fs, arg1);
-        }
-        else if (strcmp(cmd, "mv") == 0) {
-            success = mv(fs, arg1, arg2);
-        }
-        else if (strcmp(cmd, "xcp") == 0) {
-            success = xcp(fs, arg1, arg2, arg3);
-        }
-        else if (strcmp(cmd, "add") == 0) {
-            success = add(fs, arg1, arg2);
-        }
-        else {
-            printf("Unknown command: %s\n", cmd);
-            success = false;
-        }
+        bool success = execute_line(session, line);
         if (!success) {
             ok = false;
         }
-        
+
+        if (batch >= 0) {
+            //chyba příkazu dávku nepřeruší, jen se ohlásí
+            commands++;
+            if (!success) {
+                failed++;
+                printf("LINE %d FAILED: %s\n", line_number, line);
+            }
+            if (batch > 0 && ++in_batch >= batch) {
+                zosfs_sync(fs);
+                in_batch = 0;
+            } else if (!journal_fits(fs, unsynced_bytes(fs))) {
+                //větší dávka by se do logu nevešla a zapsala se bez atomicity - uloží se po příkazech
+                zosfs_sync(fs);
+                in_batch = 0;
+                splits++;
+            }
+        }
     }
     
     fclose(file);
+
+    if (batch >= 0) {
+        fs->in_batch = outer_batch;
+        if (zosfs_sync(fs) != ZOSFS_OK) printf("SYNC FAILED\n");
+        printf("BATCH: %d commands, %d failed\n", commands, failed);
+        if (splits > 0) printf("WARNING: BATCH EXCEEDED JOURNAL, STORED AS %d TRANSACTIONS\n", splits + 1);
+        if (fs->journal && fs->journal->oversized > oversized) printf("WARNING: TRANSACTION EXCEEDED JOURNAL, WRITTEN WITHOUT ATOMICITY\n");
+    }
     
     if (ok) {
         printf("OK\n");
@@ -995,128 +895,194 @@ bool load(filesystem_t *fs, const char *filename) {
     return ok;
 }
 
+// řádek skriptu pro souběžné vykonání
+typedef struct {
+    int line_number;
+    char *text;
+} script_line_t;
+
+// sdílený stav load --parallel
+typedef struct {
+    session_t session;              //výchozí sezení, vlákna pracují s kopiemi
+    script_line_t *lines;
+    int32_t line_count;
+    _Atomic int32_t next;           //další nevykonaný řádek
+    _Atomic int32_t failed;
+} parallel_run_t;
+
+// příkazy nad celým systémem souborů nebo jeho globálním stavem běží bez ostatních vláken
+static bool exclusive_command(const char *line) {
+    char cmd[64] = {0};
+    sscanf(line, "%63s", cmd);
+    return strcmp(cmd, "format") == 0 || strcmp(cmd, "sync") == 0 ||
+           strcmp(cmd, "trace") == 0 || strcmp(cmd, "cachestat") == 0;
+}
 
+static void *parallel_worker(void *arg) {
+    parallel_run_t *run = arg;
+    session_t session = run->session;
 
-bool xcp(filesystem_t *fs, const char *f1, const char *f2, const char *f3) {
-    if (!f1 || !f1[0] || !f2 || !f2[0] || 
-        !f3 || !f3[0]) {
-        printf("FILE NOT FOUND\n");
-        return false;
+    int32_t i;
+    while ((i = atomic_fetch_add(&run->next, 1)) < run->line_count) {
+        script_line_t *line = &run->lines[i];
+        fs_rwlock(session.fs, RWLOCK_COMMANDS, exclusive_command(line->text));
+        bool success = execute_line(&session, line->text);
+        fs_rwunlock(session.fs, RWLOCK_COMMANDS);
+
+        if (!success) {
+            atomic_fetch_add(&run->failed, 1);
+            printf("LINE %d FAILED: %s\n", line->line_number, line->text);
+        }
     }
-    
-    //Nalezení a načtení obou souborů
-    int32_t f1_inode_id = resolve_path(fs, f1);
-    if (f1_inode_id < 0) {
-        printf("FILE NOT FOUND\n");
-        return false;
+    return NULL;
+}
+
+// načte neprázdné řádky skriptu, vrací jejich počet nebo -1
+static int32_t read_script(const char *filename, script_line_t **lines) {
+    FILE *file = fopen(filename, "r");
+    if (!file) return -1;
+
+    char line[512];
+    int line_number = 0;
+    int32_t count = 0, capacity = 0;
+    *lines = NULL;
+    while (fgets(line, sizeof(line), file)) {
+        line_number++;
+        line[strcspn(line, "\n")] = '\0';
+        if (blank_line(line)) continue;
+
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            script_line_t *grown = realloc(*lines, capacity * sizeof(script_line_t));
+            if (!grown) break;
+            *lines = grown;
+        }
+        (*lines)[count].line_number = line_number;
+        (*lines)[count].text = strdup(line);
+        if (!(*lines)[count].text) break;
+        count++;
     }
-    
-    inode_t f1_inode;
-    if (!read_inode(fs, f1_inode_id, &f1_inode) || f1_inode.is_directory) {
-        printf("READING INODE FAILED\n");
+    fclose(file);
+    return count;
+}
+
+bool load(session_t *session, const char *filename) {
+    return run_script(session, filename, -1);
+}
+
+bool load_batch(session_t *session, const char *filename, int32_t batch) {
+    if (batch < 0) {
+        printf("INVALID BATCH SIZE\n");
         return false;
     }
-    
-    int32_t f2_inode_id = resolve_path(fs, f2);
-    if (f2_inode_id < 0) {
+    return run_script(session, filename, batch);
+}
+
+bool load_parallel(session_t *session, const char *filename, int32_t workers) {
+    filesystem_t *fs = session->fs;
+    if (!filename || !filename[0]) {
         printf("FILE NOT FOUND\n");
         return false;
     }
-    
-    inode_t f2_inode;
-    if (!read_inode(fs, f2_inode_id, &f2_inode) || f2_inode.is_directory) {
-        printf("READING INODE FAILED\n");
+    if (workers < 1 || workers > MAX_WORKERS) {
+        printf("INVALID WORKER COUNT\n");
         return false;
     }
-    
-    //Načtení obsahu obou souborů
-    uint8_t *f1_data = malloc(f1_inode.file_size);
-    if (!f1_data) {
-        printf("CANNOT CREATE FILE\n");
+    //bez zámků by vlákna sdílela struktury nechráněná
+    if (!fs->locks) {
+        printf("PARALLEL EXECUTION NOT SUPPORTED\n");
         return false;
     }
-    
-    int32_t bytes_read = 0;
-    int32_t clusters_needed = (f1_inode.file_size + fs->sb.cluster_size - 1) / fs->sb.cluster_size;
-    uint8_t buffer[CLUSTER_SIZE];
-    
-    for (int32_t i = 0; i < clusters_needed; i++) {
-        int32_t cluster = get_file_cluster(fs, &f1_inode, i);
-        if (cluster == 0) break;
-        
-        read_cluster(fs, cluster, buffer);
-        
-        int32_t bytes_to_copy = f1_inode.file_size - bytes_read;
-        if (bytes_to_copy > fs->sb.cluster_size) {
-            bytes_to_copy = fs->sb.cluster_size;
-        }
-        
-        memcpy(f1_data + bytes_read, buffer, bytes_to_copy);
-        bytes_read += bytes_to_copy;
-    }
 
-    uint8_t *f2_data = malloc(f2_inode.file_size);
-    if (!f2_data) {
-        free(f1_data);
-        printf("CANNOT CREATE FILE\n");
+    parallel_run_t run = { .session = *session };
+    run.line_count = read_script(filename, &run.lines);
+    if (run.line_count < 0) {
+        printf("OPENING FILE FAILED\n");
         return false;
     }
-    
-    bytes_read = 0;
-    clusters_needed = (f2_inode.file_size + fs->sb.cluster_size - 1) / fs->sb.cluster_size;
-    
-    for (int32_t i = 0; i < clusters_needed; i++) {
-        int32_t cluster = get_file_cluster(fs, &f2_inode, i);
-        if (cluster == 0) break;
-        
-        read_cluster(fs, cluster, buffer);
-        
-        int32_t bytes_to_copy = f2_inode.file_size - bytes_read;
-        if (bytes_to_copy > fs->sb.cluster_size) {
-            bytes_to_copy = fs->sb.cluster_size;
-        }
-        
-        memcpy(f2_data + bytes_read, buffer, bytes_to_copy);
-        bytes_read += bytes_to_copy;
+    atomic_init(&run.next, 0);
+    atomic_init(&run.failed, 0);
+
+    //změny se ukládají až na konci, stejně jako v dávce
+    bool outer_batch = fs->in_batch;
+    fs->in_batch = true;
+
+    pthread_t threads[MAX_WORKERS];
+    int32_t started = 0;
+    while (started < workers && pthread_create(&threads[started], NULL, parallel_worker, &run) == 0) {
+        started++;
     }
-    
-    //Spojení obou souborů do finálního
-    int32_t total_size = f1_inode.file_size + f2_inode.file_size;
-    uint8_t *final_data = malloc(total_size);
-    if (!final_data) {
-        free(f1_data);
-        free(f2_data);
-        printf("CANNOT CREATE FILE\n");
-        return false;
+    //nepovedlo se spustit žádné vlákno - příkazy vykoná volající
+    if (started == 0) parallel_worker(&run);
+    for (int32_t i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
     }
 
-    memcpy(final_data, f1_data, f1_inode.file_size);
-    memcpy(final_data + f1_inode.file_size, f2_data, f2_inode.file_size);
+    fs->in_batch = outer_batch;
+    bool ok = zosfs_sync(fs) == ZOSFS_OK;
+    if (!ok) printf("SYNC FAILED\n");
 
-    free(f1_data);
-    free(f2_data);
+    int32_t failed = atomic_load(&run.failed);
+    printf("PARALLEL: %d commands, %d failed, %d workers\n", run.line_count, failed, started ? started : 1);
 
-    //Nalezení cesty k souboru a kontrola, zda již neexistuje
-    int32_t dest_parent;
-    char dest_filename[NAME_SIZE];
-    
-    if (!split_path(fs, f3, &dest_parent, &dest_filename)) {
-        free(final_data);
-        printf("PATH NOT FOUND\n");
+    for (int32_t i = 0; i < run.line_count; i++) {
+        free(run.lines[i].text);
+    }
+    free(run.lines);
+    return ok && failed == 0;
+}
+
+
+
+// spojí zamčené soubory f1 a f2 do nového souboru v adresáři dest_parent, share = celé clustery se sdílí místo kopírování
+static bool concat_locked(filesystem_t *fs, int32_t f1_inode_id, int32_t f2_inode_id,
+                          int32_t dest_parent, const char *dest_filename, bool share) {
+    inode_t f1_inode;
+    if (!read_inode(fs, f1_inode_id, &f1_inode) || f1_inode.is_directory) {
+        printf("READING INODE FAILED\n");
         return false;
     }
     
+    inode_t f2_inode;
+    if (!read_inode(fs, f2_inode_id, &f2_inode) || f2_inode.is_directory) {
+        printf("READING INODE FAILED\n");
+        return false;
+    }
+
+    int64_t total_size = f1_inode.file_size + f2_inode.file_size;
+    if (total_size > max_file_size(fs)) {
+        printf("FILE TOO LARGE\n");
+        return false;
+    }
 
+    //kontrola, zda cílový soubor již neexistuje
     if (find_in_dir(fs, dest_parent, dest_filename) >= 0) {
-        free(final_data);
         printf("FILE ALREADY EXIST\n");
         return false;
     }
+
+    //obsah obou souborů se čte postupně přes buffery pevné velikosti
+    int32_t cluster_size = fs->sb.cluster_size;
+    file_reader_t reader1, reader2;
+    uint8_t *buffer = malloc(IO_RUN_CLUSTERS * cluster_size);
+    if (!buffer || !file_reader_open(&reader1, fs, &f1_inode)) {
+        free(buffer);
+        printf("CANNOT CREATE FILE\n");
+        return false;
+    }
+    if (!file_reader_open(&reader2, fs, &f2_inode)) {
+        file_reader_close(&reader1);
+        free(buffer);
+        printf("CANNOT CREATE FILE\n");
+        return false;
+    }
     
     //Vytvoření nového souboru a zápis dat
     int32_t f3_inode_id = alloc_inode(fs);
     if (f3_inode_id < 0) {
-        free(final_data);
+        file_reader_close(&reader1);
+        file_reader_close(&reader2);
+        free(buffer);
         printf("CANNOT CREATE FILE\n");
         return false;
     }
@@ -1125,57 +1091,141 @@ bool xcp(filesystem_t *fs, const char *f1, const char *f2, const char *f3) {
     new_inode.nodeid = f3_inode_id;
     new_inode.is_directory = false;
     new_inode.references = 1;
+    init_file_map(&new_inode);
     new_inode.file_size = total_size;
-    
-    // Zápis dat do clusterů
-    clusters_needed = (total_size + fs->sb.cluster_size - 1) / fs->sb.cluster_size;
-    
-    for (int32_t i = 0; i < clusters_needed; i++) {
-        int32_t cluster = alloc_cluster(fs);
-        if (cluster < 0) {
-            free(final_data);
-            printf("CANNOT CREATE FILE\n");
-            return false;
+
+    bool ok = true;
+    int32_t index = 0;
+    int32_t start, length;
+    //celé clustery f1 leží v cíli na stejných hranicích, f2 jen pokud f1 končí na hranici clusteru
+    int32_t f1_shared = share ? f1_inode.file_size / cluster_size : 0;
+    bool f2_shared = share && f1_inode.file_size % cluster_size == 0;
+
+    while (ok && index < f1_shared && file_reader_take_run(&reader1, f1_shared - index, &start, &length)) {
+        ok = share_file_run(fs, &new_inode, index, start, length);
+        index += length;
+    }
+
+    //zbytek f1 a f2 (pokud se nesdílí) se kopíruje do nových clusterů
+    int32_t total_clusters = (total_size + cluster_size - 1) / cluster_size;
+    int32_t copy_clusters = f2_shared ? 0 : total_clusters - index;
+    cluster_run_t *runs = NULL;
+    int32_t run_count = ok ? alloc_clusters(fs, copy_clusters, 0, &runs) : -1;
+    if (run_count < 0) ok = false;
+
+    for (int32_t r = 0; r < run_count; r++) {
+        for (int32_t done = 0; done < runs[r].length; ) {
+            int32_t count = runs[r].length - done;
+            if (count > IO_RUN_CLUSTERS) count = IO_RUN_CLUSTERS;
+
+            //konec f1 navazuje v bufferu na začátek f2, poslední cluster se doplní nulami
+            int64_t want = (int64_t)count * cluster_size;
+            int64_t bytes = ok ? file_reader_read(&reader1, buffer, want) : -1;
+            if (bytes >= 0 && bytes < want) {
+                int64_t more = file_reader_read(&reader2, buffer + bytes, want - bytes);
+                bytes = more < 0 ? -1 : bytes + more;
+            }
+            ok = bytes > (int64_t)(count - 1) * cluster_size &&
+                 write_clusters(fs, runs[r].start + done, count, buffer, bytes) &&
+                 set_file_run(fs, &new_inode, index, runs[r].start + done, count) == 0;
+            if (ok) {
+                index += count;
+            } else {
+                //nenamapované clustery se hned vrátí
+                for (int32_t i = 0; i < count; i++) free_cluster(fs, runs[r].start + done + i);
+            }
+            done += count;
         }
-        
-        int32_t offset = i * fs->sb.cluster_size;
-        int32_t to_write = (total_size - offset > fs->sb.cluster_size) ? //celý cluster
-                          fs->sb.cluster_size : total_size - offset;    //poslední cluster
-        
-        memset(buffer, 0, CLUSTER_SIZE);
-        memcpy(buffer, final_data + offset, to_write);
-        write_cluster(fs, cluster, buffer);
-        set_file_cluster(fs, &new_inode, i, cluster);
+    }
+    free(runs);
+
+    while (ok && f2_shared && file_reader_take_run(&reader2, IO_RUN_CLUSTERS, &start, &length)) {
+        ok = share_file_run(fs, &new_inode, index, start, length);
+        index += length;
+    }
+
+    file_reader_close(&reader1);
+    file_reader_close(&reader2);
+    free(buffer);
+
+    if (!ok) {
+        //již namapované clustery - sdílené jen sníží čítač
+        free_file_clusters(fs, &new_inode);
+        free_inode(fs, f3_inode_id);
+        printf("CANNOT CREATE FILE\n");
+        return false;
     }
 
     write_inode(fs, f3_inode_id, &new_inode);
     
     if (!add_to_dir(fs, dest_parent, dest_filename, f3_inode_id)) {
-        free(final_data);
+        free_file_clusters(fs, &new_inode);
+        free_inode(fs, f3_inode_id);
         printf("ADDING TO DIRECTORY FAILED\n");
         return false;
     }
 
-    free(final_data);
     printf("OK\n");
     return true;
 }
 
-
-
-bool add(filesystem_t *fs, const char *f1, const char *f2) {
-    if (!f1 || !f1[0] || !f2 || !f2[0]) {
+// spojí soubory f1 a f2 do nového souboru f3, share = celé clustery se sdílí místo kopírování
+static bool concat_files(session_t *session, const char *f1, const char *f2, const char *f3, bool share) {
+    filesystem_t *fs = session->fs;
+    if (!f1 || !f1[0] || !f2 || !f2[0] || 
+        !f3 || !f3[0]) {
         printf("FILE NOT FOUND\n");
         return false;
     }
+
+    if (share && !refcount_supported(fs)) {
+        printf("REFLINK NOT SUPPORTED BY THIS FILESYSTEM\n");
+        return false;
+    }
     
     //Nalezení obou souborů
-    int32_t f2_inode_id = resolve_path(fs, f1);
-    if (f2_inode_id < 0) {
+    int32_t f1_inode_id = resolve_path(fs, session->current_inode, f1);
+    int32_t f2_inode_id = resolve_path(fs, session->current_inode, f2);
+    if (f1_inode_id < 0 || f2_inode_id < 0) {
         printf("FILE NOT FOUND\n");
         return false;
     }
-    
+
+    //Nalezení cesty k cílovému souboru
+    int32_t dest_parent;
+    char dest_filename[NAME_SIZE];
+    if (!split_path(fs, session->current_inode, f3, &dest_parent, dest_filename)) {
+        printf("PATH NOT FOUND\n");
+        return false;
+    }
+
+    inode_lock_set_t locks;
+    lock_set_init(&locks);
+    lock_set_add(&locks, f1_inode_id, false);
+    lock_set_add(&locks, f2_inode_id, false);
+    lock_set_add(&locks, dest_parent, true);
+    if (!lock_set_acquire_checked(fs, &locks)) {
+        printf("FILE NOT FOUND\n");
+        return false;
+    }
+
+    bool ok = concat_locked(fs, f1_inode_id, f2_inode_id, dest_parent, dest_filename, share);
+    lock_set_release(fs, &locks);
+    return ok;
+}
+
+bool xcp(session_t *session, const char *f1, const char *f2, const char *f3) {
+    return concat_files(session, f1, f2, f3, false);
+}
+
+bool xcp_reflink(session_t *session, const char *f1, const char *f2, const char *f3) {
+    return concat_files(session, f1, f2, f3, true);
+}
+
+
+
+// připojí obsah zamčeného souboru f1_inode_id na konec zamčeného souboru f2_inode_id
+static bool append_file(filesystem_t *fs, int32_t f2_inode_id, int32_t f1_inode_id) {
     inode_t f2_inode;
     if (!read_inode(fs, f2_inode_id, &f2_inode)) {
         printf("READING INODE FAILED\n");
@@ -1187,12 +1237,6 @@ bool add(filesystem_t *fs, const char *f1, const char *f2) {
         return false;
     }
 
-    int32_t f1_inode_id = resolve_path(fs, f2);
-    if (f1_inode_id < 0) {
-        printf("FILE NOT FOUND\n");
-        return false;
-    }
-    
     inode_t f1_inode;
     if (!read_inode(fs, f1_inode_id, &f1_inode)) {
         printf("READING INODE FAILED\n");
@@ -1204,141 +1248,190 @@ bool add(filesystem_t *fs, const char *f1, const char *f2) {
         return false;
     }
     
-    //Načtení obsahu obou souborů
-    uint8_t *f2_data = malloc(f2_inode.file_size);
-    if (!f2_data) {
-        printf("CANNOT CREATE FILE\n");
+    int64_t old_size = f2_inode.file_size;
+    int64_t new_size = old_size + f1_inode.file_size;
+    if (new_size > max_file_size(fs)) {
+        printf("FILE TOO LARGE\n");
         return false;
     }
-    
-    int32_t bytes_read = 0;
-    int32_t clusters_needed = (f2_inode.file_size + fs->sb.cluster_size - 1) / fs->sb.cluster_size;
-    uint8_t buffer[CLUSTER_SIZE];
-    
-    for (int32_t i = 0; i < clusters_needed; i++) {
-        int32_t cluster = get_file_cluster(fs, &f2_inode, i);
-        if (cluster == 0) break;
-        
-        read_cluster(fs, cluster, buffer);
-        
-        int32_t bytes_to_copy = f2_inode.file_size - bytes_read;
-        if (bytes_to_copy > fs->sb.cluster_size) {
-            bytes_to_copy = fs->sb.cluster_size;//poslední cluster
-        }
-        //kopírování do bufferu
-        memcpy(f2_data + bytes_read, buffer, bytes_to_copy);
-        bytes_read += bytes_to_copy;
-    }
-    
-    uint8_t *f1_data = malloc(f1_inode.file_size);
-    if (!f1_data) {
-        free(f2_data);
+
+    int32_t cluster_size = fs->sb.cluster_size;
+    int32_t old_clusters = (old_size + cluster_size - 1) / cluster_size;
+    int32_t new_clusters = (new_size + cluster_size - 1) / cluster_size;
+    //volné místo v posledním clusteru cíle
+    int64_t slack = (int64_t)old_clusters * cluster_size - old_size;
+    if (slack > f1_inode.file_size) slack = f1_inode.file_size;
+
+    //připojená data se čtou po částech, cíl se nepřepisuje
+    file_reader_t reader;
+    if (!file_reader_open(&reader, fs, &f1_inode)) {
         printf("CANNOT CREATE FILE\n");
         return false;
     }
-    
-    bytes_read = 0;
-    clusters_needed = (f1_inode.file_size + fs->sb.cluster_size - 1) / fs->sb.cluster_size;
-    
-    for (int32_t i = 0; i < clusters_needed; i++) {
-        int32_t cluster = get_file_cluster(fs, &f1_inode, i);
-        if (cluster == 0) break;
-        
-        read_cluster(fs, cluster, buffer);
-        
-        int32_t bytes_to_copy = f1_inode.file_size - bytes_read;
-        if (bytes_to_copy > fs->sb.cluster_size) {
-            bytes_to_copy = fs->sb.cluster_size;
-        }
-
-        memcpy(f1_data + bytes_read, buffer, bytes_to_copy);
-        bytes_read += bytes_to_copy;
-    }
-    
-    //Spojení souborů
-    int32_t new_size = f2_inode.file_size + f1_inode.file_size;
-    uint8_t *combined_data = malloc(new_size);
-    if (!combined_data) {
-        free(f2_data);
-        free(f1_data);
+    uint8_t *buffer = malloc(IO_RUN_CLUSTERS * cluster_size);
+    if (!buffer) {
+        file_reader_close(&reader);
         printf("CANNOT CREATE FILE\n");
         return false;
     }
 
-    memcpy(combined_data, f2_data, f2_inode.file_size);
-    memcpy(combined_data + f2_inode.file_size, f1_data, f1_inode.file_size);
+    //sdílený poslední cluster (reflink) dostane před zápisem vlastní kopii
+    int32_t last = old_clusters > 0 ? get_file_cluster(fs, &f2_inode, old_clusters - 1) : 0;
+    if (slack > 0) last = own_file_cluster(fs, &f2_inode, old_clusters - 1);
 
-    free(f2_data);
-    free(f1_data);
-    
-    //Uvolnění veškeré původní paměti - vše se zapíše znovu
-    if (f2_inode.direct1 > 0) free_cluster(fs, f2_inode.direct1);
-    if (f2_inode.direct2 > 0) free_cluster(fs, f2_inode.direct2);
-    if (f2_inode.direct3 > 0) free_cluster(fs, f2_inode.direct3);
-    if (f2_inode.direct4 > 0) free_cluster(fs, f2_inode.direct4);
-    if (f2_inode.direct5 > 0) free_cluster(fs, f2_inode.direct5);
-    
-    if (f2_inode.indirect1 > 0) {
-        int32_t pointers[PTRS_PER_CLUSTER];
-        read_cluster(fs, f2_inode.indirect1, pointers);
-        for (int i = 0; i < (int32_t)PTRS_PER_CLUSTER && pointers[i] > 0; i++) {
-            free_cluster(fs, pointers[i]);
-        }
-        free_cluster(fs, f2_inode.indirect1);
+    //nové clustery pokud možno hned za posledním clusterem cíle
+    cluster_run_t *runs = NULL;
+    int32_t run_count = last < 0 ? -1 : alloc_clusters(fs, new_clusters - old_clusters, last > 0 ? last + 1 : 0, &runs);
+    if (run_count < 0) {
+        free(buffer);
+        file_reader_close(&reader);
+        write_inode(fs, f2_inode_id, &f2_inode);
+        printf("CANNOT CREATE FILE\n");
+        return false;
     }
-    
-    if (f2_inode.indirect2 > 0) {
-        int32_t l1_pointers[PTRS_PER_CLUSTER];
-        read_cluster(fs, f2_inode.indirect2, l1_pointers);
-        
-        for (int i = 0; i < (int32_t)PTRS_PER_CLUSTER && l1_pointers[i] > 0; i++) {
-            int32_t l2_pointers[PTRS_PER_CLUSTER];
-            read_cluster(fs, l1_pointers[i], l2_pointers);
-            
-            for (int j = 0; j < (int32_t)PTRS_PER_CLUSTER && l2_pointers[j] > 0; j++) {
-                free_cluster(fs, l2_pointers[j]);
+
+    bool ok = true;
+    int64_t appended = 0;
+    if (slack > 0) {
+        //doplnění posledního clusteru
+        ok = read_cluster(fs, last, buffer) &&
+             file_reader_read(&reader, buffer + (old_size - (int64_t)(old_clusters - 1) * cluster_size), slack) == slack &&
+             write_cluster(fs, last, buffer);
+        if (ok) appended = slack;
+    }
+
+    int32_t index = old_clusters;
+    for (int32_t r = 0; r < run_count; r++) {
+        for (int32_t done = 0; done < runs[r].length; ) {
+            int32_t count = runs[r].length - done;
+            if (count > IO_RUN_CLUSTERS) count = IO_RUN_CLUSTERS;
+
+            //poslední cluster se doplní nulami
+            int64_t bytes = ok ? file_reader_read(&reader, buffer, (size_t)count * cluster_size) : -1;
+            ok = bytes > (int64_t)(count - 1) * cluster_size &&
+                 write_clusters(fs, runs[r].start + done, count, buffer, bytes) &&
+                 set_file_run(fs, &f2_inode, index, runs[r].start + done, count) == 0;
+            if (ok) {
+                appended += bytes;
+                index += count;
+            } else {
+                //po chybě se zbylé clustery vrátí, soubor se prodlouží jen o zapsaná data
+                for (int32_t i = 0; i < count; i++) free_cluster(fs, runs[r].start + done + i);
             }
-            
-            free_cluster(fs, l1_pointers[i]);
+            done += count;
         }
+    }
 
-        free_cluster(fs, f2_inode.indirect2);
+    free(runs);
+    free(buffer);
+    file_reader_close(&reader);
+
+    f2_inode.file_size = old_size + appended;
+    write_inode(fs, f2_inode_id, &f2_inode);
+    if (!ok) {
+        printf("WRITING FILE FAILED\n");
+        return false;
+    }
+
+    printf("OK\n");
+    return true;
+}
+
+bool add(session_t *session, const char *f1, const char *f2) {
+    filesystem_t *fs = session->fs;
+    if (!f1 || !f1[0] || !f2 || !f2[0]) {
+        printf("FILE NOT FOUND\n");
+        return false;
     }
     
-    f2_inode.direct1 = 0;
-    f2_inode.direct2 = 0;
-    f2_inode.direct3 = 0;
-    f2_inode.direct4 = 0;
-    f2_inode.direct5 = 0;
-    f2_inode.indirect1 = 0;
-    f2_inode.indirect2 = 0;
-    f2_inode.file_size = new_size;
-    
-    //Zápis nových dat - spojených souborů
-    clusters_needed = (new_size + fs->sb.cluster_size - 1) / fs->sb.cluster_size;
-    
-    //postupný zápis do všech clusterů
-    for (int32_t i = 0; i < clusters_needed; i++) {
-        int32_t cluster = alloc_cluster(fs);
-        if (cluster < 0) {
-            free(combined_data);
-            printf("CANNOT CREATE FILE\n");
-            return false;
-        }
-        
-        int32_t offset = i * fs->sb.cluster_size;
-        int32_t to_write = (new_size - offset > fs->sb.cluster_size) ?  //využije se celý cluster
-                          fs->sb.cluster_size : new_size - offset;  //poslední cluster
-        
-        memset(buffer, 0, CLUSTER_SIZE);
-        memcpy(buffer, combined_data + offset, to_write);
-        write_cluster(fs, cluster, buffer);
-        set_file_cluster(fs, &f2_inode, i, cluster);
+    //Nalezení obou souborů
+    int32_t f2_inode_id = resolve_path(fs, session->current_inode, f1);
+    int32_t f1_inode_id = resolve_path(fs, session->current_inode, f2);
+    if (f2_inode_id < 0 || f1_inode_id < 0) {
+        printf("FILE NOT FOUND\n");
+        return false;
     }
 
-    write_inode(fs, f2_inode_id, &f2_inode);
+    //cíl se mění, připojovaný soubor se jen čte
+    inode_lock_set_t locks;
+    lock_set_init(&locks);
+    lock_set_add(&locks, f2_inode_id, true);
+    lock_set_add(&locks, f1_inode_id, false);
+    if (!lock_set_acquire_checked(fs, &locks)) {
+        printf("FILE NOT FOUND\n");
+        return false;
+    }
+
+    bool ok = append_file(fs, f2_inode_id, f1_inode_id);
+    lock_set_release(fs, &locks);
+    return ok;
+}
+
+
+
+bool trace(session_t *session, const char *what, const char *level) {
+    (void)session;
+    if (strcmp(what, "dump") == 0) {
+        trace_dump();
+        return true;
+    }
 
-    free(combined_data);
+    int value = trace_parse_level(level);
+    if (value < 0 || !trace_set_level(what, value)) {
+        printf("USAGE: trace dump | trace <alloc|dir|path|io|all> <off|error|info|debug>\n");
+        return false;
+    }
     printf("OK\n");
     return true;
+}
+
+
+
+// výpis statistik cache clusterů
+static void print_cluster_cache(cluster_cache_t *cache) {
+    int32_t used = 0, dirty = 0;
+    for (int32_t i = 0; i < cache->capacity; i++) {
+        if (cache->entries[i].cluster >= 0) used++;
+        if (cache->entries[i].dirty) dirty++;
+    }
+
+    uint64_t lookups = cache->hits + cache->misses;
+    printf("Cache clusterů:\n");
+    printf("----------------------\n");
+    printf("Velikost:          %d clusterů (%.2f MB)\n", cache->capacity, cache->capacity * (double)CLUSTER_SIZE / (1024.0 * 1024.0));
+    printf("Obsazeno:          %d\n", used);
+    printf("Změněno:           %d\n", dirty);
+    printf("Zásahy:            %llu\n", (unsigned long long)cache->hits);
+    printf("Výpadky:           %llu\n", (unsigned long long)cache->misses);
+    printf("Úspěšnost:         %.1f%%\n", lookups ? cache->hits * 100.0 / lookups : 0.0);
+    printf("Vyřazeno:          %llu\n", (unsigned long long)cache->evictions);
+    printf("Zapsáno zpět:      %llu\n", (unsigned long long)cache->writebacks);
+}
+
+void cachestat(session_t *session) {
+    filesystem_t *fs = session->fs;
+    cluster_cache_t *cache = fs->cache;
+    if (cache) {
+        print_cluster_cache(cache);
+    } else {
+        printf("CACHE DISABLED\n");
+    }
+
+    printf("Cache cest:        %llu zásahů, %llu výpadků\n",
+           (unsigned long long)fs->dcache_hits, (unsigned long long)fs->dcache_misses);
+    fs_lock(fs, LOCK_DIRS);
+    printf("Indexy adresářů:   %d, %zu/%zu KB\n", fs->dir_index_count, fs->dir_index_bytes / 1024, fs->dir_index_budget / 1024);
+    fs_unlock(fs, LOCK_DIRS);
+
+    inode_cache_t *icache = fs->inode_cache;
+    if (icache) {
+        printf("Úseky tabulky inodů: %d/%d načteno, %llu čtení, %llu vyřazeno\n", icache->loaded, icache->chunk_count,
+               (unsigned long long)icache->loads, (unsigned long long)icache->evictions);
+    }
+
+    journal_t *journal = fs->journal;
+    if (journal) {
+        printf("Žurnál:            %llu transakcí, %llu fdatasync%s\n", (unsigned long long)journal->commits,
+               (unsigned long long)journal->syncs, journal_active(fs) ? "" : " (nepoužívá se)");
+    }
 }
\ No newline at end of file
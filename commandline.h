@@ -2,58 +2,84 @@
 #include "structs.h"
 #include <stdbool.h>
 
+// Nejvíce vláken pro load --parallel
+#define MAX_WORKERS 64
+
 
 //Vypíše aktuální cestu
-void pwd(filesystem_t *fs);
+void pwd(session_t *session);
 
 //Vypíše obsah adresáře
-bool ls(filesystem_t *fs, const char *path);
+bool ls(session_t *session, const char *path);
 
 //Vytvoří adresář
-bool mkdir(filesystem_t *fs, const char *name);
+bool mkdir(session_t *session, const char *name);
 
 //Nahraje soubor src z pevného disku do umístění dest ve vašem FS
-bool incp(filesystem_t *fs, const char *src, const char *dest);
+bool incp(session_t *session, const char *src, const char *dest);
 
 /*Příkaz provede formát souboru, který byl zadán jako parametr při spuštení programu
 na souborový systém dané velikosti. Pokud už soubor nějaká data obsahoval, budou
 přemazána. Pokud soubor neexistoval, bude vytvořen.*/
-bool format(filesystem_t *fs, const char *size_str);
+bool format(session_t *session, const char *size_str);
 
 //Změní aktuální cestu do adresáře
-bool cd(filesystem_t *fs, const char *path);
+bool cd(session_t *session, const char *path);
 
 //Vypíše obsah textového souboru na obrazovku
-bool cat(filesystem_t *fs, const char *filename);
+bool cat(session_t *session, const char *filename);
 
 /*vypíše statistiky souborového systému, jako je velikost, počet
 obsazených a volných bloků, počet obsazených a volných i-uzlů, počet adresářů.*/
-void statfs(filesystem_t *fs);
+void statfs(session_t *session);
 
 //Vypíše informace o souboru/adresáři
-bool info(filesystem_t *fs, const char *path);
+bool info(session_t *session, const char *path);
 
 //Zkopíruje soubor src_path do umístění dest_path
-bool cp(filesystem_t *fs, const char *src_path, const char *dest_path);
+bool cp(session_t *session, const char *src_path, const char *dest_path);
+
+//Zkopíruje soubor bez kopírování dat - cíl sdílí clustery se zdrojem, dokud se do nich nezapíše
+bool cp_reflink(session_t *session, const char *src_path, const char *dest_path);
 
 //Smaže soubor
-bool rm(filesystem_t *fs, const char *path);
+bool rm(session_t *session, const char *path);
 
 //Smaže prázdný adresář
-bool rmdir(filesystem_t *fs, const char *path);
+bool rmdir(session_t *session, const char *path);
 
 //Přesune soubor src_path do umístění dest_path, nebo ho přejmenuje
-bool mv(filesystem_t *fs, const char *src_path, const char *dest_path);
+bool mv(session_t *session, const char *src_path, const char *dest_path);
 
 //Nahraje soubor z FS do umístění na pevném disku
-bool outcp(filesystem_t *fs, const char *src, const char *dest);
+bool outcp(session_t *session, const char *src, const char *dest);
 
 /*Načte soubor z pevného disku, ve kterém budou jednotlivé příkazy, a začne je
 sekvenčně vykonávat. Formát je 1 příkaz/1 řádek*/
-bool load(filesystem_t *fs, const char *filename);
+bool load(session_t *session, const char *filename);
+
+//Vykoná příkazy ze souboru jako dávku - změny se ukládají jednou za batch příkazů (0 = na konci),
+//a dřív, než by se neuložené změny nevešly do žurnálu; chyba příkazu se ohlásí s číslem řádku a dávku nepřeruší
+bool load_batch(session_t *session, const char *filename, int32_t batch);
+
+//Vykoná příkazy ze souboru v workers vláknech, každé vlákno má vlastní kopii sezení (cd se projeví jen v něm),
+//změny se ukládají na konci jako u dávky, výstupy příkazů se mohou prolínat
+bool load_parallel(session_t *session, const char *filename, int32_t workers);
+
+//Vykoná jeden řádek skriptu, prázdný řádek je úspěch
+bool execute_line(session_t *session, const char *line);
 
 //Vytvoří soubor, který bude spojením dvou souborů
-bool xcp(filesystem_t *fs, const char *f1, const char *f2, const char *f3);
+bool xcp(session_t *session, const char *f1, const char *f2, const char *f3);
+
+//Vytvoří soubor spojením dvou souborů, celé clustery na stejných hranicích sdílí se zdroji
+bool xcp_reflink(session_t *session, const char *f1, const char *f2, const char *f3);
 
 //Přidá na konec souboru target obsah souboru source
-bool add(filesystem_t *fs, const char *f1, const char *f2);
\ No newline at end of file
+bool add(session_t *session, const char *f1, const char *f2);
+
+//Nastaví úroveň trasování subsystému nebo vypíše uložené záznamy (trace dump)
+bool trace(session_t *session, const char *what, const char *level);
+
+//Vypíše statistiky cache clusterů
+void cachestat(session_t *session);
\ No newline at end of file
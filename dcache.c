@@ -0,0 +1,64 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "structs.h"
+#include "dcache.h"
+
+
+// hash dvojice (rodič, jméno), přímo mapovaná tabulka
+static uint32_t dcache_slot(int32_t parent, const char *name) {
+    uint32_t hash = 2166136261u ^ ((uint32_t)parent * 2654435761u);
+    for (int i = 0; i < NAME_SIZE && name[i]; i++) {
+        hash ^= (uint8_t)name[i];
+        hash *= 16777619u;
+    }
+    return hash & (DCACHE_SIZE - 1);
+}
+
+bool dcache_lookup(filesystem_t *fs, int32_t parent, const char *name, int32_t *child) {
+    if (!fs->dcache || strlen(name) >= NAME_SIZE) return false;
+
+    dentry_t *entry = &fs->dcache[dcache_slot(parent, name)];
+    if (!entry->valid || entry->parent != parent || strcmp(entry->name, name) != 0) {
+        fs->dcache_misses++;
+        return false;
+    }
+
+    fs->dcache_hits++;
+    *child = entry->child;
+    return true;
+}
+
+void dcache_insert(filesystem_t *fs, int32_t parent, const char *name, int32_t child) {
+    //delší jména se do adresáře ukládají zkrácená, necachují se
+    if (strlen(name) >= NAME_SIZE) return;
+
+    if (!fs->dcache) {
+        fs->dcache = calloc(DCACHE_SIZE, sizeof(dentry_t));
+        if (!fs->dcache) return;
+    }
+
+    //kolize přepíše starší záznam
+    dentry_t *entry = &fs->dcache[dcache_slot(parent, name)];
+    entry->valid = true;
+    entry->parent = parent;
+    entry->child = child;
+    strcpy(entry->name, name);
+}
+
+void dcache_drop_dir(filesystem_t *fs, int32_t parent) {
+    if (!fs->dcache) return;
+
+    for (int32_t i = 0; i < DCACHE_SIZE; i++) {
+        if (fs->dcache[i].parent == parent) {
+            fs->dcache[i].valid = false;
+        }
+    }
+}
+
+void dcache_clear(filesystem_t *fs) {
+    free(fs->dcache);
+    fs->dcache = NULL;
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include "structs.h"
+#include <stdbool.h>
+
+// Počet položek cache (mocnina dvou)
+#define DCACHE_SIZE 4096
+
+// Najde (rodič, jméno) v cache; vrací true při zásahu, *child je -1 pro negativní záznam
+bool dcache_lookup(filesystem_t *fs, int32_t parent, const char *name, int32_t *child);
+
+// Uloží výsledek hledání, child -1 = jméno v adresáři neexistuje
+void dcache_insert(filesystem_t *fs, int32_t parent, const char *name, int32_t child);
+
+// Zneplatní všechny záznamy v adresáři parent (po jeho smazání)
+void dcache_drop_dir(filesystem_t *fs, int32_t parent);
+
+// Zneplatní celou cache (po formátování)
+void dcache_clear(filesystem_t *fs);
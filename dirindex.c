@@ -0,0 +1,300 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "structs.h"
+#include "dirindex.h"
+#include "inodes.h"
+#include "clusters.h"
+#include "trace.h"
+
+
+// FNV-1a hash jména
+static uint32_t hash_name(const char *name) {
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < NAME_SIZE && name[i]; i++) {
+        hash ^= (uint8_t)name[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static int32_t table_bucket(int32_t dir_inode_id) {
+    return ((uint32_t)dir_inode_id * 2654435761u) % DIR_INDEX_TABLE_SIZE;
+}
+
+// paměť indexu včetně nevyužitých míst v polích
+static size_t index_bytes(const dir_index_t *index) {
+    return sizeof(dir_index_t) + (size_t)index->entry_capacity * sizeof(dir_index_entry_t) +
+           (size_t)(index->bucket_mask + 1) * sizeof(int32_t) + (size_t)index->free_capacity * sizeof(dir_slot_t);
+}
+
+static void free_index(dir_index_t *index) {
+    free(index->entries);
+    free(index->buckets);
+    free(index->free_slots);
+    free(index);
+}
+
+// zvětší hashovací tabulku, aby průměrná délka řetězce nepřesáhla 1
+static bool grow_buckets(dir_index_t *index) {
+    int32_t size = (index->bucket_mask + 1) * 2;
+    int32_t *buckets = malloc(size * sizeof(int32_t));
+    if (!buckets) return false;
+
+    memset(buckets, 0xff, size * sizeof(int32_t));
+    free(index->buckets);
+    index->buckets = buckets;
+    index->bucket_mask = size - 1;
+
+    //přehashování platných položek
+    for (int32_t i = 0; i < index->entry_used; i++) {
+        dir_index_entry_t *entry = &index->entries[i];
+        if (entry->inode == 0) continue;
+        int32_t bucket = hash_name(entry->name) & index->bucket_mask;
+        entry->next = buckets[bucket];
+        buckets[bucket] = i;
+    }
+    return true;
+}
+
+static dir_index_t *build_index(filesystem_t *fs, int32_t dir_inode_id) {
+    inode_t dir_inode;
+    if (!read_inode(fs, dir_inode_id, &dir_inode) || !dir_inode.is_directory) return NULL;
+
+    dir_index_t *index = calloc(1, sizeof(dir_index_t));
+    if (!index) return NULL;
+    index->dir_inode = dir_inode_id;
+    index->free_entry = -1;
+    index->bucket_mask = 15;
+    index->buckets = malloc((index->bucket_mask + 1) * sizeof(int32_t));
+    if (!index->buckets) {
+        free_index(index);
+        return NULL;
+    }
+    memset(index->buckets, 0xff, (index->bucket_mask + 1) * sizeof(int32_t));
+
+    int32_t cluster_count = (dir_inode.file_size + fs->sb.cluster_size - 1) / fs->sb.cluster_size;
+    dir_item_t entries[ENTRIES_PER_CLUSTER];
+
+    //mapa clusterů se projde jednou iterátorem, zpětný průchod pak jde jen přes pole
+    int32_t *clusters = malloc((cluster_count > 0 ? cluster_count : 1) * sizeof(int32_t));
+    if (!clusters) {
+        free_index(index);
+        return NULL;
+    }
+    bmap_iter_t it;
+    bmap_iter_init(&it, fs, &dir_inode);
+    int32_t n = 0;
+    while (n < cluster_count && bmap_next(&it, &clusters[n])) n++;
+
+    //volné pozice se ukládají v pořadí od konce, aby se vyzvedávaly od začátku adresáře
+    for (int32_t i = n - 1; i >= 0; i--) {
+        int32_t cluster = clusters[i];
+        if (cluster == 0) continue;
+
+        if (!read_cluster(fs, cluster, entries)) {
+            free(clusters);
+            free_index(index);
+            return NULL;
+        }
+        for (int32_t j = ENTRIES_PER_CLUSTER - 1; j >= 0; j--) {
+            bool ok = entries[j].inode != 0
+                ? dir_index_insert(index, entries[j].name, entries[j].inode, cluster, j)
+                : dir_index_add_slot(index, cluster, j);
+            if (!ok) {
+                free(clusters);
+                free_index(index);
+                return NULL;
+            }
+        }
+    }
+    free(clusters);
+    return index;
+}
+
+
+// přesune index na začátek seznamu posledního použití
+static void lru_push_front(filesystem_t *fs, dir_index_t *index) {
+    index->lru_prev = NULL;
+    index->lru_next = fs->dir_lru;
+    if (fs->dir_lru) fs->dir_lru->lru_prev = index;
+    fs->dir_lru = index;
+    if (!fs->dir_lru_tail) fs->dir_lru_tail = index;
+}
+
+static void lru_unlink(filesystem_t *fs, dir_index_t *index) {
+    if (index->lru_prev) index->lru_prev->lru_next = index->lru_next;
+    else fs->dir_lru = index->lru_next;
+    if (index->lru_next) index->lru_next->lru_prev = index->lru_prev;
+    else fs->dir_lru_tail = index->lru_prev;
+}
+
+// odpojí index z tabulky i seznamu a uvolní ho
+static void remove_index(filesystem_t *fs, dir_index_t *index) {
+    dir_index_t **link = &fs->dir_indexes[table_bucket(index->dir_inode)];
+    while (*link != index) link = &(*link)->next;
+    *link = index->next;
+
+    lru_unlink(fs, index);
+    fs->dir_index_bytes -= index->bytes;
+    fs->dir_index_count--;
+    free_index(index);
+}
+
+// index se po změnách mohl zvětšit - započte se znovu, přes rozpočet se vyřadí nejdéle nepoužité
+static void account_index(filesystem_t *fs, dir_index_t *index) {
+    size_t bytes = index_bytes(index);
+    fs->dir_index_bytes += bytes - index->bytes;
+    index->bytes = bytes;
+
+    //indexy jen zrcadlí clustery adresářů, vyřazený se při dalším použití sestaví znovu
+    while (fs->dir_index_bytes > fs->dir_index_budget && fs->dir_lru_tail != index) {
+        TRACE(TRACE_DIR, TRACE_DEBUG, "dir_index: evicting index of %d", fs->dir_lru_tail->dir_inode);
+        remove_index(fs, fs->dir_lru_tail);
+    }
+}
+
+dir_index_t *dir_index_get(filesystem_t *fs, int32_t dir_inode_id) {
+    if (!fs->dir_indexes) {
+        fs->dir_indexes = calloc(DIR_INDEX_TABLE_SIZE, sizeof(dir_index_t *));
+        if (!fs->dir_indexes) return NULL;
+    }
+
+    int32_t bucket = table_bucket(dir_inode_id);
+    for (dir_index_t *index = fs->dir_indexes[bucket]; index; index = index->next) {
+        if (index->dir_inode == dir_inode_id) {
+            lru_unlink(fs, index);
+            lru_push_front(fs, index);
+            account_index(fs, index);
+            return index;
+        }
+    }
+
+    dir_index_t *index = build_index(fs, dir_inode_id);
+    if (!index) return NULL;
+
+    index->next = fs->dir_indexes[bucket];
+    fs->dir_indexes[bucket] = index;
+    lru_push_front(fs, index);
+    fs->dir_index_count++;
+    account_index(fs, index);
+    return index;
+}
+
+int32_t dir_index_lookup(dir_index_t *index, const char *name, int32_t *cluster, int32_t *slot) {
+    int32_t i = index->buckets[hash_name(name) & index->bucket_mask];
+    while (i >= 0) {
+        dir_index_entry_t *entry = &index->entries[i];
+        if (strcmp(entry->name, name) == 0) {
+            if (cluster) *cluster = entry->cluster;
+            if (slot) *slot = entry->slot;
+            return entry->inode;
+        }
+        i = entry->next;
+    }
+    return -1;
+}
+
+bool dir_index_insert(dir_index_t *index, const char *name, int32_t inode_id, int32_t cluster, int32_t slot) {
+    if (index->count >= index->bucket_mask + 1 && !grow_buckets(index)) return false;
+
+    int32_t i = index->free_entry;
+    if (i >= 0) {
+        index->free_entry = index->entries[i].next;
+    } else {
+        if (index->entry_used == index->entry_capacity) {
+            int32_t capacity = index->entry_capacity ? index->entry_capacity * 2 : 16;
+            dir_index_entry_t *entries = realloc(index->entries, capacity * sizeof(dir_index_entry_t));
+            if (!entries) return false;
+            index->entries = entries;
+            index->entry_capacity = capacity;
+        }
+        i = index->entry_used++;
+    }
+
+    dir_index_entry_t *entry = &index->entries[i];
+    strncpy(entry->name, name, NAME_SIZE - 1);
+    entry->name[NAME_SIZE - 1] = '\0';
+    entry->inode = inode_id;
+    entry->cluster = cluster;
+    entry->slot = slot;
+
+    int32_t bucket = hash_name(entry->name) & index->bucket_mask;
+    entry->next = index->buckets[bucket];
+    index->buckets[bucket] = i;
+    index->count++;
+    return true;
+}
+
+void dir_index_remove(dir_index_t *index, const char *name) {
+    int32_t *link = &index->buckets[hash_name(name) & index->bucket_mask];
+    while (*link >= 0) {
+        int32_t i = *link;
+        dir_index_entry_t *entry = &index->entries[i];
+        if (strcmp(entry->name, name) == 0) {
+            *link = entry->next;
+            entry->inode = 0;
+            entry->next = index->free_entry;
+            index->free_entry = i;
+            index->count--;
+            return;
+        }
+        link = &entry->next;
+    }
+}
+
+bool dir_index_take_slot(dir_index_t *index, int32_t *cluster, int32_t *slot) {
+    if (index->free_count == 0) return false;
+
+    index->free_count--;
+    *cluster = index->free_slots[index->free_count].cluster;
+    *slot = index->free_slots[index->free_count].slot;
+    return true;
+}
+
+bool dir_index_add_slot(dir_index_t *index, int32_t cluster, int32_t slot) {
+    if (index->free_count == index->free_capacity) {
+        int32_t capacity = index->free_capacity ? index->free_capacity * 2 : 64;
+        dir_slot_t *slots = realloc(index->free_slots, capacity * sizeof(dir_slot_t));
+        if (!slots) return false;
+        index->free_slots = slots;
+        index->free_capacity = capacity;
+    }
+
+    index->free_slots[index->free_count].cluster = cluster;
+    index->free_slots[index->free_count].slot = slot;
+    index->free_count++;
+    return true;
+}
+
+void dir_index_drop(filesystem_t *fs, int32_t dir_inode_id) {
+    if (!fs->dir_indexes) return;
+
+    for (dir_index_t *index = fs->dir_indexes[table_bucket(dir_inode_id)]; index; index = index->next) {
+        if (index->dir_inode == dir_inode_id) {
+            remove_index(fs, index);
+            return;
+        }
+    }
+}
+
+void dir_index_clear(filesystem_t *fs) {
+    if (!fs->dir_indexes) return;
+
+    for (int32_t i = 0; i < DIR_INDEX_TABLE_SIZE; i++) {
+        dir_index_t *index = fs->dir_indexes[i];
+        while (index) {
+            dir_index_t *next = index->next;
+            free_index(index);
+            index = next;
+        }
+    }
+    free(fs->dir_indexes);
+    fs->dir_indexes = NULL;
+    fs->dir_lru = NULL;
+    fs->dir_lru_tail = NULL;
+    fs->dir_index_count = 0;
+    fs->dir_index_bytes = 0;
+}
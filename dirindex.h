@@ -0,0 +1,34 @@
+#pragma once
+#include "structs.h"
+#include <stdbool.h>
+
+// Počet kyblíků tabulky indexů adresářů
+#define DIR_INDEX_TABLE_SIZE 256
+
+// Indexy adresářů dostanou tuto část rozpočtu cache (-c), clustery zbytek
+#define DIR_INDEX_BUDGET_SHARE 4
+
+// Vrátí index adresáře, při prvním použití ho sestaví průchodem clusterů, NULL pokud nejde o adresář.
+// Přes rozpočet se vyřadí nejdéle nepoužité indexy - platný je jen naposledy vrácený (pod LOCK_DIRS)
+dir_index_t *dir_index_get(filesystem_t *fs, int32_t dir_inode_id);
+
+// Najde položku podle jména, vrací inode nebo -1; cluster a slot mohou být NULL
+int32_t dir_index_lookup(dir_index_t *index, const char *name, int32_t *cluster, int32_t *slot);
+
+// Přidá položku do indexu
+bool dir_index_insert(dir_index_t *index, const char *name, int32_t inode_id, int32_t cluster, int32_t slot);
+
+// Odebere položku z indexu
+void dir_index_remove(dir_index_t *index, const char *name);
+
+// Vyzvedne volnou pozici v clusterech adresáře, false pokud žádná není
+bool dir_index_take_slot(dir_index_t *index, int32_t *cluster, int32_t *slot);
+
+// Vrátí pozici mezi volné
+bool dir_index_add_slot(dir_index_t *index, int32_t cluster, int32_t slot);
+
+// Zahodí index adresáře (po jeho smazání)
+void dir_index_drop(filesystem_t *fs, int32_t dir_inode_id);
+
+// Zahodí všechny indexy (po formátování)
+void dir_index_clear(filesystem_t *fs);
@@ -1,235 +1,590 @@
+#define _GNU_SOURCE             //copy_file_range
 #include <stdio.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/sendfile.h>
 #include "structs.h"
 #include "filesystem.h"
 #include "inodes.h"
+#include "refcount.h"
+#include "journal.h"
+#include "trace.h"
 #include "clusters.h"
+#include "cache.h"
+#include "dirindex.h"
+#include "dcache.h"
+#include "locks.h"
+
+
+
+// nejvyšší počet bufferů jednoho volání preadv/pwritev (IOV_MAX v Linuxu)
+#define MAX_IOV 1024
+
+// přenese celý vektor bufferů, zkrácené přenosy se opakují od místa, kde skončily
+static bool transfer_vec(filesystem_t *fs, bool write, off_t offset, struct iovec *iov, int count) {
+    int fd = fileno(fs->file);
+    while (count > 0) {
+        int batch = count < MAX_IOV ? count : MAX_IOV;
+        ssize_t done = write ? pwritev(fd, iov, batch, offset) : preadv(fd, iov, batch, offset);
+        if (done < 0 && errno == EINTR) continue;
+        if (done <= 0) return false;
+        count_io(fs, write, done);
+
+        offset += done;
+        while (count > 0 && (size_t)done >= iov->iov_len) {
+            done -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (uint8_t *)iov->iov_base + done;
+            iov->iov_len -= done;
+        }
+    }
+    return true;
+}
 
+void count_io(filesystem_t *fs, bool write, size_t bytes) {
+    atomic_fetch_add_explicit(write ? &fs->bytes_written : &fs->bytes_read, bytes, memory_order_relaxed);
+}
 
-
-bool read_bytes(filesystem_t *fs, int32_t offset, void *buffer, size_t size) {
-    if (fseek(fs->file, offset, SEEK_SET) != 0) return false;
-    if (fread(buffer, size, 1, fs->file) != 1) return false;
-    return true;
+bool read_bytes(filesystem_t *fs, int64_t offset, void *buffer, size_t size) {
+    struct iovec iov = { buffer, size };
+    return read_vec(fs, offset, &iov, 1);
 }
 
-bool write_bytes(filesystem_t *fs, int32_t offset, const void *buffer, size_t size) {
-    if (fseek(fs->file, offset, SEEK_SET) != 0) return false;
-    if (fwrite(buffer, size, 1, fs->file) != 1) return false;
-    fflush(fs->file);
-    return true;
+bool write_bytes(filesystem_t *fs, int64_t offset, const void *buffer, size_t size) {
+    struct iovec iov = { (void *)buffer, size };
+    return write_vec(fs, offset, &iov, 1);
 }
 
+bool read_vec(filesystem_t *fs, int64_t offset, struct iovec *iov, int count) {
+    if (fs->map) {
+        for (int i = 0; i < count; i++) {
+            if (offset < 0 || (size_t)offset + iov[i].iov_len > fs->map_size) return false;
+            memcpy(iov[i].iov_base, fs->map + offset, iov[i].iov_len);
+            count_io(fs, false, iov[i].iov_len);
+            offset += iov[i].iov_len;
+        }
+        return true;
+    }
 
-bool load_superblock(filesystem_t *fs) {
-    return read_bytes(fs, 0, &fs->sb, sizeof(superblock_t));
+    //bez žurnálu se čte přímo, jinak se záznamy nesmí změnit mezi čtením a překryvem
+    if (!fs->journal) return transfer_vec(fs, false, offset, iov, count);
+    fs_rwlock(fs, RWLOCK_JOURNAL, false);
+
+    //transfer_vec mění iov, překryv ze žurnálu potřebuje původní buffery
+    struct iovec saved[count];
+    bool journaled = fs->journal->length > 0;
+    if (journaled) memcpy(saved, iov, sizeof(saved));
+    bool ok = transfer_vec(fs, false, offset, iov, count);
+    if (ok && journaled) journal_overlay(fs, offset, saved, count);
+    fs_rwunlock(fs, RWLOCK_JOURNAL);
+    return ok;
 }
 
-bool save_superblock(filesystem_t *fs) {
-    return write_bytes(fs, 0, &fs->sb, sizeof(superblock_t));
+bool write_vec(filesystem_t *fs, int64_t offset, struct iovec *iov, int count) {
+    if (fs->map) {
+        for (int i = 0; i < count; i++) {
+            if (offset < 0 || (size_t)offset + iov[i].iov_len > fs->map_size) return false;
+            memcpy(fs->map + offset, iov[i].iov_base, iov[i].iov_len);
+            count_io(fs, true, iov[i].iov_len);
+            offset += iov[i].iov_len;
+        }
+        return true;
+    }
+    //metadata se zapíšou do obrazu až po zapsání transakce do žurnálu
+    if (journal_active(fs)) return journal_capture(fs, offset, iov, count);
+    return transfer_vec(fs, true, offset, iov, count);
 }
 
+bool write_data_vec(filesystem_t *fs, int64_t offset, struct iovec *iov, int count) {
+    if (fs->map || !journal_active(fs)) return write_vec(fs, offset, iov, count);
+    if (!journal_data_write(fs, offset, iov, count)) return false;
+    if (!transfer_vec(fs, true, offset, iov, count)) return false;
+    journal_data_written(fs);
+    return true;
+}
 
-void load_bitmaps(filesystem_t *fs) {
-    int32_t ibitmap_size = (fs->sb.inode_count + 7) / 8;
-    int32_t dbitmap_size = (fs->sb.cluster_count + 7) / 8;
+// zapíše celý buffer do souboru, zkrácené zápisy se opakují
+static bool write_full(int fd, const uint8_t *data, size_t size) {
+    while (size > 0) {
+        ssize_t done = write(fd, data, size);
+        if (done < 0 && errno == EINTR) continue;
+        if (done <= 0) return false;
+        data += done;
+        size -= done;
+    }
+    return true;
+}
 
-    if (fs->inode_bitmap != NULL) {
-        free(fs->inode_bitmap);
-        fs->inode_bitmap = NULL;
+bool copy_out_bytes(filesystem_t *fs, int64_t offset, size_t size, int out_fd) {
+    //u mmap stačí jeden zápis přímo z mapování
+    if (fs->map) {
+        if (offset < 0 || (size_t)offset + size > fs->map_size) return false;
+        count_io(fs, false, size);
+        return write_full(out_fd, fs->map + offset, size);
     }
-    if (fs->data_bitmap != NULL) {
-        free(fs->data_bitmap);
-        fs->data_bitmap = NULL;
+
+    int in_fd = fileno(fs->file);
+    off_t pos = offset;
+    //novější obsah části oblasti je zatím jen v žurnálu - jádro by četlo starý
+    bool journaled = journal_covers(fs, offset, size);
+    bool use_copy_range = !journaled, use_sendfile = !journaled;
+    while (size > 0) {
+        ssize_t done;
+        if (use_copy_range) {
+            done = copy_file_range(in_fd, &pos, out_fd, NULL, size, 0);
+            //jádro nebo cílový fs ho neumí (jiný fs u starších jader, roura) - zkusí se sendfile
+            if (done < 0 && (errno == ENOSYS || errno == EXDEV || errno == EINVAL || errno == EOPNOTSUPP)) {
+                TRACE(TRACE_IO, TRACE_INFO, "copy_file_range unavailable (errno %d), using sendfile", errno);
+                use_copy_range = false;
+                continue;
+            }
+        } else if (use_sendfile) {
+            done = sendfile(out_fd, in_fd, &pos, size);
+            if (done < 0 && (errno == ENOSYS || errno == EINVAL)) {
+                TRACE(TRACE_IO, TRACE_INFO, "sendfile unavailable (errno %d), using pread/write", errno);
+                use_sendfile = false;
+                continue;
+            }
+        } else {
+            //poslední možnost - přes buffer, read_bytes vidí i obsah žurnálu
+            uint8_t buffer[CLUSTER_SIZE * 16];
+            size_t chunk = size < sizeof(buffer) ? size : sizeof(buffer);
+            done = read_bytes(fs, pos, buffer, chunk) ? (ssize_t)chunk : 0;
+            if (done > 0 && !write_full(out_fd, buffer, done)) return false;
+            if (done > 0) pos += done;
+        }
+
+        if (done < 0 && errno == EINTR) continue;
+        if (done <= 0) return false;
+        //záložní cestu už započítalo read_bytes
+        if (use_copy_range || use_sendfile) count_io(fs, false, done);
+        size -= done;
     }
-    
-    fs->inode_bitmap = malloc(ibitmap_size);
-    fs->data_bitmap = malloc(dbitmap_size);
-    
-    read_bytes(fs, fs->sb.bitmapi_start, fs->inode_bitmap, ibitmap_size);
-    read_bytes(fs, fs->sb.bitmap_start, fs->data_bitmap, dbitmap_size);
+    return true;
 }
 
-void save_bitmaps(filesystem_t *fs) {
-    int32_t inode_bitmap_size = (fs->sb.inode_count + 7) / 8;
-    int32_t data_bitmap_size = (fs->sb.cluster_count + 7) / 8;
-    
-    write_bytes(fs, fs->sb.bitmapi_start, fs->inode_bitmap, inode_bitmap_size);
-    write_bytes(fs, fs->sb.bitmap_start, fs->data_bitmap, data_bitmap_size);
+void *image_ptr(filesystem_t *fs, int64_t offset, size_t size) {
+    if (!fs->map || offset < 0 || (size_t)offset + size > fs->map_size) return NULL;
+    return fs->map + offset;
 }
 
-bool is_bit_set(uint8_t *bitmap, int32_t index){
-    int32_t byte_index = index / 8;
-    int32_t bit_index  = index % 8;
-
-    uint8_t mask = (1 << bit_index);
+size_t image_size(filesystem_t *fs) {
+    return fs->sb.data_start + (int64_t)fs->sb.cluster_count * fs->sb.cluster_size;
+}
 
-    return (bitmap[byte_index] & mask) != 0;
+int64_t host_file_size(filesystem_t *fs) {
+    struct stat st;
+    if (fstat(fileno(fs->file), &st) != 0) return -1;
+    return st.st_size;
 }
 
+bool map_image(filesystem_t *fs, size_t size) {
+    unmap_image(fs);
+    if (size == 0) return true;
 
-void set_bit(uint8_t *bitmap, int32_t index)
-{
-    int32_t byte_index = index / 8;
-    int32_t bit_index  = index % 8;
+    //soubor se nikdy nezkracuje, pouze prodlouží na požadovanou velikost
+    int fd = fileno(fs->file);
+    struct stat st;
+    if (fstat(fd, &st) != 0) return false;
+    if ((size_t)st.st_size < size && ftruncate(fd, size) != 0) return false;
 
-    uint8_t mask = (1 << bit_index);
+    void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) return false;
 
-    bitmap[byte_index] |= mask;
+    fs->map = map;
+    fs->map_size = size;
+    return true;
 }
 
-void clear_bit(uint8_t *bitmap, int32_t index)
-{
-    int32_t byte_index = index / 8;
-    int32_t bit_index  = index % 8;
+bool resize_image(filesystem_t *fs, size_t size) {
+    unmap_image(fs);
 
-    uint8_t mask = (1 << bit_index);
+    //format - obsah se zahazuje (zkrácení na 0 vynuluje i tabulky mimo bitmapy), soubor odpovídá přesně nové velikosti
+    if (ftruncate(fileno(fs->file), 0) != 0 || ftruncate(fileno(fs->file), size) != 0) return false;
+    if (fs->engine != IO_ENGINE_MMAP) return true;
+    return map_image(fs, size);
+}
 
-    bitmap[byte_index] &= ~mask;
+void unmap_image(filesystem_t *fs) {
+    if (!fs->map) return;
+    msync(fs->map, fs->map_size, MS_SYNC);
+    munmap(fs->map, fs->map_size);
+    fs->map = NULL;
+    fs->map_size = 0;
 }
 
 
+zosfs_status_t load_superblock(filesystem_t *fs, int32_t *version_out) {
+    uint8_t raw[sizeof(superblock_t)];
+    if (!read_bytes(fs, 0, raw, sizeof(raw))) return ZOSFS_EIO;
 
+    //formát 1 má na místě čísla verze velikost disku (vždy alespoň 1 MB)
+    int32_t version;
+    memcpy(&version, raw + offsetof(superblock_v1_t, disk_size), sizeof(int32_t));
 
+    if (version >= FS_MAX_VERSION_VALUE) {
+        superblock_v1_t old;
+        memcpy(&old, raw, sizeof(old));
+        //starší obrazy mají kratší superblok, položky za jeho koncem jsou už bitmapa
+        if (old.bitmapi_start < (int32_t)sizeof(old)) {
+            memset((uint8_t *)&old + old.bitmapi_start, 0, sizeof(old) - old.bitmapi_start);
+        }
 
-int32_t find_in_dir(filesystem_t *fs, int32_t dir_inode_id, const char *name) {
-    printf("[DEBUG] find_in_dir: searching for '%s' in inode %d\n", name, dir_inode_id);
-    
-    inode_t dir_inode;
-    if (!read_inode(fs, dir_inode_id, &dir_inode)) {
-        printf("[DEBUG] Failed to read inode %d\n", dir_inode_id);
-        return -1;
+        memset(&fs->sb, 0, sizeof(superblock_t));
+        memcpy(fs->sb.signature, old.signature, sizeof(old.signature));
+        memcpy(fs->sb.description, old.description, sizeof(old.description));
+        fs->sb.version = FS_VERSION_32;
+        fs->sb.disk_size = old.disk_size;
+        fs->sb.cluster_size = old.cluster_size;
+        fs->sb.cluster_count = old.cluster_count;
+        fs->sb.inode_count = old.inode_count;
+        fs->sb.bitmapi_start = old.bitmapi_start;
+        fs->sb.bitmap_start = old.bitmap_start;
+        fs->sb.inode_start = old.inode_start;
+        fs->sb.data_start = old.data_start;
+        fs->sb.cluster_cursor = old.cluster_cursor;
+        fs->sb.inode_cursor = old.inode_cursor;
+        return ZOSFS_OK;
     }
 
-    //nejedná se o složku
-    if (!dir_inode.is_directory) {
-        printf("[DEBUG] Inode %d is not a directory\n", dir_inode_id);
-        return -1;
+    if (version != FS_VERSION_64) {
+        if (version_out) *version_out = version;
+        return ZOSFS_ENOTSUP;
     }
-    
-    printf("[DEBUG] Directory file_size: %d bytes\n", dir_inode.file_size);
-    printf("[DEBUG] Directory direct1: %d\n", dir_inode.direct1);
-    
-    int32_t cluster_count = (dir_inode.file_size + fs->sb.cluster_size - 1) / fs->sb.cluster_size;
-    printf("[DEBUG] Calculated cluster_count: %d\n", cluster_count);
-    
-    //složka je prázdná
-    if (cluster_count == 0) {
-        printf("[DEBUG] Directory is empty (0 clusters)\n");
-        return -1;
+
+    memcpy(&fs->sb, raw, sizeof(superblock_t));
+    if (fs->sb.bitmapi_start < (int64_t)sizeof(superblock_t)) {
+        memset((uint8_t *)&fs->sb + fs->sb.bitmapi_start, 0, sizeof(superblock_t) - fs->sb.bitmapi_start);
     }
+    return ZOSFS_OK;
+}
+
+bool save_superblock(filesystem_t *fs) {
+    if (fs->sb.version == FS_VERSION_32) {
+        //starší obraz zůstává ve svém formátu
+        superblock_v1_t old = {0};
+        memcpy(old.signature, fs->sb.signature, sizeof(old.signature));
+        memcpy(old.description, fs->sb.description, sizeof(old.description));
+        old.disk_size = fs->sb.disk_size;
+        old.cluster_size = fs->sb.cluster_size;
+        old.cluster_count = fs->sb.cluster_count;
+        old.inode_count = fs->sb.inode_count;
+        old.bitmapi_start = fs->sb.bitmapi_start;
+        old.bitmap_start = fs->sb.bitmap_start;
+        old.inode_start = fs->sb.inode_start;
+        old.data_start = fs->sb.data_start;
+        old.cluster_cursor = fs->sb.cluster_cursor;
+        old.inode_cursor = fs->sb.inode_cursor;
+
+        size_t size = sizeof(old);
+        if (old.bitmapi_start < (int32_t)size) size = old.bitmapi_start;
+        return write_bytes(fs, 0, &old, size);
+    }
+
+    size_t size = sizeof(superblock_t);
+    if (fs->sb.bitmapi_start < (int64_t)size) {
+        size = fs->sb.bitmapi_start;
+    }
+    return write_bytes(fs, 0, &fs->sb, size);
+}
+
+
+void load_bitmaps(filesystem_t *fs) {
+    bitmap_destroy(fs->inode_bitmap);
+    bitmap_destroy(fs->data_bitmap);
+
+    fs->inode_bitmap = bitmap_create(fs->sb.inode_count);
+    fs->data_bitmap = bitmap_create(fs->sb.cluster_count);
     
-    dir_item_t entries[ENTRIES_PER_CLUSTER];
-    
-    for (int32_t i = 0; i < cluster_count; i++) {
-        int32_t cluster = get_file_cluster(fs, &dir_inode, i);
-        
-        printf("[DEBUG] Cluster index %d -> cluster number %d\n", i, cluster);
-        
-        if (cluster == 0) {
-            printf("[DEBUG] Cluster is 0, skipping\n");
-            continue;
-        }
-        
-        read_cluster(fs, cluster, entries);
-        printf("[DEBUG] Reading cluster %d, checking entries:\n", cluster);
-        //procházení položek v clusteru a hledání shody
-        for (int j = 0; j < ENTRIES_PER_CLUSTER; j++) {
-            if (entries[j].inode != 0) {
-                printf("[DEBUG]   Entry %d: name='%s', inode=%d\n", 
-                       j, entries[j].name, entries[j].inode);
-                
-                if (strcmp(entries[j].name, name) == 0) {
-                    printf("[DEBUG] FOUND! Returning inode %d\n", entries[j].inode);
-                    return entries[j].inode;
+    read_bytes(fs, fs->sb.bitmapi_start, fs->inode_bitmap->words, bitmap_bytes(fs->inode_bitmap));
+    read_bytes(fs, fs->sb.bitmap_start, fs->data_bitmap->words, bitmap_bytes(fs->data_bitmap));
+
+    bitmap_rebuild_summary(fs->inode_bitmap);
+    bitmap_rebuild_summary(fs->data_bitmap);
+    bitmap_clear_dirty(fs->inode_bitmap);
+    bitmap_clear_dirty(fs->data_bitmap);
+    //cluster 0 je rezervován pro "null" ukazatel
+    if (!is_bit_set(fs->data_bitmap, 0)) set_bit(fs->data_bitmap, 0);
+}
+
+// spočítá adresáře procházením obsazených inodů
+static int32_t count_directories(filesystem_t *fs) {
+    int32_t count = 0;
+    //tabulka se čte po oknech sousedních úseků, cache ji celou držet nemusí
+    int32_t window = INODE_CACHE_CHUNKS / 2;
+    int32_t *ids = malloc(window * sizeof(int32_t));
+    for (int32_t start = 0; start < fs->sb.inode_count; start += window * INODES_PER_CLUSTER) {
+        int32_t end = start + window * INODES_PER_CLUSTER;
+        if (end > fs->sb.inode_count) end = fs->sb.inode_count;
+
+        //z každého úseku stačí jeden obsazený inode, prázdné úseky se nečtou
+        int32_t n = 0;
+        for (int32_t chunk = start; ids && chunk < end; chunk += INODES_PER_CLUSTER) {
+            for (int32_t i = chunk; i < chunk + (int32_t)INODES_PER_CLUSTER && i < end; i++) {
+                if (is_bit_set(fs->inode_bitmap, i)) {
+                    ids[n++] = i;
+                    break;
                 }
             }
         }
+        if (ids) inode_cache_load(fs, ids, n);
+
+        for (int32_t i = start; i < end; i++) {
+            inode_t inode;
+            if (is_bit_set(fs->inode_bitmap, i) && read_inode(fs, i, &inode) && inode.is_directory) {
+                count++;
+            }
+        }
     }
-    
-    printf("[DEBUG] Not found, returning -1\n");
-    return -1;
+    free(ids);
+    return count;
 }
 
+void verify_counters(filesystem_t *fs) {
+    //počty z bitmap spočítal popcount při načtení, cluster 0 je rezervovaný
+    int32_t used_clusters = bitmap_used(fs->data_bitmap) - 1;
+    int32_t used_inodes = bitmap_used(fs->inode_bitmap);
+    bool stored = fs->sb.features & FS_FEATURE_COUNTERS;
 
-bool add_to_dir(filesystem_t *fs, int32_t dir_inode_id, const char *name, int32_t inode_id) {
-    inode_t dir_inode;
-    if (!read_inode(fs, dir_inode_id, &dir_inode)) return false;
-    
-    int32_t cluster_count = (dir_inode.file_size + fs->sb.cluster_size - 1) / fs->sb.cluster_size;
+    if (stored && fs->sb.used_clusters == used_clusters && fs->sb.used_inodes == used_inodes) return;
+
+    //starší obraz počty neukládá, u nesouhlasu nelze věřit ani počtu adresářů
+    if (stored) {
+        TRACE(TRACE_ALLOC, TRACE_ERROR, "superblock counters %d/%d differ from bitmaps %d/%d, rebuilding",
+              fs->sb.used_clusters, fs->sb.used_inodes, used_clusters, used_inodes);
+        fs->sb_dirty = true;
+    }
+    fs->sb.used_clusters = used_clusters;
+    fs->sb.used_inodes = used_inodes;
+    fs->sb.dir_count = count_directories(fs);
+}
+
+void directory_count_changed(filesystem_t *fs, int32_t delta) {
+    fs_lock(fs, LOCK_ALLOC);
+    fs->sb.dir_count += delta;
+    fs->sb_dirty = true;
+    bitmaps_changed(fs);
+    fs_unlock(fs, LOCK_ALLOC);
+}
+
+// zápis změněných úseků jedné bitmapy
+static void save_bitmap(filesystem_t *fs, bitmap_t *bitmap, int64_t start) {
+    int32_t pos = 0, offset, size;
+
+    if (!bitmap->any_dirty) return;
+    while (bitmap_next_dirty(bitmap, &pos, &offset, &size)) {
+        write_bytes(fs, start + offset, (uint8_t *)bitmap->words + offset, size);
+    }
+    bitmap_clear_dirty(bitmap);
+}
+
+void save_bitmaps(filesystem_t *fs) {
+    fs_lock(fs, LOCK_ALLOC);
+    save_bitmap(fs, fs->inode_bitmap, fs->sb.bitmapi_start);
+    save_bitmap(fs, fs->data_bitmap, fs->sb.bitmap_start);
+    //počty obsazených clusterů a inodů se ukládají se superblokem
+    int32_t used_clusters = bitmap_used(fs->data_bitmap) - 1;
+    int32_t used_inodes = bitmap_used(fs->inode_bitmap);
+    if (fs->sb.used_clusters != used_clusters || fs->sb.used_inodes != used_inodes) {
+        fs->sb.used_clusters = used_clusters;
+        fs->sb.used_inodes = used_inodes;
+        if (fs->sb.features & FS_FEATURE_COUNTERS) fs->sb_dirty = true;
+    }
+    //uložení kurzorů alokace
+    if (fs->sb_dirty) {
+        save_superblock(fs);
+        fs->sb_dirty = false;
+    }
+    fs_unlock(fs, LOCK_ALLOC);
+}
+
+void bitmaps_changed(filesystem_t *fs) {
+    if (fs->sync_policy == SYNC_ALWAYS) {
+        save_bitmaps(fs);
+    }
+}
+
+void sync_fs(filesystem_t *fs) {
+    if (!fs->inode_bitmap || !fs->data_bitmap) return;
+    cache_sync(fs);
+    inode_cache_sync(fs);
+    refcount_sync(fs);
+    save_bitmaps(fs);
+    if (fs->map) {
+        msync(fs->map, fs->map_size, MS_SYNC);
+    }
+    //všechny zápisy příkazu tvoří jednu transakci
+    journal_commit(fs);
+}
+
+size_t unsynced_bytes(filesystem_t *fs) {
+    size_t size = sizeof(superblock_t) + cache_dirty_bytes(fs) + inode_cache_dirty_bytes(fs) + refcount_dirty_bytes(fs);
+    fs_lock(fs, LOCK_ALLOC);
+    if (fs->inode_bitmap) size += bitmap_dirty_bytes(fs->inode_bitmap);
+    if (fs->data_bitmap) size += bitmap_dirty_bytes(fs->data_bitmap);
+    fs_unlock(fs, LOCK_ALLOC);
+    return size;
+}
+
+void command_done(filesystem_t *fs) {
+    if (fs->sync_policy != SYNC_MANUAL && !fs->in_batch) {
+        sync_fs(fs);
+    }
+}
+
+
+
+
+
+// zapíše jednu položku adresáře na danou pozici v clusteru
+static bool write_dir_item(filesystem_t *fs, int32_t cluster, int32_t slot, const dir_item_t *item) {
     dir_item_t entries[ENTRIES_PER_CLUSTER];
+    if (!read_cluster(fs, cluster, entries)) return false;
+    entries[slot] = *item;
+    return write_cluster(fs, cluster, entries);
+}
+
+// hledání v adresáři, volající drží LOCK_DIRS
+static int32_t lookup_locked(filesystem_t *fs, int32_t dir_inode_id, const char *name) {
+    int32_t inode_id;
+    if (dcache_lookup(fs, dir_inode_id, name, &inode_id)) {
+        return inode_id;
+    }
+
+    //index se sestaví při prvním hledání v adresáři
+    dir_index_t *index = dir_index_get(fs, dir_inode_id);
+    if (!index) {
+        TRACE(TRACE_DIR, TRACE_ERROR, "find_in_dir: inode %d is not a directory", dir_inode_id);
+        return -1;
+    }
+
+    inode_id = dir_index_lookup(index, name, NULL, NULL);
+    dcache_insert(fs, dir_inode_id, name, inode_id);
+    TRACE(TRACE_DIR, TRACE_DEBUG, "find_in_dir: '%s' in %d -> %d", name, dir_inode_id, inode_id);
+    return inode_id;
+}
+
+int32_t find_in_dir(filesystem_t *fs, int32_t dir_inode_id, const char *name) {
+    fs_lock(fs, LOCK_DIRS);
+    int32_t inode_id = lookup_locked(fs, dir_inode_id, name);
+    fs_unlock(fs, LOCK_DIRS);
+    return inode_id;
+}
+
+int32_t dir_entry_count(filesystem_t *fs, int32_t dir_inode_id) {
+    fs_lock(fs, LOCK_DIRS);
+    //počet položek udržuje index adresáře
+    dir_index_t *index = dir_index_get(fs, dir_inode_id);
+    int32_t count = index ? index->count : -1;
+    fs_unlock(fs, LOCK_DIRS);
+    return count;
+}
+
+void forget_dir(filesystem_t *fs, int32_t dir_inode_id) {
+    fs_lock(fs, LOCK_DIRS);
+    dir_index_drop(fs, dir_inode_id);
+    dcache_drop_dir(fs, dir_inode_id);
+    fs_unlock(fs, LOCK_DIRS);
+}
+
+
+// přidání položky, volající drží LOCK_DIRS
+static bool add_locked(filesystem_t *fs, int32_t dir_inode_id, const char *name, int32_t inode_id) {
+    dir_index_t *index = dir_index_get(fs, dir_inode_id);
+    if (!index) return false;
+
+    dir_item_t item = {0};
+    strncpy(item.name, name, NAME_SIZE - 1);
+    item.name[NAME_SIZE - 1] = '\0';
+    item.inode = inode_id;
     
-    //Není prázdný cluster?
-    for (int32_t i = 0; i < cluster_count; i++) {
-        int32_t cluster = get_file_cluster(fs, &dir_inode, i);
-        if (cluster == 0) continue;
-        
-        read_cluster(fs, cluster, entries);
-        for (int j = 0; j < ENTRIES_PER_CLUSTER; j++) {
-            if (entries[j].inode == 0) {
-                strncpy(entries[j].name, name, NAME_SIZE - 1);
-                entries[j].name[NAME_SIZE - 1] = '\0';
-                entries[j].inode = inode_id;
-                write_cluster(fs, cluster, entries);
-                return true;
-            }
+    //volná pozice v existujícím clusteru
+    int32_t cluster, slot;
+    if (dir_index_take_slot(index, &cluster, &slot)) {
+        if (!write_dir_item(fs, cluster, slot, &item)) {
+            dir_index_add_slot(index, cluster, slot);
+            return false;
         }
+        dcache_insert(fs, dir_inode_id, item.name, inode_id);
+        return dir_index_insert(index, item.name, inode_id, cluster, slot);
     }
     
     //pokud ne, alokuj nové
+    inode_t dir_inode;
+    if (!read_inode(fs, dir_inode_id, &dir_inode)) return false;
+
+    int32_t cluster_count = (dir_inode.file_size + fs->sb.cluster_size - 1) / fs->sb.cluster_size;
     int32_t new_cluster = alloc_cluster(fs);
     if (new_cluster < 0) return false;
     
+    dir_item_t entries[ENTRIES_PER_CLUSTER];
     memset(entries, 0, sizeof(entries));
-    strncpy(entries[0].name, name, NAME_SIZE - 1);
-    entries[0].inode = inode_id;
+    entries[0] = item;
     
     write_cluster(fs, new_cluster, entries);
     set_file_cluster(fs, &dir_inode, cluster_count, new_cluster);
     
     dir_inode.file_size += fs->sb.cluster_size;
     write_inode(fs, dir_inode_id, &dir_inode);
-    
-    return true;
+
+    //zbytek nového clusteru jsou volné pozice
+    for (int32_t j = ENTRIES_PER_CLUSTER - 1; j > 0; j--) {
+        dir_index_add_slot(index, new_cluster, j);
+    }
+    dcache_insert(fs, dir_inode_id, item.name, inode_id);
+    return dir_index_insert(index, item.name, inode_id, new_cluster, 0);
 }
 
+bool add_to_dir(filesystem_t *fs, int32_t dir_inode_id, const char *name, int32_t inode_id) {
+    fs_lock(fs, LOCK_DIRS);
+    bool ok = add_locked(fs, dir_inode_id, name, inode_id);
+    fs_unlock(fs, LOCK_DIRS);
+    return ok;
+}
 
 
-int32_t resolve_path(filesystem_t *fs, const char *path) {
-    printf("[DEBUG] resolve_path: '%s'\n", path);
-    
+
+int32_t resolve_path(filesystem_t *fs, int32_t cwd, const char *path) {
     //prázdná cesta -> aktuální adresář
     if (!path || !path[0]) {
-        return fs->current_inode;
+        return cwd;
     }
     
     //absolutní/relativní cesta
-    int32_t current = (path[0] == '/') ? 0 : fs->current_inode;
+    int32_t current = (path[0] == '/') ? 0 : cwd;
     
     //root adresář
     if (strcmp(path, "/") == 0) {
         return 0;
     }
     
-    char path_copy[256];
-    strncpy(path_copy, path, sizeof(path_copy) - 1);
-    path_copy[sizeof(path_copy) - 1] = '\0';
-    
-    //přeskočí počáteční lomítko u absolutní cesty
-    char *p = path_copy;
-    if (*p == '/') p++;
-    
-    
-    char *token = strtok(p, "/");
-    while (token) {
-        printf("[DEBUG]   Processing token: '%s' (current inode: %d)\n", token, current);
-        
+    //procházení komponent cesty bez kopírování celé cesty (bez strtok)
+    const char *p = path;
+    while (*p) {
+        while (*p == '/') p++;
+        if (!*p) break;
+
+        const char *end = strchr(p, '/');
+        size_t len = end ? (size_t)(end - p) : strlen(p);
+        char token[256];
+        if (len >= sizeof(token)) return -1;
+        memcpy(token, p, len);
+        token[len] = '\0';
+        p += len;
+
         //"." -> stejná složka
         if (strcmp(token, ".") == 0) {
-            token = strtok(NULL, "/");
             continue;
         }
         
@@ -238,23 +593,20 @@ int32_t resolve_path(filesystem_t *fs, const char *path) {
             inode_t node;
             if (!read_inode(fs, current, &node)) return -1;
             current = node.parent;
-            token = strtok(NULL, "/");
             continue;
         }
         
-        //nalezení další složky v cestě
+        //nalezení další složky v cestě (přes cache hledání)
         int32_t next = find_in_dir(fs, current, token);
         if (next < 0) {
-            printf("[DEBUG]   Not found: '%s'\n", token);
+            TRACE(TRACE_PATH, TRACE_ERROR, "resolve_path: '%s' not found in %d", token, current);
             return -1;
         }
         
         current = next;
-        token = strtok(NULL, "/");
     }
     
-    printf("[DEBUG]   Path copy: %s\n", path_copy);
-    printf("[DEBUG]   Final inode: %d\n", current);
+    TRACE(TRACE_PATH, TRACE_DEBUG, "resolve_path: '%s' -> %d", path, current);
     return current;
 }
 
@@ -282,36 +634,29 @@ void update_path(char *current_path, const char *input) {
 
 
 bool remove_from_dir(filesystem_t *fs, int32_t dir_inode_id, const char *name) {
-    inode_t dir_inode;
-    if (!read_inode(fs, dir_inode_id, &dir_inode)) return false;
-    
-    int32_t cluster_count = (dir_inode.file_size + fs->sb.cluster_size - 1) / fs->sb.cluster_size;
-    dir_item_t entries[ENTRIES_PER_CLUSTER];
-    
-    for (int32_t i = 0; i < cluster_count; i++) {
-        int32_t cluster = get_file_cluster(fs, &dir_inode, i);
-        if (cluster == 0) continue;
-        
-        read_cluster(fs, cluster, entries);
-        
-        for (int j = 0; j < ENTRIES_PER_CLUSTER; j++) {
-            if (entries[j].inode != 0 && strcmp(entries[j].name, name) == 0) {
-                //Nalezení správného vstupu a jeho vymazání
-                entries[j].inode = 0;
-                memset(entries[j].name, 0, NAME_SIZE);
-                //zápis změněného clusteru do paměti
-                write_cluster(fs, cluster, entries);
-                return true;
-            }
-        }
+    fs_lock(fs, LOCK_DIRS);
+    dir_index_t *index = dir_index_get(fs, dir_inode_id);
+    int32_t cluster, slot;
+    if (!index || dir_index_lookup(index, name, &cluster, &slot) < 0) {
+        fs_unlock(fs, LOCK_DIRS);
+        return false;
     }
-    
-    return false;
+
+    //Nalezení správného vstupu a jeho vymazání
+    dir_item_t empty = {0};
+    bool ok = write_dir_item(fs, cluster, slot, &empty);
+    if (ok) {
+        dir_index_remove(index, name);
+        dir_index_add_slot(index, cluster, slot);
+        dcache_insert(fs, dir_inode_id, name, -1);
+    }
+    fs_unlock(fs, LOCK_DIRS);
+    return ok;
 }
 
 
 
-bool split_path(filesystem_t *fs, const char *path, int32_t *parent_inode, char *filename) {
+bool split_path(filesystem_t *fs, int32_t cwd, const char *path, int32_t *parent_inode, char *filename) {
     if (!path || !path[0]) return false;
 
     char path_copy[256];
@@ -328,13 +673,13 @@ bool split_path(filesystem_t *fs, const char *path, int32_t *parent_inode, char
         } else {
             //escape charakter - ukončení řetězce, path_copy nevidí jméno souboru
             *last_slash = '\0';
-            *parent_inode = resolve_path(fs, path_copy);
+            *parent_inode = resolve_path(fs, cwd, path_copy);
         }
         if (*parent_inode < 0) return false;
         strncpy(filename, name, NAME_SIZE - 1);
     } else {
         //pouze jméno souboru, pracujeme v aktuálním adresáři
-        *parent_inode = fs->current_inode;
+        *parent_inode = cwd;
         strncpy(filename, path, NAME_SIZE - 1);
     }
     filename[NAME_SIZE - 1] = '\0';
@@ -1,15 +1,52 @@
 #pragma once
 #include "structs.h"
+#include "bitmap.h"
+#include "zosfs.h"
 #include <stdbool.h>
+#include <sys/uio.h>
 
-// wrapper fseek a fread
-bool read_bytes(filesystem_t *fs, int32_t offset, void *buffer, size_t size);
+// přečtení bytů z pozice offset (pread, bez sdílené pozice v souboru)
+bool read_bytes(filesystem_t *fs, int64_t offset, void *buffer, size_t size);
 
-// wrapper fseek a fwrite
-bool write_bytes(filesystem_t *fs, int32_t offset, const void *buffer, size_t size);
+// zápis bytů na pozici offset (pwrite)
+bool write_bytes(filesystem_t *fs, int64_t offset, const void *buffer, size_t size);
 
-// přečtení dat ze superbloku
-bool load_superblock(filesystem_t *fs);
+// přečtení souvislé oblasti od offset rozptýleně do více bufferů (preadv), iov se mění
+bool read_vec(filesystem_t *fs, int64_t offset, struct iovec *iov, int count);
+
+// zápis více bufferů do souvislé oblasti od offset (pwritev), iov se mění
+bool write_vec(filesystem_t *fs, int64_t offset, struct iovec *iov, int count);
+
+// zápis dat souboru přímo na místo (mimo žurnál), starší záznamy žurnálu ho nesmí přepsat
+bool write_data_vec(filesystem_t *fs, int64_t offset, struct iovec *iov, int count);
+
+// zkopíruje size bytů od offset do otevřeného souboru out_fd na jeho aktuální pozici
+// jádrem (copy_file_range, jinak sendfile), data neprochází uživatelským prostorem
+bool copy_out_bytes(filesystem_t *fs, int64_t offset, size_t size, int out_fd);
+
+// započítá byty přenesené z obrazu nebo do něj (zosfs_io_stats)
+void count_io(filesystem_t *fs, bool write, size_t bytes);
+
+// ukazatel přímo do namapovaného souboru, NULL pokud se mmap nepoužívá
+void *image_ptr(filesystem_t *fs, int64_t offset, size_t size);
+
+// velikost souboru potřebná pro naformátovaný fs
+size_t image_size(filesystem_t *fs);
+
+// aktuální velikost souboru s fs (fstat, nemění pozici v souboru), -1 při chybě
+int64_t host_file_size(filesystem_t *fs);
+
+// namapuje soubor s fs do paměti, kratší soubor prodlouží na size
+bool map_image(filesystem_t *fs, size_t size);
+
+// změní velikost souboru s fs (při formátování), u mmap ho znovu namapuje
+bool resize_image(filesystem_t *fs, size_t size);
+
+// zapíše namapovanou oblast na disk a zruší mapování
+void unmap_image(filesystem_t *fs);
+
+// přečtení dat ze superbloku, u ZOSFS_ENOTSUP uloží nepodporovanou verzi formátu do *version (může být NULL)
+zosfs_status_t load_superblock(filesystem_t *fs, int32_t *version);
 
 //zápis dat do superbloku
 bool save_superblock(filesystem_t *fs);
@@ -17,26 +54,42 @@ bool save_superblock(filesystem_t *fs);
 //Načtení bitmapy do paměti
 void load_bitmaps(filesystem_t *fs);
 
-//Zápis změn do paměti
+//Zápis změněných úseků bitmap (a kurzorů v superbloku) na disk
 void save_bitmaps(filesystem_t *fs);
 
-//testování hodnoty bitu
-bool is_bit_set(uint8_t *bitmap, int32_t index);
+//Po připojení ověří počty obsazených clusterů a inodů v superbloku proti bitmapám,
+//u nesouhlasu nebo staršího obrazu je přepočítá včetně počtu adresářů
+void verify_counters(filesystem_t *fs);
+
+//Změna počtu adresářů (mkdir, rmdir)
+void directory_count_changed(filesystem_t *fs, int32_t delta);
 
-//nastavení hodnoty bitu na 1
-void set_bit(uint8_t *bitmap, int32_t index);
+//Oznámení změny bitmap - podle politiky zápisu je hned uloží
+void bitmaps_changed(filesystem_t *fs);
 
-//vymazání hodnoty bitu (nastavení na 0)
-void clear_bit(uint8_t *bitmap, int32_t index);
+//Zápis všech odložených změn na disk
+void sync_fs(filesystem_t *fs);
+
+//Počet bytů neuložených změn metadat, které zapíše příští sync_fs (horní odhad)
+size_t unsynced_bytes(filesystem_t *fs);
+
+//Konec příkazu - podle politiky zápisu zavolá sync_fs (uvnitř load --batch až na konci dávky)
+void command_done(filesystem_t *fs);
 
 //Hledá položku v adresáři podle jména, vrací inode nebo -1 pokud nenalezeno
 int32_t find_in_dir(filesystem_t *fs, int32_t dir_inode_id, const char *name);
 
+//Počet položek adresáře, -1 pokud nejde o adresář
+int32_t dir_entry_count(filesystem_t *fs, int32_t dir_inode_id);
+
+//Zahodí index a záznamy cache cest smazaného adresáře
+void forget_dir(filesystem_t *fs, int32_t dir_inode_id);
+
 //přidání položky do adresáře
 bool add_to_dir(filesystem_t *fs, int32_t dir_inode_id, const char *name, int32_t inode_id);
 
-//Vrátí inode číslo pro zadanou cestu, -1 pokud neexistuje
-int32_t resolve_path(filesystem_t *fs, const char *path);
+//Vrátí inode číslo pro zadanou cestu (relativní vůči adresáři cwd), -1 pokud neexistuje
+int32_t resolve_path(filesystem_t *fs, int32_t cwd, const char *path);
 
 //Upravuje výslednou cestu zadanou uživatelem
 void update_path(char *current_path, const char *input);
@@ -44,8 +97,8 @@ void update_path(char *current_path, const char *input);
 //Odebere položku z adresáře
 bool remove_from_dir(filesystem_t *fs, int32_t dir_inode_id, const char *name);
 
-//Rozdělí cestu na rodičovský inode a jméno souboru/adresáře
-bool split_path(filesystem_t *fs, const char *path, int32_t *out_parent_inode, char *out_name);
+//Rozdělí cestu (relativní vůči adresáři cwd) na rodičovský inode a jméno souboru/adresáře
+bool split_path(filesystem_t *fs, int32_t cwd, const char *path, int32_t *out_parent_inode, char *out_name);
 
 //Pomocná funkce pro výpis clusteru
 void print_clusters(int32_t *pointers, int limit, const char *prefix);
\ No newline at end of file
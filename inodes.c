@@ -6,29 +6,384 @@
 #include "structs.h"
 #include "commandline.h"
 #include "filesystem.h"
+#include "clusters.h"
+#include "inodes.h"
+#include "locks.h"
 
 
+// velikost i-uzlu na disku podle verze formátu
+static size_t inode_disk_size(filesystem_t *fs) {
+    return fs->sb.version == FS_VERSION_32 ? sizeof(inode_v1_t) : sizeof(inode_t);
+}
+
+// převod i-uzlu z podoby na disku
+static void decode_inode(filesystem_t *fs, const uint8_t *raw, inode_t *inode) {
+    if (fs->sb.version != FS_VERSION_32) {
+        memcpy(inode, raw, sizeof(inode_t));
+        return;
+    }
+
+    inode_v1_t old;
+    memcpy(&old, raw, sizeof(old));
+    memset(inode, 0, sizeof(inode_t));
+    inode->nodeid = old.nodeid;
+    inode->is_directory = old.is_directory;
+    inode->references = old.references;
+    inode->format = old.format;
+    inode->file_size = old.file_size;
+    inode->parent = old.parent;
+    memcpy(inode->map, old.map, sizeof(old.map));
+}
+
+// převod i-uzlu do podoby na disku
+static void encode_inode(filesystem_t *fs, const inode_t *inode, uint8_t *raw) {
+    if (fs->sb.version != FS_VERSION_32) {
+        memcpy(raw, inode, sizeof(inode_t));
+        return;
+    }
+
+    inode_v1_t old = {0};
+    old.nodeid = inode->nodeid;
+    old.is_directory = inode->is_directory;
+    old.references = inode->references;
+    old.format = inode->format;
+    old.file_size = inode->file_size;
+    old.parent = inode->parent;
+    memcpy(old.map, inode->map, sizeof(old.map));
+    memcpy(raw, &old, sizeof(old));
+}
+
+// počet inodů v úseku tabulky (poslední úsek může být kratší)
+static int32_t chunk_inodes(filesystem_t *fs, int32_t chunk) {
+    int32_t count = fs->sb.inode_count - chunk * (int32_t)INODES_PER_CLUSTER;
+    return count < (int32_t)INODES_PER_CLUSTER ? count : (int32_t)INODES_PER_CLUSTER;
+}
+
+static int64_t chunk_offset(filesystem_t *fs, int32_t chunk) {
+    return fs->sb.inode_start + (int64_t)chunk * INODES_PER_CLUSTER * inode_disk_size(fs);
+}
+
+static int64_t inode_offset(filesystem_t *fs, int32_t inode_id) {
+    return fs->sb.inode_start + (int64_t)inode_id * inode_disk_size(fs);
+}
+
+// úsek nově naformátované tabulky, který na disku ještě není - je prázdný a z disku se nečte
+static bool chunk_empty(inode_cache_t *cache, int32_t chunk) {
+    return cache->fresh && !cache->stored[chunk];
+}
+
+// uvolní nejdéle načtené čisté úseky, aby se vešlo dalších room úseků; změněné úseky
+// zůstávají až do uložení (pak může cache limit přesáhnout), volající drží zámek tabulky
+static void evict_chunks(inode_cache_t *cache, int32_t room) {
+    int32_t checked = 0;
+    while (cache->loaded > 0 && cache->loaded + room > INODE_CACHE_CHUNKS && checked < cache->loaded) {
+        int32_t chunk = cache->order[cache->order_head];
+        cache->order_head = (cache->order_head + 1) % cache->chunk_count;
+        if (cache->dirty[chunk]) {
+            //změněný úsek se přesune na konec fronty
+            cache->order[(cache->order_head + cache->loaded - 1) % cache->chunk_count] = chunk;
+            checked++;
+            continue;
+        }
+        free(cache->chunks[chunk]);
+        cache->chunks[chunk] = NULL;
+        cache->loaded--;
+        cache->evictions++;
+    }
+}
+
+// zařadí nově načtený úsek na konec fronty
+static void chunk_loaded(inode_cache_t *cache, int32_t chunk, uint8_t *data) {
+    cache->chunks[chunk] = data;
+    cache->order[(cache->order_head + cache->loaded) % cache->chunk_count] = chunk;
+    cache->loaded++;
+}
+
+// vrátí i-uzel v úseku tabulky (v podobě na disku), při prvním přístupu úsek načte
+static uint8_t *get_chunk_inode(filesystem_t *fs, int32_t inode_id) {
+    inode_cache_t *cache = fs->inode_cache;
+    int32_t chunk = inode_id / INODES_PER_CLUSTER;
+
+    if (!cache->chunks[chunk]) {
+        size_t size = chunk_inodes(fs, chunk) * inode_disk_size(fs);
+        evict_chunks(cache, 1);
+        uint8_t *data;
+        //nově naformátovaná tabulka se z disku nečte
+        if (chunk_empty(cache, chunk)) {
+            data = calloc(1, size);
+            if (!data) return NULL;
+        } else {
+            data = malloc(size);
+            if (!data) return NULL;
+            if (!read_bytes(fs, chunk_offset(fs, chunk), data, size)) {
+                free(data);
+                return NULL;
+            }
+            cache->loads++;
+        }
+        chunk_loaded(cache, chunk, data);
+    }
+    return cache->chunks[chunk] + (inode_id % INODES_PER_CLUSTER) * inode_disk_size(fs);
+}
+
+bool inode_cache_init(filesystem_t *fs, bool fresh) {
+    inode_cache_free(fs);
+
+    //u mmap slouží jako cache samotné mapování
+    if (fs->map) return true;
+
+    inode_cache_t *cache = calloc(1, sizeof(inode_cache_t));
+    if (!cache) return false;
+
+    cache->chunk_count = (fs->sb.inode_count + INODES_PER_CLUSTER - 1) / INODES_PER_CLUSTER;
+    cache->chunks = calloc(cache->chunk_count + 1, sizeof(uint8_t *));
+    cache->dirty = calloc(cache->chunk_count + 1, 1);
+    cache->order = calloc(cache->chunk_count + 1, sizeof(int32_t));
+    if (fresh) cache->stored = calloc(cache->chunk_count + 1, 1);
+    if (!cache->chunks || !cache->dirty || !cache->order || (fresh && !cache->stored)) {
+        free(cache->chunks);
+        free(cache->dirty);
+        free(cache->order);
+        free(cache->stored);
+        free(cache);
+        return false;
+    }
+
+    cache->fresh = fresh;
+    fs->inode_cache = cache;
+    return true;
+}
+
+void inode_cache_free(filesystem_t *fs) {
+    inode_cache_t *cache = fs->inode_cache;
+    if (!cache) return;
+
+    for (int32_t i = 0; i < cache->chunk_count; i++) {
+        free(cache->chunks[i]);
+    }
+    free(cache->chunks);
+    free(cache->dirty);
+    free(cache->order);
+    free(cache->stored);
+    free(cache);
+    fs->inode_cache = NULL;
+}
+
+static int compare_chunk(const void *a, const void *b) {
+    int32_t ca = *(const int32_t *)a, cb = *(const int32_t *)b;
+    return ca < cb ? -1 : ca > cb;
+}
+
+bool inode_cache_load(filesystem_t *fs, const int32_t *ids, int32_t count) {
+    inode_cache_t *cache = fs->inode_cache;
+    if (!cache || count <= 0) return true;
+
+    int32_t *chunks = malloc(count * sizeof(int32_t));
+    if (!chunks) return false;
+
+    fs_rwlock(fs, RWLOCK_INODE_TABLE, true);
+    //úseky, které je potřeba přečíst z disku, vzestupně a bez opakování
+    int32_t needed = 0;
+    for (int32_t i = 0; i < count; i++) {
+        if (ids[i] < 0 || ids[i] >= fs->sb.inode_count) continue;
+        int32_t chunk = ids[i] / INODES_PER_CLUSTER;
+        if (!cache->chunks[chunk] && !chunk_empty(cache, chunk)) chunks[needed++] = chunk;
+    }
+    qsort(chunks, needed, sizeof(int32_t), compare_chunk);
+    int32_t unique = 0;
+    for (int32_t i = 0; i < needed; i++) {
+        if (unique == 0 || chunks[unique - 1] != chunks[i]) chunks[unique++] = chunks[i];
+    }
+    //načtení nesmí vyřadit úseky, které samo načetlo
+    if (unique > INODE_CACHE_CHUNKS / 2) unique = INODE_CACHE_CHUNKS / 2;
+    evict_chunks(cache, unique);
+
+    bool ok = true;
+    for (int32_t i = 0; ok && i < unique; ) {
+        //sousední úseky jedním čtením
+        int32_t end = i + 1;
+        while (end < unique && chunks[end] == chunks[end - 1] + 1) end++;
+
+        size_t size = 0;
+        for (int32_t j = i; j < end; j++) size += chunk_inodes(fs, chunks[j]) * inode_disk_size(fs);
+        uint8_t *buffer = malloc(size);
+        ok = buffer && read_bytes(fs, chunk_offset(fs, chunks[i]), buffer, size);
+        if (ok) cache->loads++;
+
+        size_t pos = 0;
+        for (int32_t j = i; ok && j < end; j++) {
+            size_t chunk_size = chunk_inodes(fs, chunks[j]) * inode_disk_size(fs);
+            uint8_t *data = malloc(chunk_size);
+            if (!data) {
+                ok = false;
+                break;
+            }
+            memcpy(data, buffer + pos, chunk_size);
+            chunk_loaded(cache, chunks[j], data);
+            pos += chunk_size;
+        }
+        free(buffer);
+        i = end;
+    }
+
+    fs_rwunlock(fs, RWLOCK_INODE_TABLE);
+    free(chunks);
+    return ok;
+}
+
+// zápis změněných úseků, volající drží zámek tabulky
+static bool sync_chunks(filesystem_t *fs, inode_cache_t *cache) {
+    if (!cache->any_dirty) return true;
+
+    bool ok = true;
+    for (int32_t i = 0; i < cache->chunk_count; i++) {
+        if (!cache->dirty[i]) continue;
+
+        //sousední změněné úseky jedním zápisem
+        int32_t end = i;
+        size_t size = 0;
+        while (end < cache->chunk_count && cache->dirty[end]) {
+            size += chunk_inodes(fs, end) * inode_disk_size(fs);
+            end++;
+        }
+
+        uint8_t *buffer = malloc(size);
+        if (!buffer) return false;
+        size_t pos = 0;
+        for (int32_t j = i; j < end; j++) {
+            size_t chunk_size = chunk_inodes(fs, j) * inode_disk_size(fs);
+            memcpy(buffer + pos, cache->chunks[j], chunk_size);
+            pos += chunk_size;
+            cache->dirty[j] = 0;
+            if (cache->fresh) cache->stored[j] = 1;
+        }
+
+        if (!write_bytes(fs, chunk_offset(fs, i), buffer, size)) ok = false;
+        free(buffer);
+        i = end - 1;
+    }
+
+    cache->any_dirty = false;
+    return ok;
+}
+
+// zápis i-uzlu do cache, volající drží zámek tabulky
+static bool write_chunk_inode(filesystem_t *fs, int32_t inode_id, const uint8_t *raw) {
+    uint8_t *cached = get_chunk_inode(fs, inode_id);
+    if (!cached) return false;
+    memcpy(cached, raw, inode_disk_size(fs));
+
+    //původní chování - každá změna jde hned na disk
+    if (fs->sync_policy == SYNC_ALWAYS) {
+        int32_t chunk = inode_id / INODES_PER_CLUSTER;
+        if (!chunk_empty(fs->inode_cache, chunk)) {
+            return write_bytes(fs, inode_offset(fs, inode_id), raw, inode_disk_size(fs));
+        }
+        //zbytek úseku na disku ještě není platný - zapíše se celý
+        fs->inode_cache->stored[chunk] = 1;
+        return write_bytes(fs, chunk_offset(fs, chunk), fs->inode_cache->chunks[chunk],
+                           chunk_inodes(fs, chunk) * inode_disk_size(fs));
+    }
+    fs->inode_cache->dirty[inode_id / INODES_PER_CLUSTER] = 1;
+    fs->inode_cache->any_dirty = true;
+    return true;
+}
+
+bool inode_cache_sync(filesystem_t *fs) {
+    inode_cache_t *cache = fs->inode_cache;
+    if (!cache) return true;
+
+    fs_rwlock(fs, RWLOCK_INODE_TABLE, true);
+    bool ok = sync_chunks(fs, cache);
+    fs_rwunlock(fs, RWLOCK_INODE_TABLE);
+    return ok;
+}
+
+
+size_t inode_cache_dirty_bytes(filesystem_t *fs) {
+    inode_cache_t *cache = fs->inode_cache;
+    if (!cache) return 0;
+
+    size_t size = 0;
+    fs_rwlock(fs, RWLOCK_INODE_TABLE, false);
+    for (int32_t i = 0; cache->any_dirty && i < cache->chunk_count; i++) {
+        if (cache->dirty[i]) size += chunk_inodes(fs, i) * inode_disk_size(fs);
+    }
+    fs_rwunlock(fs, RWLOCK_INODE_TABLE);
+    return size;
+}
+
 bool read_inode(filesystem_t *fs, int32_t inode_id, inode_t *inode) {
     if (inode_id < 0 || inode_id >= fs->sb.inode_count) return false;
     
-    int32_t offset = fs->sb.inode_start + inode_id * sizeof(inode_t);
-    return read_bytes(fs, offset, inode, sizeof(inode_t));
+    if (fs->inode_cache) {
+        //načtený úsek se čte sdíleně, načtení úseku z disku mění cache
+        fs_rwlock(fs, RWLOCK_INODE_TABLE, false);
+        int32_t chunk = inode_id / INODES_PER_CLUSTER;
+        uint8_t *raw = NULL;
+        if (fs->inode_cache->chunks[chunk]) {
+            raw = get_chunk_inode(fs, inode_id);
+        } else {
+            fs_rwunlock(fs, RWLOCK_INODE_TABLE);
+            fs_rwlock(fs, RWLOCK_INODE_TABLE, true);
+            raw = get_chunk_inode(fs, inode_id);
+        }
+        if (raw) decode_inode(fs, raw, inode);
+        fs_rwunlock(fs, RWLOCK_INODE_TABLE);
+        return raw != NULL;
+    }
+
+    uint8_t raw[sizeof(inode_t)];
+    if (!read_bytes(fs, inode_offset(fs, inode_id), raw, inode_disk_size(fs))) return false;
+    decode_inode(fs, raw, inode);
+    return true;
 }
 
 bool write_inode(filesystem_t *fs, int32_t inode_id, const inode_t *inode) {
     if (inode_id < 0 || inode_id >= fs->sb.inode_count) return false;
     
-    int32_t offset = fs->sb.inode_start + inode_id * sizeof(inode_t);
-    return write_bytes(fs, offset, inode, sizeof(inode_t));
+    uint8_t raw[sizeof(inode_t)];
+    encode_inode(fs, inode, raw);
+
+    if (fs->inode_cache) {
+        fs_rwlock(fs, RWLOCK_INODE_TABLE, true);
+        bool ok = write_chunk_inode(fs, inode_id, raw);
+        fs_rwunlock(fs, RWLOCK_INODE_TABLE);
+        return ok;
+    }
+
+    return write_bytes(fs, inode_offset(fs, inode_id), raw, inode_disk_size(fs));
+}
+
+
+int64_t max_file_size(filesystem_t *fs) {
+    return fs->sb.version == FS_VERSION_32 ? INT32_MAX : INT64_MAX;
 }
 
 int32_t alloc_inode(filesystem_t *fs) {
-    for (int32_t i = 0; i < fs->sb.inode_count; i++) {
-        if (!is_bit_set(fs->inode_bitmap, i)) {
-            set_bit(fs->inode_bitmap, i);
-            save_bitmaps(fs);
-            return i;
-        }
+    fs_lock(fs, LOCK_ALLOC);
+    int32_t inode_id = bitmap_find_free(fs->inode_bitmap, fs->sb.inode_cursor);
+    if (inode_id >= 0) {
+        set_bit(fs->inode_bitmap, inode_id);
+        fs->sb.inode_cursor = inode_id + 1;
+        fs->sb_dirty = true;
+        bitmaps_changed(fs);
     }
-    return -1;
-}
\ No newline at end of file
+    fs_unlock(fs, LOCK_ALLOC);
+    return inode_id;
+}
+
+void free_inode(filesystem_t *fs, int32_t inode_id) {
+    fs_lock(fs, LOCK_ALLOC);
+    clear_bit(fs->inode_bitmap, inode_id);
+    bitmaps_changed(fs);
+    fs_unlock(fs, LOCK_ALLOC);
+}
+
+bool inode_in_use(filesystem_t *fs, int32_t inode_id) {
+    if (inode_id < 0 || inode_id >= fs->sb.inode_count) return false;
+    fs_lock(fs, LOCK_ALLOC);
+    bool used = is_bit_set(fs->inode_bitmap, inode_id);
+    fs_unlock(fs, LOCK_ALLOC);
+    return used;
+}
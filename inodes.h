@@ -2,6 +2,25 @@
 #include "structs.h"
 #include <stdbool.h>
 
+// nejvýš tolik načtených úseků tabulky inodů (8 MB), čisté úseky se vyřazují v pořadí načtení
+#define INODE_CACHE_CHUNKS 2048
+
+// vytvoří prázdnou cache tabulky inodů (úseky se načítají při prvním přístupu),
+// fresh - tabulka byla právě naformátována a z disku se nečte
+bool inode_cache_init(filesystem_t *fs, bool fresh);
+
+// uvolní cache tabulky inodů bez uložení změn
+void inode_cache_free(filesystem_t *fs);
+
+// načte úseky tabulky s danými inody (sousední úseky jedním čtením), už načtené se nečtou
+bool inode_cache_load(filesystem_t *fs, const int32_t *ids, int32_t count);
+
+// zapíše změněné úseky tabulky inodů na disk
+bool inode_cache_sync(filesystem_t *fs);
+
+// počet bytů změněných úseků tabulky inodů
+size_t inode_cache_dirty_bytes(filesystem_t *fs);
+
 // přečtení obsahu i-uzlu
 bool read_inode(filesystem_t *fs, int32_t inode_id, inode_t *inode);
 
@@ -9,4 +28,13 @@ bool read_inode(filesystem_t *fs, int32_t inode_id, inode_t *inode);
 bool write_inode(filesystem_t *fs, int32_t inode_id, const inode_t *inode);
 
 //alokuje inode - najde první volný v bitmapě, označí ho jako obsazený a vrátí jeho číslo
-int32_t alloc_inode(filesystem_t *fs);
\ No newline at end of file
+int32_t alloc_inode(filesystem_t *fs);
+
+//uvolní inode v bitmapě (clustery souboru uvolňuje free_file_clusters)
+void free_inode(filesystem_t *fs, int32_t inode_id);
+
+//inode je obsazený - po zamčení ověří, že ho mezitím jiné vlákno nesmazalo
+bool inode_in_use(filesystem_t *fs, int32_t inode_id);
+
+// největší velikost souboru, kterou umí uložit i-uzel daného formátu
+int64_t max_file_size(filesystem_t *fs);
@@ -0,0 +1,758 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include "structs.h"
+#include "journal.h"
+#include "filesystem.h"
+#include "trace.h"
+#include "locks.h"
+#include "bitmap.h"
+
+
+// log začíná za hlavičkou oblasti (jeden sektor)
+#define LOG_START 512
+
+// rozsah velikosti oblasti žurnálu
+#define JOURNAL_MIN_SIZE (256 * 1024)
+#define JOURNAL_MAX_SIZE (32 * 1024 * 1024)
+
+
+int64_t journal_region_size(int32_t cluster_count) {
+    //1/256 velikosti dat, zaokrouhleno na celé clustery
+    int64_t size = (int64_t)cluster_count * CLUSTER_SIZE / 256;
+    if (size < JOURNAL_MIN_SIZE) size = JOURNAL_MIN_SIZE;
+    if (size > JOURNAL_MAX_SIZE) size = JOURNAL_MAX_SIZE;
+    return (size + CLUSTER_SIZE - 1) / CLUSTER_SIZE * CLUSTER_SIZE;
+}
+
+static size_t padded(size_t size) {
+    return (size + 7) & ~(size_t)7;
+}
+
+// přímé přenosy mimo read_vec/write_vec, které by zápis znovu zachytily
+static bool raw_write(filesystem_t *fs, int64_t offset, const void *buffer, size_t size) {
+    int fd = fileno(fs->file);
+    const uint8_t *data = buffer;
+    while (size > 0) {
+        ssize_t done = pwrite(fd, data, size, offset);
+        if (done < 0 && errno == EINTR) continue;
+        if (done <= 0) return false;
+        count_io(fs, true, done);
+        data += done;
+        offset += done;
+        size -= done;
+    }
+    return true;
+}
+
+static bool raw_read(filesystem_t *fs, int64_t offset, void *buffer, size_t size) {
+    int fd = fileno(fs->file);
+    uint8_t *data = buffer;
+    while (size > 0) {
+        ssize_t done = pread(fd, data, size, offset);
+        if (done < 0 && errno == EINTR) continue;
+        if (done <= 0) return false;
+        count_io(fs, false, done);
+        data += done;
+        offset += done;
+        size -= done;
+    }
+    return true;
+}
+
+static bool sync_image(filesystem_t *fs) {
+    journal_t *journal = fs->journal;
+    if (!journal) return fdatasync(fileno(fs->file)) == 0;
+    //všechny transakce s nižším pořadím jsou už zapsané v logu, odložené ještě ne
+    uint64_t seq = journal->deferred_count > 0 ? journal->deferred[0].seq : journal->seq;
+    //data dopsaná po vynulování příznaku se projeví v dalším fdatasync
+    atomic_store(&journal->data_unsynced, false);
+    journal->syncs++;
+    if (fdatasync(fileno(fs->file)) != 0) {
+        atomic_store(&journal->data_unsynced, true);
+        return false;
+    }
+    journal->durable = seq;
+    return true;
+}
+
+// FNV-1a, pokračuje od hodnoty hash
+static uint64_t checksum(uint64_t hash, const void *data, size_t size) {
+    const uint8_t *bytes = data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+#define CHECKSUM_INIT 0xcbf29ce484222325ULL
+
+static bool write_super(filesystem_t *fs, uint64_t start_seq) {
+    journal_super_t jsb = { JOURNAL_MAGIC, 0, start_seq };
+    return raw_write(fs, fs->journal->start, &jsb, sizeof(jsb));
+}
+
+static journal_t *journal_create(filesystem_t *fs) {
+    journal_t *journal = calloc(1, sizeof(journal_t));
+    if (!journal) return NULL;
+    journal->size = journal_region_size(fs->sb.cluster_count);
+    journal->start = fs->sb.data_start - journal->size;
+    journal->head = LOG_START;
+    journal->seq = 1;
+    return journal;
+}
+
+static void journal_free(filesystem_t *fs) {
+    if (!fs->journal) return;
+    free(fs->journal->records);
+    free(fs->journal->index);
+    free(fs->journal->index_buckets);
+    free(fs->journal->deferred);
+    free(fs->journal->logged);
+    free(fs->journal->freed);
+    free(fs->journal);
+    fs->journal = NULL;
+}
+
+// zvětší pole záznamů, aby se vešlo dalších extra bytů
+static bool reserve(journal_t *journal, size_t extra) {
+    if (journal->length + extra <= journal->capacity) return true;
+    size_t capacity = journal->capacity ? journal->capacity : 64 * 1024;
+    while (capacity < journal->length + extra) capacity *= 2;
+    uint8_t *records = realloc(journal->records, capacity);
+    if (!records) return false;
+    journal->records = records;
+    journal->capacity = capacity;
+    return true;
+}
+
+static int32_t hash_block(int64_t block, int32_t mask) {
+    return ((uint32_t)block * 2654435761u) & mask;
+}
+
+// zvětší hashovací tabulku indexu záznamů, aby průměrná délka řetězce nepřesáhla 1
+static bool grow_index_buckets(journal_t *journal, int32_t needed) {
+    int32_t size = journal->index_buckets ? (journal->index_bucket_mask + 1) * 2 : 1024;
+    while (size < needed) size *= 2;
+    int32_t *buckets = malloc(size * sizeof(int32_t));
+    if (!buckets) return false;
+
+    memset(buckets, 0xff, size * sizeof(int32_t));
+    free(journal->index_buckets);
+    journal->index_buckets = buckets;
+    journal->index_bucket_mask = size - 1;
+    for (int32_t i = 0; i < journal->index_count; i++) {
+        int32_t bucket = hash_block(journal->index[i].block, journal->index_bucket_mask);
+        journal->index[i].next = buckets[bucket];
+        buckets[bucket] = i;
+    }
+    return true;
+}
+
+// zařadí záznam na pozici pos pod všechny bloky obrazu, které překrývá
+static bool index_record(journal_t *journal, size_t pos) {
+    journal_record_t record;
+    memcpy(&record, journal->records + pos, sizeof(record));
+    if (record.length == 0) return true;
+    int64_t first = record.offset / CLUSTER_SIZE;
+    int64_t last = (record.offset + (int64_t)record.length - 1) / CLUSTER_SIZE;
+
+    int32_t needed = journal->index_count + (int32_t)(last - first + 1);
+    if (needed > journal->index_capacity) {
+        int32_t capacity = journal->index_capacity ? journal->index_capacity : 1024;
+        while (capacity < needed) capacity *= 2;
+        journal_index_entry_t *index = realloc(journal->index, capacity * sizeof(journal_index_entry_t));
+        if (!index) return false;
+        journal->index = index;
+        journal->index_capacity = capacity;
+    }
+    if (!journal->index_buckets || needed > journal->index_bucket_mask + 1) {
+        if (!grow_index_buckets(journal, needed)) return false;
+    }
+
+    for (int64_t block = first; block <= last; block++) {
+        int32_t bucket = hash_block(block, journal->index_bucket_mask);
+        journal->index[journal->index_count] = (journal_index_entry_t){ block, pos, journal->index_buckets[bucket] };
+        journal->index_buckets[bucket] = journal->index_count++;
+    }
+    return true;
+}
+
+// po posunutí záznamů v poli records se index sestaví znovu, místo už má
+static void rebuild_index(journal_t *journal) {
+    journal->index_count = 0;
+    if (journal->index_buckets) {
+        memset(journal->index_buckets, 0xff, (journal->index_bucket_mask + 1) * sizeof(int32_t));
+    }
+    size_t pos = 0;
+    while (pos < journal->length) {
+        journal_record_t record;
+        memcpy(&record, journal->records + pos, sizeof(record));
+        index_record(journal, pos);
+        pos += sizeof(record) + padded(record.length);
+    }
+}
+
+static bool logged_contains(const journal_t *journal, int32_t cluster) {
+    if (journal->logged_count == 0) return false;
+    for (int32_t i = hash_block(cluster, journal->logged_mask); ; i = (i + 1) & journal->logged_mask) {
+        if (journal->logged[i] == cluster) return true;
+        if (journal->logged[i] < 0) return false;
+    }
+}
+
+static bool logged_add(journal_t *journal, int32_t cluster) {
+    //množina je zaplněná nejvýš do poloviny
+    if (!journal->logged || (journal->logged_count + 1) * 2 > journal->logged_mask + 1) {
+        int32_t size = journal->logged ? (journal->logged_mask + 1) * 2 : 64;
+        int32_t *logged = malloc(size * sizeof(int32_t));
+        if (!logged) return false;
+        memset(logged, 0xff, size * sizeof(int32_t));
+        int32_t *old = journal->logged;
+        int32_t old_size = old ? journal->logged_mask + 1 : 0;
+        journal->logged = logged;
+        journal->logged_mask = size - 1;
+        journal->logged_count = 0;
+        for (int32_t i = 0; i < old_size; i++) {
+            if (old[i] >= 0) logged_add(journal, old[i]);
+        }
+        free(old);
+    }
+
+    int32_t i = hash_block(cluster, journal->logged_mask);
+    while (journal->logged[i] >= 0) {
+        if (journal->logged[i] == cluster) return true;
+        i = (i + 1) & journal->logged_mask;
+    }
+    journal->logged[i] = cluster;
+    journal->logged_count++;
+    return true;
+}
+
+static void logged_clear(journal_t *journal) {
+    if (journal->logged) memset(journal->logged, 0xff, (journal->logged_mask + 1) * sizeof(int32_t));
+    journal->logged_count = 0;
+}
+
+// zapíše záznamy z bufferu na jejich místo v obrazu
+static bool apply_records(filesystem_t *fs, const uint8_t *records, size_t length) {
+    size_t pos = 0;
+    while (pos + sizeof(journal_record_t) <= length) {
+        journal_record_t record;
+        memcpy(&record, records + pos, sizeof(record));
+        pos += sizeof(record);
+        if (record.length > length - pos) return false;
+        if (!raw_write(fs, record.offset, records + pos, record.length)) return false;
+        pos += padded(record.length);
+    }
+    return true;
+}
+
+static size_t iov_total(const struct iovec *iov, int count) {
+    size_t total = 0;
+    for (int i = 0; i < count; i++) total += iov[i].iov_len;
+    return total;
+}
+
+
+bool journal_active(filesystem_t *fs) {
+    //u mmap a SYNC_ALWAYS jde každý zápis hned na místo
+    return fs->journal && fs->engine == IO_ENGINE_STDIO && fs->sync_policy != SYNC_ALWAYS;
+}
+
+bool journal_format(filesystem_t *fs) {
+    fs_rwlock(fs, RWLOCK_JOURNAL, true);
+    //záznamy předchozího FS se zahodí, superblok se bez žurnálu zapíše přímo na místo
+    journal_free(fs);
+    bool ok = save_superblock(fs);
+    if (ok && fs->sb.version == FS_VERSION_64 && (fs->sb.features & FS_FEATURE_JOURNAL)) {
+        fs->journal = journal_create(fs);
+        ok = fs->journal && write_super(fs, fs->journal->seq);
+    }
+    //mount hledá log podle superbloku na disku - oba musí být trvalé dřív než první transakce
+    ok = ok && sync_image(fs);
+    fs_rwunlock(fs, RWLOCK_JOURNAL);
+    return ok;
+}
+
+// přehraje log připojeného žurnálu, -1 při chybě
+static int32_t replay_log(filesystem_t *fs) {
+    journal_t *journal = fs->journal;
+
+    journal_super_t jsb;
+    if (!raw_read(fs, journal->start, &jsb, sizeof(jsb))) return -1;
+    if (jsb.magic != JOURNAL_MAGIC) {
+        //poškozená hlavička - log nelze bezpečně přehrát
+        TRACE(TRACE_IO, TRACE_ERROR, "journal: bad header magic %08x", jsb.magic);
+        if (!write_super(fs, journal->seq)) return -1;
+        return 0;
+    }
+
+    //přehrají se navazující transakce s platným kontrolním součtem, první neplatná je konec logu
+    uint64_t seq = jsb.start_seq;
+    int64_t pos = LOG_START;
+    int32_t replayed = 0;
+    uint8_t *payload = NULL;
+    while (pos + (int64_t)sizeof(journal_txn_t) <= journal->size) {
+        journal_txn_t txn;
+        if (!raw_read(fs, journal->start + pos, &txn, sizeof(txn))) break;
+        if (txn.magic != JOURNAL_TXN_MAGIC || txn.seq != seq) break;
+        if (txn.length > (uint64_t)(journal->size - pos - sizeof(txn))) break;
+
+        uint8_t *buffer = realloc(payload, txn.length ? txn.length : 1);
+        if (!buffer) break;
+        payload = buffer;
+        if (!raw_read(fs, journal->start + pos + sizeof(txn), payload, txn.length)) break;
+
+        uint64_t expected = txn.checksum;
+        txn.checksum = 0;
+        uint64_t hash = checksum(checksum(CHECKSUM_INIT, &txn, sizeof(txn)), payload, txn.length);
+        if (hash != expected) break;
+
+        if (!apply_records(fs, payload, txn.length)) {
+            free(payload);
+            return -1;
+        }
+        TRACE(TRACE_IO, TRACE_INFO, "journal: replayed txn %llu (%u records)",
+              (unsigned long long)seq, txn.record_count);
+        pos += sizeof(txn) + txn.length;
+        seq++;
+        replayed++;
+    }
+    free(payload);
+
+    journal->seq = seq;
+    if (replayed > 0) {
+        //přehrané změny musí být trvalé dřív, než se log vyprázdní
+        if (!sync_image(fs) || !write_super(fs, seq) || !sync_image(fs)) return -1;
+    }
+    return replayed;
+}
+
+int32_t journal_open(filesystem_t *fs) {
+    journal_free(fs);
+    if (fs->sb.version != FS_VERSION_64 || !(fs->sb.features & FS_FEATURE_JOURNAL)) return 0;
+
+    fs->journal = journal_create(fs);
+    if (!fs->journal) return -1;
+    int32_t replayed = replay_log(fs);
+    //s nepřehraným logem by fs nebyl konzistentní - žurnál se nepoužije a mount selže
+    if (replayed < 0) journal_free(fs);
+    return replayed;
+}
+
+static bool commit_locked(filesystem_t *fs);
+static bool checkpoint_locked(filesystem_t *fs);
+
+void journal_close(filesystem_t *fs) {
+    if (!fs->journal) return;
+    fs_rwlock(fs, RWLOCK_JOURNAL, true);
+    if (journal_active(fs)) {
+        commit_locked(fs);
+        checkpoint_locked(fs);
+        //vše je na místě, log se vyprázdní
+        if (sync_image(fs)) write_super(fs, fs->journal->seq);
+    }
+    journal_free(fs);
+    fs_rwunlock(fs, RWLOCK_JOURNAL);
+}
+
+bool journal_capture(filesystem_t *fs, int64_t offset, const struct iovec *iov, int count) {
+    journal_t *journal = fs->journal;
+    size_t total = iov_total(iov, count);
+    fs_rwlock(fs, RWLOCK_JOURNAL, true);
+    if (!reserve(journal, sizeof(journal_record_t) + padded(total))) {
+        fs_rwunlock(fs, RWLOCK_JOURNAL);
+        return false;
+    }
+
+    journal_record_t record = { offset, total, 0 };
+    size_t record_pos = journal->length;
+    uint8_t *data = journal->records + journal->length;
+    memcpy(data, &record, sizeof(record));
+    data += sizeof(record);
+    for (int i = 0; i < count; i++) {
+        memcpy(data, iov[i].iov_base, iov[i].iov_len);
+        data += iov[i].iov_len;
+    }
+    memset(data, 0, padded(total) - total);
+    if (!index_record(journal, record_pos)) {
+        fs_rwunlock(fs, RWLOCK_JOURNAL);
+        return false;
+    }
+
+    journal->length += sizeof(record) + padded(total);
+    journal->pending_count++;
+    fs_rwunlock(fs, RWLOCK_JOURNAL);
+    return true;
+}
+
+// záznam na pozici pos překrývá oblast offset..offset+size - pozice překryvu v oblasti,
+// jeho data v záznamu a délka
+static bool record_overlap(journal_t *journal, size_t pos, int64_t offset, size_t size,
+                           size_t *at, uint8_t **data, size_t *len) {
+    journal_record_t record;
+    memcpy(&record, journal->records + pos, sizeof(record));
+
+    int64_t low = record.offset > offset ? record.offset : offset;
+    int64_t high = record.offset + (int64_t)record.length;
+    if (offset + (int64_t)size < high) high = offset + size;
+    if (low >= high) return false;
+
+    *at = low - offset;
+    *data = journal->records + pos + sizeof(record) + (low - record.offset);
+    *len = high - low;
+    return true;
+}
+
+// pozice záznamů překrývajících oblast, seřazené vzestupně - novější záznam přepíše starší
+typedef struct {
+    size_t *pos;
+    int32_t count;
+    int32_t capacity;
+    size_t local[32];
+} overlap_list_t;
+
+static int compare_pos(const void *a, const void *b) {
+    size_t pa = *(const size_t *)a, pb = *(const size_t *)b;
+    return pa < pb ? -1 : pa > pb;
+}
+
+// najde záznamy od pozice from, které překrývají oblast; first_only = stačí jeden
+static bool find_overlaps(journal_t *journal, size_t from, int64_t offset, size_t size,
+                          overlap_list_t *list, bool first_only) {
+    list->pos = list->local;
+    list->count = 0;
+    list->capacity = sizeof(list->local) / sizeof(list->local[0]);
+    if (size == 0 || journal->index_count == 0) return true;
+
+    int64_t first = offset / CLUSTER_SIZE;
+    int64_t last = (offset + (int64_t)size - 1) / CLUSTER_SIZE;
+    for (int64_t block = first; block <= last; block++) {
+        int32_t i = journal->index_buckets[hash_block(block, journal->index_bucket_mask)];
+        for (; i >= 0; i = journal->index[i].next) {
+            const journal_index_entry_t *entry = &journal->index[i];
+            if (entry->block != block || entry->pos < from) continue;
+
+            //záznam přes více bloků se bere jen u prvního společného bloku
+            journal_record_t record;
+            memcpy(&record, journal->records + entry->pos, sizeof(record));
+            int64_t record_first = record.offset / CLUSTER_SIZE;
+            if (block != (record_first > first ? record_first : first)) continue;
+
+            size_t at, len;
+            uint8_t *data;
+            if (!record_overlap(journal, entry->pos, offset, size, &at, &data, &len)) continue;
+
+            if (list->count == list->capacity) {
+                size_t *grown = malloc(list->capacity * 2 * sizeof(size_t));
+                if (!grown) return false;
+                memcpy(grown, list->pos, list->count * sizeof(size_t));
+                if (list->pos != list->local) free(list->pos);
+                list->pos = grown;
+                list->capacity *= 2;
+            }
+            list->pos[list->count++] = entry->pos;
+            if (first_only) return true;
+        }
+    }
+    if (list->count > 1) qsort(list->pos, list->count, sizeof(size_t), compare_pos);
+    return true;
+}
+
+static void overlap_list_free(overlap_list_t *list) {
+    if (list->pos != list->local) free(list->pos);
+}
+
+// kopírování mezi souvislým bufferem a pozicí pos ve vektoru bufferů
+static void iov_copy(const struct iovec *iov, int count, size_t pos, uint8_t *data, size_t len, bool to_iov) {
+    for (int i = 0; i < count && len > 0; i++) {
+        if (pos >= iov[i].iov_len) {
+            pos -= iov[i].iov_len;
+            continue;
+        }
+        size_t part = iov[i].iov_len - pos;
+        if (part > len) part = len;
+        if (to_iov) memcpy((uint8_t *)iov[i].iov_base + pos, data, part);
+        else memcpy(data, (uint8_t *)iov[i].iov_base + pos, part);
+        data += part;
+        len -= part;
+        pos = 0;
+    }
+}
+
+// překopíruje překryvy záznamů od pozice from do iov (to_iov) nebo naopak z iov do záznamů
+static bool copy_overlaps(journal_t *journal, size_t from, int64_t offset, const struct iovec *iov, int count, bool to_iov) {
+    size_t total = iov_total(iov, count), at, len;
+    uint8_t *data;
+    overlap_list_t list;
+    bool ok = find_overlaps(journal, from, offset, total, &list, false);
+    for (int32_t i = 0; ok && i < list.count; i++) {
+        if (record_overlap(journal, list.pos[i], offset, total, &at, &data, &len)) {
+            iov_copy(iov, count, at, data, len, to_iov);
+        }
+    }
+    overlap_list_free(&list);
+    return ok;
+}
+
+void journal_overlay(filesystem_t *fs, int64_t offset, const struct iovec *iov, int count) {
+    journal_t *journal = fs->journal;
+    if (!journal || journal->length == 0) return;
+
+    //novější záznamy jsou dál, přepíší starší
+    copy_overlaps(journal, 0, offset, iov, count, true);
+}
+
+bool journal_covers(filesystem_t *fs, int64_t offset, size_t size) {
+    journal_t *journal = fs->journal;
+    if (!journal) return false;
+
+    fs_rwlock(fs, RWLOCK_JOURNAL, false);
+    bool covered = false;
+    if (journal->length > 0) {
+        //bez paměti na seznam se oblast bere jako pokrytá - čte se pak přes cache a žurnál
+        overlap_list_t list;
+        covered = !find_overlaps(journal, 0, offset, size, &list, true) || list.count > 0;
+        overlap_list_free(&list);
+    }
+    fs_rwunlock(fs, RWLOCK_JOURNAL);
+    return covered;
+}
+
+// přenese vše zapsané na místo a začne log od začátku
+static bool journal_reset(filesystem_t *fs) {
+    journal_t *journal = fs->journal;
+    if (!checkpoint_locked(fs)) return false;
+    //přenesené změny musí být trvalé dřív, než log zmizí
+    if (!sync_image(fs) || !write_super(fs, journal->seq)) return false;
+    journal->head = LOG_START;
+    logged_clear(journal);
+    return true;
+}
+
+// journal_data_write, volající drží zámek žurnálu výhradně
+static bool data_write_locked(filesystem_t *fs, int64_t offset, const struct iovec *iov, int count) {
+    journal_t *journal = fs->journal;
+    size_t total = iov_total(iov, count);
+    if (total == 0 || offset < fs->sb.data_start) return true;
+
+    //cluster zapsaný v logu by při přehrání přepsal nová data - log se nejdřív vyprázdní
+    int32_t first = (offset - fs->sb.data_start) / fs->sb.cluster_size;
+    int32_t last = (offset + total - 1 - fs->sb.data_start) / fs->sb.cluster_size;
+    for (int32_t cluster = first; journal->logged_count > 0 && cluster <= last; cluster++) {
+        if (logged_contains(journal, cluster)) {
+            TRACE(TRACE_IO, TRACE_DEBUG, "journal: data write over logged cluster %d, resetting log", cluster);
+            if (!journal_reset(fs)) return false;
+            break;
+        }
+    }
+
+    //rozpracovaná transakce nesmí při commitu vrátit starší obsah
+    return copy_overlaps(journal, journal->pending_start, offset, iov, count, false);
+}
+
+void journal_data_written(filesystem_t *fs) {
+    if (fs->journal) atomic_store(&fs->journal->data_unsynced, true);
+}
+
+bool journal_data_write(filesystem_t *fs, int64_t offset, const struct iovec *iov, int count) {
+    fs_rwlock(fs, RWLOCK_JOURNAL, true);
+    bool ok = data_write_locked(fs, offset, iov, count);
+    fs_rwunlock(fs, RWLOCK_JOURNAL);
+    return ok;
+}
+
+// zapamatuje si clustery dat, které jsou v logu
+static bool log_clusters(filesystem_t *fs, int64_t offset, size_t size) {
+    journal_t *journal = fs->journal;
+    if (offset + (int64_t)size <= fs->sb.data_start) return true;
+    if (offset < fs->sb.data_start) {
+        size -= fs->sb.data_start - offset;
+        offset = fs->sb.data_start;
+    }
+
+    int32_t first = (offset - fs->sb.data_start) / fs->sb.cluster_size;
+    int32_t last = (offset + size - 1 - fs->sb.data_start) / fs->sb.cluster_size;
+    for (int32_t cluster = first; cluster <= last; cluster++) {
+        if (!logged_add(journal, cluster)) return false;
+    }
+    return true;
+}
+
+bool journal_fits(filesystem_t *fs, size_t size) {
+    if (!journal_active(fs)) return true;
+    fs_rwlock(fs, RWLOCK_JOURNAL, false);
+    //polovina logu je rezerva na hlavičky záznamů a zápisy dalšího příkazu
+    journal_t *journal = fs->journal;
+    bool fits = (int64_t)(journal->length - journal->pending_start + size) <= (journal->size - LOG_START) / 2;
+    fs_rwunlock(fs, RWLOCK_JOURNAL);
+    return fits;
+}
+
+// zapíše transakci do logu na pozici head
+static bool write_txn(filesystem_t *fs, int64_t head, uint64_t seq, int32_t count, const uint8_t *payload, size_t length) {
+    journal_t *journal = fs->journal;
+    journal_txn_t txn = { JOURNAL_TXN_MAGIC, count, seq, length, 0 };
+    txn.checksum = checksum(checksum(CHECKSUM_INIT, &txn, sizeof(txn)), payload, length);
+    if (!raw_write(fs, journal->start + head, &txn, sizeof(txn)) ||
+        !raw_write(fs, journal->start + head + sizeof(txn), payload, length)) {
+        return false;
+    }
+    TRACE(TRACE_IO, TRACE_DEBUG, "journal: txn %llu, %d records, %zu bytes", (unsigned long long)seq, count, length);
+    return true;
+}
+
+// transakce se zapíše do logu až po fdatasync dat (checkpoint), místo v logu se jí vyhradí hned
+static bool defer_txn(journal_t *journal, size_t length) {
+    if (journal->deferred_count == journal->deferred_capacity) {
+        int32_t capacity = journal->deferred_capacity ? journal->deferred_capacity * 2 : 16;
+        journal_deferred_t *deferred = realloc(journal->deferred, capacity * sizeof(journal_deferred_t));
+        if (!deferred) return false;
+        journal->deferred = deferred;
+        journal->deferred_capacity = capacity;
+    }
+    journal->deferred[journal->deferred_count++] = (journal_deferred_t){
+        journal->pending_start, length, journal->pending_count, journal->seq, journal->head
+    };
+    return true;
+}
+
+static bool commit_locked(filesystem_t *fs) {
+    journal_t *journal = fs->journal;
+    if (!journal || journal->pending_count == 0) return true;
+
+    uint8_t *payload = journal->records + journal->pending_start;
+    size_t length = journal->length - journal->pending_start;
+    int64_t txn_size = sizeof(journal_txn_t) + length;
+
+    if (txn_size > journal->size - LOG_START) {
+        //transakce se do logu nevejde - zapíše se přímo, bez atomicity
+        TRACE(TRACE_IO, TRACE_ERROR, "journal: transaction of %zu bytes exceeds log, writing in place", length);
+        journal->oversized++;
+        if (!journal_reset(fs)) return false;
+        bool ok = apply_records(fs, journal->records, journal->length) && sync_image(fs);
+        journal->length = 0;
+        journal->pending_start = 0;
+        journal->pending_count = 0;
+        rebuild_index(journal);
+        return ok;
+    }
+
+    if (journal->head + txn_size > journal->size) {
+        if (!journal_reset(fs)) return false;
+        payload = journal->records + journal->pending_start;
+    }
+
+    //záznam v logu nesmí být trvalý dřív než data souborů, na která odkazuje - dokud data
+    //nejsou po fdatasync, transakce (i všechny další kvůli pořadí) čeká na checkpoint
+    if (atomic_load(&journal->data_unsynced) || journal->deferred_count > 0) {
+        if (!defer_txn(journal, length)) return false;
+    } else if (!write_txn(fs, journal->head, journal->seq, journal->pending_count, payload, length)) {
+        return false;
+    }
+
+    size_t pos = 0;
+    while (pos < length) {
+        journal_record_t record;
+        memcpy(&record, payload + pos, sizeof(record));
+        if (!log_clusters(fs, record.offset, record.length)) return false;
+        pos += sizeof(record) + padded(record.length);
+    }
+
+    journal->head += txn_size;
+    journal->seq++;
+    journal->pending_start = journal->length;
+    journal->pending_count = 0;
+    journal->group++;
+    journal->commits++;
+
+    if (journal->group >= fs->journal_group) return checkpoint_locked(fs);
+    return true;
+}
+
+bool journal_commit(filesystem_t *fs) {
+    fs_rwlock(fs, RWLOCK_JOURNAL, true);
+    bool ok = commit_locked(fs);
+    fs_rwunlock(fs, RWLOCK_JOURNAL);
+    return ok;
+}
+
+static bool checkpoint_locked(filesystem_t *fs) {
+    journal_t *journal = fs->journal;
+    if (!journal || (journal->group == 0 && journal->pending_start == 0)) return true;
+
+    if (journal->deferred_count > 0) {
+        //napřed trvalá data souborů, teprve potom záznamy, které na ně odkazují
+        if (!sync_image(fs)) return false;
+        for (int32_t i = 0; i < journal->deferred_count; i++) {
+            journal_deferred_t *txn = &journal->deferred[i];
+            if (!write_txn(fs, txn->head, txn->seq, txn->count, journal->records + txn->start, txn->length)) return false;
+        }
+        journal->deferred_count = 0;
+    }
+
+    //transakce v logu jsou trvalé, teprve potom se smí přepsat původní místa
+    if (journal->group > 0 && !sync_image(fs)) return false;
+    if (!apply_records(fs, journal->records, journal->pending_start)) return false;
+
+    memmove(journal->records, journal->records + journal->pending_start, journal->length - journal->pending_start);
+    journal->length -= journal->pending_start;
+    journal->pending_start = 0;
+    journal->group = 0;
+    rebuild_index(journal);
+    return true;
+}
+
+bool journal_checkpoint(filesystem_t *fs) {
+    fs_rwlock(fs, RWLOCK_JOURNAL, true);
+    bool ok = checkpoint_locked(fs);
+    fs_rwunlock(fs, RWLOCK_JOURNAL);
+    return ok;
+}
+
+bool journal_defer_free(filesystem_t *fs, int32_t cluster) {
+    if (!journal_active(fs)) return false;
+    journal_t *journal = fs->journal;
+    if (journal->freed_count == journal->freed_capacity) {
+        int32_t capacity = journal->freed_capacity ? journal->freed_capacity * 2 : 64;
+        journal_freed_t *freed = realloc(journal->freed, capacity * sizeof(journal_freed_t));
+        if (!freed) return false;
+        journal->freed = freed;
+        journal->freed_capacity = capacity;
+    }
+    //bitmapa zůstává beze změny, cluster jen přeskočí hledání volného místa
+    if (!bitmap_reserve(fs->data_bitmap, cluster)) return false;
+
+    //cluster patří do rozpracované transakce, ta dostane aktuální pořadí
+    fs_rwlock(fs, RWLOCK_JOURNAL, false);
+    journal->freed[journal->freed_count++] = (journal_freed_t){ cluster, journal->seq };
+    fs_rwunlock(fs, RWLOCK_JOURNAL);
+    return true;
+}
+
+int32_t journal_release_freed(filesystem_t *fs) {
+    journal_t *journal = fs->journal;
+    if (!journal || journal->freed_count == 0) return 0;
+
+    //záznamy jsou seřazené podle pořadí transakce, trvalé jsou na začátku
+    fs_rwlock(fs, RWLOCK_JOURNAL, false);
+    uint64_t durable = journal->durable;
+    fs_rwunlock(fs, RWLOCK_JOURNAL);
+    int32_t done = 0;
+    while (done < journal->freed_count && journal->freed[done].seq < durable) {
+        bitmap_unreserve(fs->data_bitmap, journal->freed[done].cluster);
+        done++;
+    }
+    memmove(journal->freed, journal->freed + done, (journal->freed_count - done) * sizeof(journal_freed_t));
+    journal->freed_count -= done;
+    return done;
+}
+
+int32_t journal_held_count(filesystem_t *fs) {
+    return fs->journal ? fs->journal->freed_count : 0;
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include "structs.h"
+#include <sys/uio.h>
+
+
+// Výchozí počet transakcí (příkazů) na jeden společný fdatasync
+#define JOURNAL_GROUP 8
+
+// Velikost oblasti žurnálu pro daný počet clusterů
+int64_t journal_region_size(int32_t cluster_count);
+
+// Vytvoří prázdný žurnál nově naformátovaného fs, superblok a hlavičku
+// žurnálu zapíše přímo na místo a počká na jejich uložení
+bool journal_format(filesystem_t *fs);
+
+// Připojí žurnál existujícího fs a přehraje jeho zapsané transakce,
+// vrací počet přehraných transakcí nebo -1 při chybě (žurnál pak zůstane odpojený)
+int32_t journal_open(filesystem_t *fs);
+
+// Přenese vše do obrazu, vyprázdní log a uvolní žurnál
+void journal_close(filesystem_t *fs);
+
+// Zápisy metadat jdou přes žurnál (stdio a politika command/manual)
+bool journal_active(filesystem_t *fs);
+
+// Přidá zápis metadat do rozpracované transakce místo zápisu do obrazu
+bool journal_capture(filesystem_t *fs, int64_t offset, const struct iovec *iov, int count);
+
+// Překryje přečtená data novějším obsahem ze žurnálu, který ještě není v obrazu
+void journal_overlay(filesystem_t *fs, int64_t offset, const struct iovec *iov, int count);
+
+// Připraví přímý zápis dat do obrazu - starší záznamy stejného místa nesmí data přepsat
+bool journal_data_write(filesystem_t *fs, int64_t offset, const struct iovec *iov, int count);
+
+// Data souborů jsou zapsaná přímo v obrazu - transakce, které na ně mohou odkazovat,
+// půjdou do logu až po fdatasync těchto dat (uspořádaný režim)
+void journal_data_written(filesystem_t *fs);
+
+// Žurnál obsahuje novější obsah části oblasti, než jaký je v obrazu (čtení mimo read_vec ho neuvidí)
+bool journal_covers(filesystem_t *fs, int64_t offset, size_t size);
+
+// Rozpracovaná transakce se spolu s dalšími size byty zápisů ještě bezpečně vejde do logu
+bool journal_fits(filesystem_t *fs, size_t size);
+
+// Uzavře rozpracovanou transakci a zapíše ji do logu (po zápisu dat souborů až při checkpointu),
+// po fs->journal_group transakcích je přenese
+bool journal_commit(filesystem_t *fs);
+
+// Jeden fdatasync pro všechny zapsané transakce (s odloženými transakcemi napřed fdatasync dat),
+// potom se přenesou na místo v obrazu
+bool journal_checkpoint(filesystem_t *fs);
+
+// Uvolněný cluster se nesmí přidělit, dokud transakce, která ho uvolnila, není trvalá -
+// nová data by se zapsala na místo dřív a pád by je podstrčil původnímu souboru.
+// Volající drží LOCK_ALLOC, false = žurnál cluster nesleduje
+bool journal_defer_free(filesystem_t *fs, int32_t cluster);
+
+// Zruší rezervaci clusterů uvolněných už trvalými transakcemi, volající drží LOCK_ALLOC,
+// vrací počet zpřístupněných clusterů
+int32_t journal_release_freed(filesystem_t *fs);
+
+// Počet uvolněných clusterů, které zatím čekají na trvalost své transakce (pod LOCK_ALLOC)
+int32_t journal_held_count(filesystem_t *fs);
@@ -0,0 +1,124 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "structs.h"
+#include "locks.h"
+#include "inodes.h"
+
+
+bool locks_init(filesystem_t *fs) {
+    struct fs_locks *locks = calloc(1, sizeof(struct fs_locks));
+    if (!locks) return false;
+
+    for (int32_t i = 0; i < INODE_LOCK_STRIPES; i++) {
+        pthread_rwlock_init(&locks->inodes[i], NULL);
+    }
+
+    //alokace volá uvolnění a ukládání bitmap, adresáře alokaci a čtení clusterů - zámky jsou rekurzivní
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    for (int32_t i = 0; i < LOCK_COUNT; i++) {
+        pthread_mutex_init(&locks->mutexes[i], &attr);
+    }
+    pthread_mutexattr_destroy(&attr);
+
+    for (int32_t i = 0; i < RWLOCK_COUNT; i++) {
+        pthread_rwlock_init(&locks->rwlocks[i], NULL);
+    }
+
+    fs->locks = locks;
+    return true;
+}
+
+void locks_destroy(filesystem_t *fs) {
+    struct fs_locks *locks = fs->locks;
+    if (!locks) return;
+
+    for (int32_t i = 0; i < INODE_LOCK_STRIPES; i++) {
+        pthread_rwlock_destroy(&locks->inodes[i]);
+    }
+    for (int32_t i = 0; i < LOCK_COUNT; i++) {
+        pthread_mutex_destroy(&locks->mutexes[i]);
+    }
+    for (int32_t i = 0; i < RWLOCK_COUNT; i++) {
+        pthread_rwlock_destroy(&locks->rwlocks[i]);
+    }
+    free(locks);
+    fs->locks = NULL;
+}
+
+void fs_lock(filesystem_t *fs, fs_lock_id_t id) {
+    if (fs->locks) pthread_mutex_lock(&fs->locks->mutexes[id]);
+}
+
+void fs_unlock(filesystem_t *fs, fs_lock_id_t id) {
+    if (fs->locks) pthread_mutex_unlock(&fs->locks->mutexes[id]);
+}
+
+void fs_rwlock(filesystem_t *fs, fs_rwlock_id_t id, bool exclusive) {
+    if (!fs->locks) return;
+    if (exclusive) pthread_rwlock_wrlock(&fs->locks->rwlocks[id]);
+    else pthread_rwlock_rdlock(&fs->locks->rwlocks[id]);
+}
+
+void fs_rwunlock(filesystem_t *fs, fs_rwlock_id_t id) {
+    if (fs->locks) pthread_rwlock_unlock(&fs->locks->rwlocks[id]);
+}
+
+
+void lock_set_init(inode_lock_set_t *set) {
+    set->count = 0;
+    set->inode_count = 0;
+}
+
+void lock_set_add(inode_lock_set_t *set, int32_t inode_id, bool exclusive) {
+    if (inode_id < 0 || set->inode_count == MAX_LOCKED_INODES) return;
+    set->inodes[set->inode_count++] = inode_id;
+
+    int32_t stripe = inode_id % INODE_LOCK_STRIPES;
+
+    //pole se udržuje seřazené, stejný zámek se zamyká jen jednou
+    int32_t i = 0;
+    while (i < set->count && set->stripes[i] < stripe) i++;
+    if (i < set->count && set->stripes[i] == stripe) {
+        set->exclusive[i] |= exclusive;
+        return;
+    }
+
+    memmove(&set->stripes[i + 1], &set->stripes[i], (set->count - i) * sizeof(int32_t));
+    memmove(&set->exclusive[i + 1], &set->exclusive[i], (set->count - i) * sizeof(bool));
+    set->stripes[i] = stripe;
+    set->exclusive[i] = exclusive;
+    set->count++;
+}
+
+void lock_set_acquire(filesystem_t *fs, inode_lock_set_t *set) {
+    if (!fs->locks) return;
+    for (int32_t i = 0; i < set->count; i++) {
+        pthread_rwlock_t *lock = &fs->locks->inodes[set->stripes[i]];
+        if (set->exclusive[i]) pthread_rwlock_wrlock(lock);
+        else pthread_rwlock_rdlock(lock);
+    }
+}
+
+bool lock_set_acquire_checked(filesystem_t *fs, inode_lock_set_t *set) {
+    lock_set_acquire(fs, set);
+    for (int32_t i = 0; i < set->inode_count; i++) {
+        if (!inode_in_use(fs, set->inodes[i])) {
+            lock_set_release(fs, set);
+            return false;
+        }
+    }
+    return true;
+}
+
+void lock_set_release(filesystem_t *fs, inode_lock_set_t *set) {
+    if (!fs->locks) return;
+    for (int32_t i = set->count - 1; i >= 0; i--) {
+        pthread_rwlock_unlock(&fs->locks->inodes[set->stripes[i]]);
+    }
+}
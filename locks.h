@@ -0,0 +1,72 @@
+#pragma once
+#include "structs.h"
+#include <stdbool.h>
+#include <pthread.h>
+
+// Počet zámků i-uzlů - i-uzel používá zámek podle svého čísla, různé i-uzly mohou zámek sdílet
+#define INODE_LOCK_STRIPES 256
+
+// Nejvíce i-uzlů zamčených jedním příkazem
+#define MAX_LOCKED_INODES 4
+
+// Vnitřní zámky sdílených struktur (rekurzivní), pořadí zamykání je:
+// příkazy -> i-uzly -> LOCK_DIRS -> LOCK_ALLOC -> tabulka inodů -> LOCK_CACHE -> žurnál
+typedef enum {
+    LOCK_DIRS,                  //indexy adresářů, cache cest a obsah adresářů
+    LOCK_ALLOC,                 //bitmapy, kurzory a počty v superbloku, tabulka čítačů odkazů
+    LOCK_CACHE,                 //cache clusterů
+    LOCK_COUNT
+} fs_lock_id_t;
+
+// Zámky pro čtení/zápis
+typedef enum {
+    RWLOCK_COMMANDS,            //příkaz sdíleně, format a sync výhradně (load --parallel)
+    RWLOCK_INODE_TABLE,         //cache tabulky inodů
+    RWLOCK_JOURNAL,             //záznamy žurnálu, čtení obrazu je sdílené
+    RWLOCK_COUNT
+} fs_rwlock_id_t;
+
+struct fs_locks {
+    pthread_rwlock_t inodes[INODE_LOCK_STRIPES];
+    pthread_mutex_t mutexes[LOCK_COUNT];
+    pthread_rwlock_t rwlocks[RWLOCK_COUNT];
+};
+
+// i-uzly zamykané jedním příkazem
+typedef struct {
+    int32_t stripes[MAX_LOCKED_INODES];   //zámky seřazené vzestupně, bez opakování
+    bool exclusive[MAX_LOCKED_INODES];
+    int32_t count;
+    int32_t inodes[MAX_LOCKED_INODES];    //přidané i-uzly
+    int32_t inode_count;
+} inode_lock_set_t;
+
+// Vytvoří zámky fs, bez nich fs_lock a ostatní funkce nic nedělají (jedno vlákno)
+bool locks_init(filesystem_t *fs);
+
+// Zruší zámky fs
+void locks_destroy(filesystem_t *fs);
+
+// Zamkne/odemkne vnitřní zámek
+void fs_lock(filesystem_t *fs, fs_lock_id_t id);
+void fs_unlock(filesystem_t *fs, fs_lock_id_t id);
+
+// Zamkne zámek pro čtení (exclusive = false) nebo zápis, odemyká fs_rwunlock
+void fs_rwlock(filesystem_t *fs, fs_rwlock_id_t id, bool exclusive);
+void fs_rwunlock(filesystem_t *fs, fs_rwlock_id_t id);
+
+// Prázdná sada zámků i-uzlů
+void lock_set_init(inode_lock_set_t *set);
+
+// Přidá i-uzel do sady, i-uzel přidaný vícekrát se zamkne nejsilnějším požadovaným způsobem
+void lock_set_add(inode_lock_set_t *set, int32_t inode_id, bool exclusive);
+
+// Zamkne celou sadu - vzestupně podle zámků, takže se příkazy navzájem nezablokují
+void lock_set_acquire(filesystem_t *fs, inode_lock_set_t *set);
+
+// Zamkne celou sadu a ověří, že i-uzly nalezené před zamčením mezitím nesmazalo jiné vlákno,
+// jinak sadu odemkne a vrátí false
+bool lock_set_acquire_checked(filesystem_t *fs, inode_lock_set_t *set);
+
+// Odemkne celou sadu
+void lock_set_release(filesystem_t *fs, inode_lock_set_t *set);
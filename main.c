@@ -1,91 +1,151 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <poll.h>
 #include "commandline.h"
 #include "structs.h"
 #include "filesystem.h"
+#include "journal.h"
+#include "trace.h"
+#include "zosfs.h"
 
 
+// na vstupu je další příkaz, bez čekání (vstup je nebufferovaný, nic nečte dopředu)
+static bool input_ready(FILE *input) {
+    struct pollfd fd = { fileno(input), POLLIN, 0 };
+    return poll(&fd, 1, 0) != 0;
+}
 
 int main(int argc, char *argv[]) {
 
     char *filename = "filesystem";//default jméno, pokud se nezadá jiné
-    if (argc > 1) {
-        filename = argv[1];
-    }
+    zosfs_options_t options;
+    zosfs_default_options(&options);
 
-    filesystem_t fs = {0};
-    fs.filename = filename;
-    //pokus o otevření nebo nytvoření souboru
-    fs.file = fopen(filename, "r+b");
-    if (!fs.file) {
-        fs.file = fopen(filename, "w+b");
-        if (!fs.file) {
-            fprintf(stderr, "Soubor nelze vytvořit '%s'\n", filename);
-            return 1;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            //politika zápisu metadat: always, command, manual
+            i++;
+            if (strcmp(argv[i], "always") == 0) options.sync_policy = ZOSFS_SYNC_ALWAYS;
+            else if (strcmp(argv[i], "command") == 0) options.sync_policy = ZOSFS_SYNC_COMMAND;
+            else if (strcmp(argv[i], "manual") == 0) options.sync_policy = ZOSFS_SYNC_MANUAL;
+            else {
+                fprintf(stderr, "Neznámá politika zápisu '%s'\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            //úroveň trasování od startu, např. -t path=debug nebo -t all=info
+            i++;
+            char subsystem[16] = {0};
+            const char *eq = strchr(argv[i], '=');
+            int level = eq ? trace_parse_level(eq + 1) : -1;
+            if (eq && (size_t)(eq - argv[i]) < sizeof(subsystem)) memcpy(subsystem, argv[i], eq - argv[i]);
+            if (level < 0 || !trace_set_level(subsystem, level)) {
+                fprintf(stderr, "Neplatné trasování '%s'\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            //počet příkazů, jejichž transakce žurnálu sdílí jeden fdatasync
+            i++;
+            if (sscanf(argv[i], "%d", &options.journal_group) != 1 || options.journal_group < 1) {
+                fprintf(stderr, "Neplatná velikost skupiny žurnálu '%s'\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-m") == 0) {
+            //přístup k souboru přes mmap
+            options.engine = ZOSFS_ENGINE_MMAP;
+        } else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            //paměťový rozpočet cache clusterů, např. 8MB nebo 512KB
+            i++;
+            char unit[3] = {0};
+            long size = 0;
+            if (sscanf(argv[i], "%ld%2s", &size, unit) < 1 || size < 0) {
+                fprintf(stderr, "Neplatná velikost cache '%s'\n", argv[i]);
+                return 1;
+            }
+            if (strcmp(unit, "KB") == 0) size *= 1024;
+            else if (strcmp(unit, "MB") == 0) size *= 1024 * 1024;
+            options.cache_size = size;
+        } else {
+            filename = argv[i];
         }
+    }
+
+    zosfs_t *fs;
+    zosfs_session_t *session;
+    zosfs_mount_info_t info;
+    zosfs_status_t status = zosfs_mount(filename, &options, &fs, &info);
+    if (status != ZOSFS_OK && status != ZOSFS_ENOTFORMATTED) {
+        if (info.replayed < 0) fprintf(stderr, "Žurnál nelze přehrát '%s'\n", filename);
+        else fprintf(stderr, "Soubor nelze vytvořit '%s'\n", filename);
+        return 1;
+    }
+    if (zosfs_session_open(fs, &session) != ZOSFS_OK) {
+        zosfs_unmount(fs);
+        return 1;
+    }
+
+    bool is_formatted = status == ZOSFS_OK;
+    if (info.created) {
         printf("Vytvořen nový filesystém '%s'\n", filename);
         printf("Použijte příkaz 'format <size>' pro jeho naformátování.\n");
+    } else if (!is_formatted) {
+        if (info.unsupported) printf("UNSUPPORTED FILESYSTEM VERSION %d\n", info.version);
+        printf("Soubor není validní filesystém.\n");
+        printf("Použijte příkaz 'format <size>' pro jeho naformátování.\n");
+    } else {
+        if (info.replayed > 0) printf("Žurnál: obnoveno %d transakcí\n", info.replayed);
+        if (info.mmap_failed) fprintf(stderr, "Soubor nelze namapovat, používám stdio\n");
+        printf("Načítám filesystem\n");
     }
 
-    bool is_formatted = false;
-    
-    // načtení existujícího fs
-    fseek(fs.file, 0, SEEK_END);
-    if (ftell(fs.file) >= sizeof(superblock_t)) {   //soubor menší než superblock nemůže být validní fs
-        fseek(fs.file, 0, SEEK_SET);
-        if (load_superblock(&fs)) {
-            load_bitmaps(&fs);
-            strcpy(fs.current_path, "/");
-            is_formatted = true;
-            printf("Načítám filesystem\n");
-        } else {
-            printf("Soubor není validní filesystém.\n");
-            printf("Použijte příkaz 'format <size>' pro jeho naformátování.\n");
-        }
-    }
-    
+
+    //stdio by načetlo další příkazy do svého bufferu, kde je poll neuvidí
+    setvbuf(stdin, NULL, _IONBF, 0);
 
     char line[512];
     while (1) {
         printf("> ");
+        //nečeká-li další příkaz, transakce skupiny se hned uloží jedním fdatasync
+        if (!input_ready(stdin)) journal_checkpoint(fs);
         if (!fgets(line, sizeof(line), stdin)) break;
         
-        char cmd[64], arg1[256] = {0}, arg2[256] = {0}, arg3[256] = {0};
-        sscanf(line, "%s %s %s %s", cmd, arg1, arg2, arg3);
+        char cmd[64] = {0}, arg1[256] = {0}, arg2[256] = {0}, arg3[256] = {0};
+        sscanf(line, "%63s %255s %255s %255s", cmd, arg1, arg2, arg3);
         
         if (strcmp(cmd, "exit") == 0) break;
         else if (strcmp(cmd, "format") == 0) {
-            if (format(&fs, arg1)) {
+            if (format(session, arg1)) {
                 is_formatted = true;
             }
+            command_done(fs);
         }
         else if (!is_formatted) {
             printf("Filesystém není naformátovaný. Použijte příkaz 'format <size>'\n");
-            continue;
         }
-        else if (strcmp(cmd, "mkdir") == 0) mkdir(&fs, arg1);
-        else if (strcmp(cmd, "pwd") == 0) pwd(&fs);
-        else if (strcmp(cmd, "ls") == 0) ls(&fs, arg1[0] ? arg1 : NULL);
-        else if (strcmp(cmd, "cd") == 0) cd(&fs, arg1);
-        else if (strcmp(cmd, "cat") == 0) cat(&fs, arg1);
-        else if (strcmp(cmd, "incp") == 0) incp(&fs, arg1, arg2);
-        else if (strcmp(cmd, "statfs") == 0) statfs(&fs);
-        else if (strcmp(cmd, "info") == 0) info(&fs, arg1);
-        else if (strcmp(cmd, "cp") == 0) cp(&fs, arg1, arg2);
-        else if (strcmp(cmd, "rm") == 0) rm(&fs, arg1);
-        else if (strcmp(cmd, "rmdir") == 0) rmdir(&fs, arg1);
-        else if (strcmp(cmd, "mv") == 0) mv(&fs, arg1, arg2);
-        else if (strcmp(cmd, "outcp") == 0) outcp(&fs, arg1, arg2);
-        else if (strcmp(cmd, "load") == 0) load(&fs, arg1);
-        else if (strcmp(cmd, "xcp") == 0) xcp(&fs, arg1, arg2, arg3);
-        else if (strcmp(cmd, "add") == 0) add(&fs, arg1, arg2);
-        else printf("Neznámý příkaz\n");
+        //skripty řídí ukládání samy, ostatní příkazy vykoná stejný dispečer jako skripty
+        else if (strcmp(cmd, "load") == 0 && strcmp(arg1, "--batch") == 0) {
+            //load --batch [N] soubor
+            if (arg3[0]) load_batch(session, arg3, atoi(arg2));
+            else load_batch(session, arg2, 0);
+            command_done(fs);
+        }
+        else if (strcmp(cmd, "load") == 0 && strcmp(arg1, "--parallel") == 0) {
+            //load --parallel N soubor
+            load_parallel(session, arg3, atoi(arg2));
+            command_done(fs);
+        }
+        else if (strcmp(cmd, "load") == 0) {
+            load(session, arg1);
+            command_done(fs);
+        }
+        else {
+            line[strcspn(line, "\n")] = '\0';
+            execute_line(session, line);
+        }
     }
     
-    if (fs.inode_bitmap) free(fs.inode_bitmap);
-    if (fs.data_bitmap) free(fs.data_bitmap);
-    fclose(fs.file);
-    
+    zosfs_session_close(session);
+    zosfs_unmount(fs);
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,178 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "structs.h"
+#include "filesystem.h"
+#include "refcount.h"
+#include "locks.h"
+
+
+int64_t refcount_table_size(int32_t cluster_count) {
+    return (int64_t)cluster_count * sizeof(uint16_t);
+}
+
+// tabulka leží hned za tabulkou i-uzlů
+static int64_t table_start(filesystem_t *fs) {
+    return fs->sb.inode_start + (int64_t)fs->sb.inode_count * sizeof(inode_t);
+}
+
+static int64_t counter_offset(filesystem_t *fs, int32_t cluster) {
+    return table_start(fs) + (int64_t)cluster * sizeof(uint16_t);
+}
+
+// velikost úseku tabulky (poslední úsek může být kratší)
+static size_t chunk_bytes(filesystem_t *fs, int32_t chunk) {
+    int64_t count = fs->sb.cluster_count - (int64_t)chunk * REFS_PER_CHUNK;
+    if (count > (int64_t)REFS_PER_CHUNK) count = REFS_PER_CHUNK;
+    return count * sizeof(uint16_t);
+}
+
+// vrátí čítač clusteru, při prvním přístupu načte jeho úsek tabulky
+static uint16_t *get_counter(filesystem_t *fs, int32_t cluster) {
+    if (!refcount_supported(fs) || cluster <= 0 || cluster >= fs->sb.cluster_count) return NULL;
+
+    //u mmap se čítače mění přímo v mapování
+    uint16_t *mapped = image_ptr(fs, counter_offset(fs, cluster), sizeof(uint16_t));
+    if (mapped) return mapped;
+
+    refcount_cache_t *cache = fs->refcounts;
+    if (!cache) return NULL;
+    int32_t chunk = cluster / REFS_PER_CHUNK;
+
+    if (!cache->chunks[chunk]) {
+        size_t size = chunk_bytes(fs, chunk);
+        //nově naformátovaná tabulka se z disku nečte
+        if (cache->fresh) {
+            cache->chunks[chunk] = calloc(1, size);
+            if (!cache->chunks[chunk]) return NULL;
+        } else {
+            uint16_t *data = malloc(size);
+            if (!data) return NULL;
+            if (!read_bytes(fs, counter_offset(fs, chunk * REFS_PER_CHUNK), data, size)) {
+                free(data);
+                return NULL;
+            }
+            cache->chunks[chunk] = data;
+        }
+    }
+    return cache->chunks[chunk] + cluster % REFS_PER_CHUNK;
+}
+
+// uloží změnu čítače podle politiky zápisu
+static bool counter_changed(filesystem_t *fs, int32_t cluster, uint16_t *counter) {
+    refcount_cache_t *cache = fs->refcounts;
+    if (!cache) return true;
+
+    //původní chování - každá změna jde hned na disk
+    if (fs->sync_policy == SYNC_ALWAYS) {
+        return write_bytes(fs, counter_offset(fs, cluster), counter, sizeof(uint16_t));
+    }
+    cache->dirty[cluster / REFS_PER_CHUNK] = 1;
+    cache->any_dirty = true;
+    return true;
+}
+
+bool refcount_init(filesystem_t *fs, bool fresh) {
+    refcount_free(fs);
+
+    //u mmap slouží jako cache samotné mapování
+    if (!refcount_supported(fs) || fs->map) return true;
+
+    refcount_cache_t *cache = calloc(1, sizeof(refcount_cache_t));
+    if (!cache) return false;
+
+    cache->chunk_count = (fs->sb.cluster_count + REFS_PER_CHUNK - 1) / REFS_PER_CHUNK;
+    cache->chunks = calloc(cache->chunk_count + 1, sizeof(uint16_t *));
+    cache->dirty = calloc(cache->chunk_count + 1, 1);
+    if (!cache->chunks || !cache->dirty) {
+        free(cache->chunks);
+        free(cache->dirty);
+        free(cache);
+        return false;
+    }
+
+    cache->fresh = fresh;
+    fs->refcounts = cache;
+    return true;
+}
+
+void refcount_free(filesystem_t *fs) {
+    refcount_cache_t *cache = fs->refcounts;
+    if (!cache) return;
+
+    for (int32_t i = 0; i < cache->chunk_count; i++) {
+        free(cache->chunks[i]);
+    }
+    free(cache->chunks);
+    free(cache->dirty);
+    free(cache);
+    fs->refcounts = NULL;
+}
+
+bool refcount_sync(filesystem_t *fs) {
+    refcount_cache_t *cache = fs->refcounts;
+    if (!cache) return true;
+
+    fs_lock(fs, LOCK_ALLOC);
+    bool ok = true;
+    for (int32_t i = 0; cache->any_dirty && i < cache->chunk_count; i++) {
+        if (!cache->dirty[i]) continue;
+        if (!write_bytes(fs, counter_offset(fs, i * REFS_PER_CHUNK), cache->chunks[i], chunk_bytes(fs, i))) ok = false;
+        cache->dirty[i] = 0;
+    }
+
+    cache->any_dirty = false;
+    fs_unlock(fs, LOCK_ALLOC);
+    return ok;
+}
+
+size_t refcount_dirty_bytes(filesystem_t *fs) {
+    refcount_cache_t *cache = fs->refcounts;
+    if (!cache) return 0;
+
+    size_t size = 0;
+    fs_lock(fs, LOCK_ALLOC);
+    for (int32_t i = 0; cache->any_dirty && i < cache->chunk_count; i++) {
+        if (cache->dirty[i]) size += chunk_bytes(fs, i);
+    }
+    fs_unlock(fs, LOCK_ALLOC);
+    return size;
+}
+
+bool refcount_supported(filesystem_t *fs) {
+    return fs->sb.version != FS_VERSION_32 && (fs->sb.features & FS_FEATURE_REFCOUNT);
+}
+
+int32_t cluster_refs(filesystem_t *fs, int32_t cluster) {
+    fs_lock(fs, LOCK_ALLOC);
+    uint16_t *counter = get_counter(fs, cluster);
+    int32_t refs = counter ? *counter : 0;
+    fs_unlock(fs, LOCK_ALLOC);
+    return refs;
+}
+
+bool share_cluster(filesystem_t *fs, int32_t cluster) {
+    fs_lock(fs, LOCK_ALLOC);
+    uint16_t *counter = get_counter(fs, cluster);
+    bool ok = counter && *counter < UINT16_MAX;
+    if (ok) {
+        (*counter)++;
+        ok = counter_changed(fs, cluster, counter);
+    }
+    fs_unlock(fs, LOCK_ALLOC);
+    return ok;
+}
+
+bool unshare_cluster(filesystem_t *fs, int32_t cluster) {
+    fs_lock(fs, LOCK_ALLOC);
+    uint16_t *counter = get_counter(fs, cluster);
+    bool shared = counter && *counter > 0;
+    if (shared) {
+        (*counter)--;
+        counter_changed(fs, cluster, counter);
+    }
+    fs_unlock(fs, LOCK_ALLOC);
+    return shared;
+}
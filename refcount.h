@@ -0,0 +1,33 @@
+#pragma once
+#include "structs.h"
+
+
+// Počet čítačů v jednom úseku tabulky
+#define REFS_PER_CHUNK (CLUSTER_SIZE / sizeof(uint16_t))
+
+// Velikost tabulky čítačů odkazů pro daný počet clusterů
+int64_t refcount_table_size(int32_t cluster_count);
+
+// Připraví cache tabulky čítačů (pokud ji fs má), fresh = nově naformátovaná tabulka
+bool refcount_init(filesystem_t *fs, bool fresh);
+
+// Uvolní cache tabulky čítačů
+void refcount_free(filesystem_t *fs);
+
+// Zapíše změněné úseky tabulky čítačů
+bool refcount_sync(filesystem_t *fs);
+
+// Počet bytů změněných úseků tabulky čítačů
+size_t refcount_dirty_bytes(filesystem_t *fs);
+
+// Fs má tabulku čítačů, clustery lze sdílet mezi soubory
+bool refcount_supported(filesystem_t *fs);
+
+// Počet dalších souborů, které cluster sdílí (0 = cluster má jediného vlastníka)
+int32_t cluster_refs(filesystem_t *fs, int32_t cluster);
+
+// Přidá cluster dalšímu souboru, false pokud čítač přetekl nebo fs sdílení neumí
+bool share_cluster(filesystem_t *fs, int32_t cluster);
+
+// Odebere jeden ze sdílených odkazů, false pokud cluster sdílený nebyl (volající ho uvolní)
+bool unshare_cluster(filesystem_t *fs, int32_t cluster);
@@ -0,0 +1,584 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <time.h>
+#include <fcntl.h>
+#include "structs.h"
+#include "commandline.h"
+#include "filesystem.h"
+#include "zosfs.h"
+
+
+// Přehrání skriptu příkazů (soubor pro load nebo syntetická zátěž) nad novým nebo existujícím obrazem.
+// Latence každého příkazu jde do log-lineárního histogramu podle typu příkazu, na konci se vypíše
+// JSON s p50/p99/p999, propustností a přenosy z/do obrazu. Výstup příkazů se zahazuje (kromě -v).
+
+// histogram: mocniny dvou rozdělené na HIST_SUB stejných dílů (chyba kvantilu nejvýš 1/HIST_SUB)
+#define HIST_SUB_BITS 4
+#define HIST_SUB (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS ((64 - HIST_SUB_BITS + 1) * HIST_SUB)
+
+#define MAX_COMMAND_TYPES 32
+// nejvyšší zanoření load uvnitř skriptu
+#define MAX_LOAD_DEPTH 8
+
+// výchozí rozsah syntetických zátěží
+#define SMALL_FILES 1000
+#define SMALL_SOURCES 4
+#define LARGE_FILES 4
+#define LARGE_FILE_SIZE (16 * 1024 * 1024)
+#define DEEP_TREES 8
+#define DEEP_LEVELS 32
+
+
+typedef struct {
+    uint64_t counts[HIST_BUCKETS];
+    uint64_t count;
+    uint64_t min;
+    uint64_t max;
+    double sum;
+} histogram_t;
+
+// statistiky jednoho typu příkazu
+typedef struct {
+    char name[24];
+    histogram_t latency;        //ns
+    uint64_t failed;
+    uint64_t bytes_read;
+    uint64_t bytes_written;
+    uint64_t syncs;
+} command_stats_t;
+
+// řádky skriptu
+typedef struct {
+    char **lines;
+    int32_t count;
+    int32_t capacity;
+} script_t;
+
+typedef struct {
+    session_t *session;
+    int32_t batch;              //< 0 = ukládání po příkazu, jinak po batch příkazech (0 = na konci)
+    int32_t in_batch;           //příkazy od posledního uložení dávky
+    command_stats_t types[MAX_COMMAND_TYPES];
+    int32_t type_count;
+    uint64_t commands;
+    uint64_t failed;
+} replay_t;
+
+// soubory zátěže na disku hostitele, po přehrání se smažou
+typedef struct {
+    char dir[64];
+    char *files[8];
+    int32_t file_count;
+} host_data_t;
+
+
+static uint32_t rng_state = 2463534242u;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static uint32_t next_random(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+
+static int32_t hist_index(uint64_t value) {
+    if (value < HIST_SUB) return value;
+    int32_t shift = 63 - __builtin_clzll(value) - HIST_SUB_BITS;
+    return (shift + 1) * HIST_SUB + ((value >> shift) & (HIST_SUB - 1));
+}
+
+// střed intervalu hodnot, které patří do přihrádky
+static double hist_value(int32_t index) {
+    int32_t group = index / HIST_SUB, sub = index % HIST_SUB;
+    if (group == 0) return sub;
+    double low = (double)((uint64_t)(HIST_SUB + sub) << (group - 1));
+    return low + (double)((uint64_t)1 << (group - 1)) / 2;
+}
+
+static void hist_add(histogram_t *hist, uint64_t value) {
+    if (hist->count == 0 || value < hist->min) hist->min = value;
+    if (value > hist->max) hist->max = value;
+    hist->counts[hist_index(value)]++;
+    hist->count++;
+    hist->sum += value;
+}
+
+// kvantil q (0-1), přesné minimum a maximum mají přednost před středem přihrádky
+static double hist_quantile(const histogram_t *hist, double q) {
+    if (hist->count == 0) return 0;
+    uint64_t rank = (uint64_t)(q * hist->count);
+    if (rank >= hist->count) rank = hist->count - 1;
+
+    uint64_t seen = 0;
+    for (int32_t i = 0; i < HIST_BUCKETS; i++) {
+        seen += hist->counts[i];
+        if (seen > rank) {
+            double value = hist_value(i);
+            if (value < hist->min) return hist->min;
+            if (value > hist->max) return hist->max;
+            return value;
+        }
+    }
+    return hist->max;
+}
+
+
+static bool script_add(script_t *script, const char *format, ...) {
+    if (script->count == script->capacity) {
+        int32_t capacity = script->capacity ? script->capacity * 2 : 256;
+        char **grown = realloc(script->lines, capacity * sizeof(char *));
+        if (!grown) return false;
+        script->lines = grown;
+        script->capacity = capacity;
+    }
+
+    char line[512];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+
+    script->lines[script->count] = strdup(line);
+    if (!script->lines[script->count]) return false;
+    script->count++;
+    return true;
+}
+
+static void script_free(script_t *script) {
+    for (int32_t i = 0; i < script->count; i++) free(script->lines[i]);
+    free(script->lines);
+    memset(script, 0, sizeof(*script));
+}
+
+// načte neprázdné řádky souboru
+static bool script_read(script_t *script, const char *filename) {
+    FILE *file = fopen(filename, "r");
+    if (!file) return false;
+
+    char line[512];
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), file)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[strspn(line, " \t")] == '\0') continue;
+        ok = script_add(script, "%s", line);
+    }
+    fclose(file);
+    return ok;
+}
+
+static bool script_write(const script_t *script, const char *filename) {
+    FILE *file = fopen(filename, "w");
+    if (!file) return false;
+    for (int32_t i = 0; i < script->count; i++) fprintf(file, "%s\n", script->lines[i]);
+    return fclose(file) == 0;
+}
+
+
+// vytvoří soubor hostitele dané velikosti, text = tisknutelné znaky (pro cat)
+static const char *host_file(host_data_t *data, const char *name, int64_t size, bool text) {
+    if (data->file_count == (int32_t)(sizeof(data->files) / sizeof(data->files[0]))) return NULL;
+    char path[128];
+    snprintf(path, sizeof(path), "%s/%s", data->dir, name);
+
+    FILE *file = fopen(path, "wb");
+    if (!file) return NULL;
+    uint8_t buffer[CLUSTER_SIZE];
+    while (size > 0) {
+        size_t chunk = size < (int64_t)sizeof(buffer) ? (size_t)size : sizeof(buffer);
+        for (size_t i = 0; i < chunk; i++) {
+            buffer[i] = text ? 'a' + next_random() % 26 : next_random();
+        }
+        fwrite(buffer, 1, chunk, file);
+        size -= chunk;
+    }
+    if (fclose(file) != 0) return NULL;
+
+    data->files[data->file_count] = strdup(path);
+    return data->files[data->file_count++];
+}
+
+// keep = soubory zůstanou pro uložený skript (-w)
+static void host_cleanup(host_data_t *data, bool keep) {
+    for (int32_t i = 0; i < data->file_count; i++) {
+        if (!keep) remove(data->files[i]);
+        free(data->files[i]);
+    }
+    data->file_count = 0;
+    if (data->dir[0] && !keep) remove(data->dir);
+}
+
+
+// mnoho malých souborů v adresářích po 100: incp, čtení, kopie, přejmenování, mazání
+static bool generate_small(script_t *script, host_data_t *data, int32_t count) {
+    static const int64_t sizes[SMALL_SOURCES] = {200, 1500, 4096, 12000};
+    const char *sources[SMALL_SOURCES];
+    for (int32_t k = 0; k < SMALL_SOURCES; k++) {
+        char name[16];
+        snprintf(name, sizeof(name), "s%d", k);
+        sources[k] = host_file(data, name, sizes[k], true);
+        if (!sources[k]) return false;
+    }
+
+    bool ok = script_add(script, "mkdir /sm");
+    for (int32_t d = 0; d * 100 < count; d++) ok = ok && script_add(script, "mkdir /sm/d%d", d);
+    for (int32_t i = 0; i < count; i++) {
+        ok = ok && script_add(script, "incp %s /sm/d%d/f%d", sources[i % SMALL_SOURCES], i / 100, i);
+    }
+    for (int32_t i = 0; i < count; i++) {
+        if (i % 2 == 0) ok = ok && script_add(script, "cat /sm/d%d/f%d", i / 100, i);
+        else ok = ok && script_add(script, "info /sm/d%d/f%d", i / 100, i);
+    }
+    for (int32_t i = 0; i < count; i += 4) {
+        ok = ok && script_add(script, "cp /sm/d%d/f%d /sm/d%d/c%d", i / 100, i, i / 100, i);
+        if (i + 1 < count) ok = ok && script_add(script, "mv /sm/d%d/f%d /sm/d%d/m%d", i / 100, i + 1, i / 100, i + 1);
+    }
+    for (int32_t d = 0; d * 100 < count; d++) ok = ok && script_add(script, "ls /sm/d%d", d);
+    for (int32_t i = 0; i < count; i += 2) {
+        ok = ok && script_add(script, "rm /sm/d%d/f%d", i / 100, i);
+        if (i % 4 == 0) ok = ok && script_add(script, "rm /sm/d%d/c%d", i / 100, i);
+    }
+    return ok;
+}
+
+// několik velkých souborů: incp, outcp, cp, cp --reflink, add, xcp, cat, mazání
+static bool generate_large(script_t *script, host_data_t *data, int32_t count) {
+    const char *big = host_file(data, "big", LARGE_FILE_SIZE + 123, false);
+    const char *tail = host_file(data, "tail", 1024 * 1024 + 77, false);
+    const char *out = host_file(data, "out", 0, false);
+    if (!big || !tail || !out) return false;
+
+    bool ok = script_add(script, "mkdir /lg");
+    for (int32_t i = 0; i < count; i++) ok = ok && script_add(script, "incp %s /lg/b%d", big, i);
+    for (int32_t i = 0; i < count; i++) ok = ok && script_add(script, "outcp /lg/b%d %s", i, out);
+    for (int32_t i = 0; i < count; i++) ok = ok && script_add(script, "cp /lg/b%d /lg/c%d", i, i);
+    for (int32_t i = 0; i < count; i++) ok = ok && script_add(script, "cp --reflink /lg/b%d /lg/r%d", i, i);
+    for (int32_t i = 0; i < count; i++) {
+        ok = ok && script_add(script, "incp %s /lg/t%d", tail, i);
+        ok = ok && script_add(script, "add /lg/r%d /lg/t%d", i, i);
+    }
+    for (int32_t i = 0; i < count; i++) ok = ok && script_add(script, "xcp /lg/b%d /lg/t%d /lg/x%d", i, i, i);
+    for (int32_t i = 0; i < count; i++) ok = ok && script_add(script, "cat /lg/c%d", i);
+    for (int32_t i = 0; i < count; i++) {
+        ok = ok && script_add(script, "rm /lg/b%d", i) && script_add(script, "rm /lg/c%d", i) &&
+             script_add(script, "rm /lg/r%d", i) && script_add(script, "rm /lg/t%d", i) &&
+             script_add(script, "rm /lg/x%d", i);
+    }
+    return ok;
+}
+
+// hluboké stromy adresářů: mkdir po úrovních, práce na dně stromu přes dlouhé cesty, odstranění odspodu
+static bool generate_deep(script_t *script, host_data_t *data, int32_t count) {
+    const char *leaf = host_file(data, "leaf", 2048, true);
+    if (!leaf) return false;
+
+    bool ok = true;
+    char path[256];
+    for (int32_t t = 0; t < count; t++) {
+        int len = snprintf(path, sizeof(path), "/t%d", t);
+        ok = ok && script_add(script, "mkdir %s", path);
+        for (int32_t level = 1; level < DEEP_LEVELS; level++) {
+            len += snprintf(path + len, sizeof(path) - len, "/l%d", level);
+            ok = ok && script_add(script, "mkdir %s", path);
+        }
+        ok = ok && script_add(script, "incp %s %s/leaf", leaf, path) &&
+             script_add(script, "cd %s", path) && script_add(script, "ls") && script_add(script, "pwd") &&
+             script_add(script, "cd /") && script_add(script, "info %s/leaf", path) &&
+             script_add(script, "cat %s/leaf", path) && script_add(script, "cp %s/leaf /t%d/copy", path, t) &&
+             script_add(script, "mv %s/leaf /t%d/moved", path, t);
+    }
+    for (int32_t t = 0; t < count; t++) {
+        ok = ok && script_add(script, "rm /t%d/copy", t) && script_add(script, "rm /t%d/moved", t);
+        int len = snprintf(path, sizeof(path), "/t%d", t);
+        for (int32_t level = 1; level < DEEP_LEVELS; level++) {
+            len += snprintf(path + len, sizeof(path) - len, "/l%d", level);
+        }
+        //odspodu - zkracování cesty o poslední jméno
+        while (ok && path[0]) {
+            ok = script_add(script, "rmdir %s", path);
+            *strrchr(path, '/') = '\0';
+        }
+    }
+    return ok;
+}
+
+
+static command_stats_t *command_type(replay_t *run, const char *name) {
+    for (int32_t i = 0; i < run->type_count; i++) {
+        if (strcmp(run->types[i].name, name) == 0) return &run->types[i];
+    }
+    if (run->type_count == MAX_COMMAND_TYPES) return NULL;
+    command_stats_t *type = &run->types[run->type_count++];
+    memset(type, 0, sizeof(*type));
+    snprintf(type->name, sizeof(type->name), "%s", name);
+    return type;
+}
+
+// zaznamená jeden změřený příkaz
+static void record(replay_t *run, const char *name, bool success, uint64_t elapsed,
+                   const zosfs_io_stats_t *before, const zosfs_io_stats_t *after) {
+    run->commands++;
+    if (!success) run->failed++;
+
+    command_stats_t *type = command_type(run, name);
+    if (!type) return;
+    hist_add(&type->latency, elapsed);
+    if (!success) type->failed++;
+    type->bytes_read += after->bytes_read - before->bytes_read;
+    type->bytes_written += after->bytes_written - before->bytes_written;
+    type->syncs += after->syncs - before->syncs;
+}
+
+// změřené uložení dávky
+static void batch_sync(replay_t *run) {
+    filesystem_t *fs = run->session->fs;
+    zosfs_io_stats_t before, after;
+    zosfs_io_stats(fs, &before);
+    uint64_t start = now_ns();
+    bool success = zosfs_sync(fs) == ZOSFS_OK;
+    uint64_t elapsed = now_ns() - start;
+    zosfs_io_stats(fs, &after);
+    record(run, "batch_sync", success, elapsed, &before, &after);
+    run->in_batch = 0;
+}
+
+static bool replay_script(replay_t *run, const script_t *script, int32_t depth);
+
+// vykoná a změří jeden řádek, false = exit
+static bool replay_line(replay_t *run, const char *line, int32_t depth) {
+    char cmd[64] = {0}, arg1[256] = {0};
+    sscanf(line, "%63s %255s", cmd, arg1);
+    if (cmd[0] == '\0') return true;
+    if (strcmp(cmd, "exit") == 0) return false;
+
+    //vnořený skript se přehraje po příkazech, load samotný se neměří
+    if (strcmp(cmd, "load") == 0 && arg1[0] != '-') {
+        script_t nested = {0};
+        bool ok = depth < MAX_LOAD_DEPTH && script_read(&nested, arg1);
+        bool more = true;
+        if (ok) more = replay_script(run, &nested, depth + 1);
+        else printf("OPENING FILE FAILED\n");
+        script_free(&nested);
+        return more;
+    }
+
+    char name[24];
+    if (strcmp(arg1, "--reflink") == 0) snprintf(name, sizeof(name), "%s --reflink", cmd);
+    else snprintf(name, sizeof(name), "%s", cmd);
+
+    filesystem_t *fs = run->session->fs;
+    zosfs_io_stats_t before, after;
+    zosfs_io_stats(fs, &before);
+    uint64_t start = now_ns();
+    bool success = execute_line(run->session, line);
+    uint64_t elapsed = now_ns() - start;
+    zosfs_io_stats(fs, &after);
+    record(run, name, success, elapsed, &before, &after);
+
+    if (run->batch > 0 && ++run->in_batch >= run->batch) batch_sync(run);
+    return true;
+}
+
+static bool replay_script(replay_t *run, const script_t *script, int32_t depth) {
+    for (int32_t i = 0; i < script->count; i++) {
+        if (!replay_line(run, script->lines[i], depth)) return false;
+    }
+    return true;
+}
+
+
+static void print_report(FILE *out, const replay_t *run, const char *workload, const char *engine,
+                         uint64_t wall, const zosfs_io_stats_t *io) {
+    double seconds = wall / 1e9;
+    double mb = (io->bytes_read + io->bytes_written) / (1024.0 * 1024.0);
+
+    fprintf(out, "{\n  \"workload\": \"%s\",\n  \"engine\": \"%s\",\n", workload, engine);
+    fprintf(out, "  \"commands\": %llu,\n  \"failed\": %llu,\n  \"wall_s\": %.3f,\n  \"ops_per_s\": %.1f,\n",
+            (unsigned long long)run->commands, (unsigned long long)run->failed, seconds,
+            seconds > 0 ? run->commands / seconds : 0.0);
+    fprintf(out, "  \"bytes_read\": %llu,\n  \"bytes_written\": %llu,\n  \"syncs\": %llu,\n  \"mb_per_s\": %.1f,\n",
+            (unsigned long long)io->bytes_read, (unsigned long long)io->bytes_written,
+            (unsigned long long)io->syncs, seconds > 0 ? mb / seconds : 0.0);
+    fprintf(out, "  \"by_command\": [");
+
+    for (int32_t i = 0; i < run->type_count; i++) {
+        const command_stats_t *type = &run->types[i];
+        const histogram_t *hist = &type->latency;
+        double busy = hist->sum / 1e9;
+        fprintf(out, "%s\n    {\"command\": \"%s\", \"count\": %llu, \"failed\": %llu, ",
+                i ? "," : "", type->name, (unsigned long long)hist->count, (unsigned long long)type->failed);
+        fprintf(out, "\"p50_us\": %.1f, \"p99_us\": %.1f, \"p999_us\": %.1f, \"max_us\": %.1f, \"mean_us\": %.1f, ",
+                hist_quantile(hist, 0.5) / 1e3, hist_quantile(hist, 0.99) / 1e3, hist_quantile(hist, 0.999) / 1e3,
+                hist->max / 1e3, hist->count ? hist->sum / hist->count / 1e3 : 0.0);
+        fprintf(out, "\"total_ms\": %.1f, \"ops_per_s\": %.1f, \"bytes_read\": %llu, \"bytes_written\": %llu, \"syncs\": %llu}",
+                hist->sum / 1e6, busy > 0 ? hist->count / busy : 0.0,
+                (unsigned long long)type->bytes_read, (unsigned long long)type->bytes_written,
+                (unsigned long long)type->syncs);
+    }
+    fprintf(out, "\n  ]\n}\n");
+}
+
+static void usage(void) {
+    fprintf(stderr, "Použití: zos_replay [-f velikost] [-m] [-s always|command|manual] [-j N] [-b N] [-v]\n"
+                    "                    [-w soubor] obraz (skript | -g small|large|deep [-n N])\n");
+}
+
+int main(int argc, char *argv[]) {
+    const char *image = NULL, *script_file = NULL, *generator = NULL, *save_file = NULL, *format_size = NULL;
+    int32_t scale = 0, batch = -1;
+    bool verbose = false;
+    zosfs_options_t options;
+    zosfs_default_options(&options);
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            //nový fs dané velikosti, jinak se použije existující obraz
+            format_size = argv[++i];
+        } else if (strcmp(argv[i], "-g") == 0 && i + 1 < argc) {
+            generator = argv[++i];
+        } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            //rozsah syntetické zátěže (soubory nebo stromy)
+            scale = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+            //uloží přehrávaný skript, např. vygenerovanou zátěž pro load (její soubory se pak nesmažou)
+            save_file = argv[++i];
+        } else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+            //jako load --batch N
+            batch = atoi(argv[++i]);
+            if (batch < 0) batch = 0;
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "always") == 0) options.sync_policy = ZOSFS_SYNC_ALWAYS;
+            else if (strcmp(argv[i], "command") == 0) options.sync_policy = ZOSFS_SYNC_COMMAND;
+            else if (strcmp(argv[i], "manual") == 0) options.sync_policy = ZOSFS_SYNC_MANUAL;
+            else {
+                fprintf(stderr, "Neznámá politika zápisu '%s'\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            if (sscanf(argv[++i], "%d", &options.journal_group) != 1 || options.journal_group < 1) {
+                fprintf(stderr, "Neplatná velikost skupiny žurnálu '%s'\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-m") == 0) {
+            options.engine = ZOSFS_ENGINE_MMAP;
+        } else if (strcmp(argv[i], "-v") == 0) {
+            //výstup příkazů se nezahazuje
+            verbose = true;
+        } else if (argv[i][0] == '-') {
+            usage();
+            return 1;
+        } else if (!image) {
+            image = argv[i];
+        } else {
+            script_file = argv[i];
+        }
+    }
+    if (!image || (!script_file == !generator)) {
+        usage();
+        return 1;
+    }
+
+    //zátěž se připraví dřív, než se sáhne na obraz
+    script_t script = {0};
+    host_data_t data = {0};
+    bool ready;
+    if (script_file) {
+        ready = script_read(&script, script_file);
+        if (!ready) fprintf(stderr, "Skript nelze načíst '%s'\n", script_file);
+    } else {
+        snprintf(data.dir, sizeof(data.dir), "/tmp/zos_replay.XXXXXX");
+        ready = mkdtemp(data.dir) != NULL;
+        if (!ready) data.dir[0] = '\0';
+        if (ready && strcmp(generator, "small") == 0) ready = generate_small(&script, &data, scale > 0 ? scale : SMALL_FILES);
+        else if (ready && strcmp(generator, "large") == 0) ready = generate_large(&script, &data, scale > 0 ? scale : LARGE_FILES);
+        else if (ready && strcmp(generator, "deep") == 0) ready = generate_deep(&script, &data, scale > 0 ? scale : DEEP_TREES);
+        else if (ready) {
+            fprintf(stderr, "Neznámá zátěž '%s'\n", generator);
+            ready = false;
+        }
+        if (!ready) fprintf(stderr, "Zátěž nelze připravit\n");
+    }
+    if (ready && save_file && !script_write(&script, save_file)) {
+        fprintf(stderr, "Skript nelze uložit '%s'\n", save_file);
+        ready = false;
+    } else if (ready && save_file && data.file_count > 0) {
+        fprintf(stderr, "Soubory zátěže zůstávají v '%s'\n", data.dir);
+    }
+
+    zosfs_t *fs = NULL;
+    zosfs_session_t *session = NULL;
+    zosfs_status_t status = ready ? zosfs_mount(image, &options, &fs, NULL) : ZOSFS_EINVAL;
+    if (ready && status != ZOSFS_OK && status != ZOSFS_ENOTFORMATTED) {
+        fprintf(stderr, "Obraz nelze otevřít '%s'\n", image);
+        ready = false;
+    }
+    if (ready && zosfs_session_open(fs, &session) != ZOSFS_OK) ready = false;
+
+    //zpráva jde na původní stdout, výstup příkazů do /dev/null
+    FILE *report = NULL;
+    if (ready) {
+        fflush(stdout);
+        int report_fd = fcntl(fileno(stdout), F_DUPFD_CLOEXEC, 3);
+        report = report_fd >= 0 ? fdopen(report_fd, "w") : NULL;
+        if (!report) ready = false;
+        else if (!verbose && !freopen("/dev/null", "w", stdout)) ready = false;
+    }
+
+    if (ready && format_size) {
+        ready = format(session, format_size);
+        command_done(fs);
+        if (!ready) fprintf(stderr, "Formátování na '%s' selhalo\n", format_size);
+    } else if (ready && status == ZOSFS_ENOTFORMATTED) {
+        fprintf(stderr, "Obraz '%s' není naformátovaný, použijte -f velikost\n", image);
+        ready = false;
+    }
+
+    if (ready) {
+        replay_t *run = calloc(1, sizeof(replay_t));
+        if (run) {
+            run->session = session;
+            run->batch = batch;
+            if (batch >= 0) fs->in_batch = true;
+
+            zosfs_io_stats_t start_io, end_io;
+            zosfs_io_stats(fs, &start_io);
+            uint64_t start = now_ns();
+            replay_script(run, &script, 0);
+            if (batch >= 0) {
+                fs->in_batch = false;
+                batch_sync(run);
+            }
+            uint64_t wall = now_ns() - start;
+            zosfs_io_stats(fs, &end_io);
+            fflush(stdout);
+
+            end_io.bytes_read -= start_io.bytes_read;
+            end_io.bytes_written -= start_io.bytes_written;
+            end_io.syncs -= start_io.syncs;
+            print_report(report, run, script_file ? script_file : generator,
+                         fs->engine == IO_ENGINE_MMAP ? "mmap" : "stdio", wall, &end_io);
+            free(run);
+        } else {
+            ready = false;
+        }
+    }
+
+    if (report) fclose(report);
+    zosfs_session_close(session);
+    zosfs_unmount(fs);
+    host_cleanup(&data, ready && save_file);
+    script_free(&script);
+    return ready ? 0 : 1;
+}
@@ -0,0 +1,141 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include "stream.h"
+
+
+// přečte celý blok, zkrácená čtení se opakují
+static ssize_t read_full(int fd, uint8_t *buffer, size_t size) {
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = read(fd, buffer + done, size - done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return -1;
+        if (n == 0) break;
+        done += n;
+    }
+    return done;
+}
+
+static void *reader_thread(void *arg) {
+    stream_reader_t *reader = arg;
+    int32_t index = 0;
+
+    while (1) {
+        pthread_mutex_lock(&reader->lock);
+        while (reader->full[index] && !reader->stop) {
+            pthread_cond_wait(&reader->changed, &reader->lock);
+        }
+        bool finished = reader->stop || reader->remaining == 0;
+        pthread_mutex_unlock(&reader->lock);
+        if (finished) break;
+
+        //čte se mimo zámek, volající mezitím zpracovává druhý buffer
+        size_t want = reader->remaining < (off_t)reader->chunk_size ? (size_t)reader->remaining : reader->chunk_size;
+        ssize_t got = read_full(reader->fd, reader->buffers[index], want);
+
+        pthread_mutex_lock(&reader->lock);
+        if (got != (ssize_t)want) {
+            //soubor se během čtení zkrátil nebo chyba čtení
+            reader->error = true;
+            pthread_mutex_unlock(&reader->lock);
+            break;
+        }
+        reader->lengths[index] = got;
+        reader->full[index] = true;
+        reader->remaining -= got;
+        pthread_cond_broadcast(&reader->changed);
+        pthread_mutex_unlock(&reader->lock);
+
+        index = (index + 1) % STREAM_BUFFERS;
+    }
+
+    pthread_mutex_lock(&reader->lock);
+    reader->done = true;
+    pthread_cond_broadcast(&reader->changed);
+    pthread_mutex_unlock(&reader->lock);
+    return NULL;
+}
+
+bool stream_open(stream_reader_t *reader, const char *path, size_t chunk_size) {
+    memset(reader, 0, sizeof(stream_reader_t));
+    reader->chunk_size = chunk_size;
+    reader->current = -1;
+
+    reader->fd = open(path, O_RDONLY);
+    if (reader->fd < 0) return false;
+
+    //velikost v off_t - soubor může být větší než 2 GB
+    struct stat st;
+    if (fstat(reader->fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(reader->fd);
+        return false;
+    }
+    reader->size = st.st_size;
+    reader->remaining = st.st_size;
+
+    for (int32_t i = 0; i < STREAM_BUFFERS; i++) {
+        reader->buffers[i] = malloc(chunk_size);
+        if (!reader->buffers[i]) {
+            for (int32_t j = 0; j < i; j++) free(reader->buffers[j]);
+            close(reader->fd);
+            return false;
+        }
+    }
+
+    pthread_mutex_init(&reader->lock, NULL);
+    pthread_cond_init(&reader->changed, NULL);
+    if (pthread_create(&reader->thread, NULL, reader_thread, reader) != 0) {
+        pthread_mutex_destroy(&reader->lock);
+        pthread_cond_destroy(&reader->changed);
+        for (int32_t i = 0; i < STREAM_BUFFERS; i++) free(reader->buffers[i]);
+        close(reader->fd);
+        return false;
+    }
+    return true;
+}
+
+bool stream_next(stream_reader_t *reader, const uint8_t **data, size_t *length) {
+    pthread_mutex_lock(&reader->lock);
+
+    //předchozí blok je zpracovaný, vlákno do něj může číst
+    if (reader->current >= 0) {
+        reader->full[reader->current] = false;
+        reader->current = -1;
+        pthread_cond_broadcast(&reader->changed);
+    }
+
+    int32_t index = reader->next;
+
+    while (!reader->full[index] && !reader->done) {
+        pthread_cond_wait(&reader->changed, &reader->lock);
+    }
+
+    bool ok = reader->full[index];
+    if (ok) {
+        reader->current = index;
+        reader->next = (index + 1) % STREAM_BUFFERS;
+        *data = reader->buffers[index];
+        *length = reader->lengths[index];
+    }
+    pthread_mutex_unlock(&reader->lock);
+    return ok;
+}
+
+bool stream_close(stream_reader_t *reader) {
+    pthread_mutex_lock(&reader->lock);
+    reader->stop = true;
+    pthread_cond_broadcast(&reader->changed);
+    pthread_mutex_unlock(&reader->lock);
+
+    pthread_join(reader->thread, NULL);
+    pthread_mutex_destroy(&reader->lock);
+    pthread_cond_destroy(&reader->changed);
+    for (int32_t i = 0; i < STREAM_BUFFERS; i++) free(reader->buffers[i]);
+    close(reader->fd);
+    return !reader->error && reader->remaining == 0;
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+// Počet bufferů čtecího vlákna - jeden se plní, druhý zpracovává
+#define STREAM_BUFFERS 2
+
+// Čtení hostitelského souboru po blocích pevné velikosti ve vlastním vlákně,
+// takže čtení dalšího bloku se překrývá se zápisem předchozího do fs
+typedef struct {
+    int fd;
+    off_t size;                         //velikost souboru při otevření
+    off_t remaining;                    //kolik bytů ještě zbývá načíst
+    size_t chunk_size;
+    uint8_t *buffers[STREAM_BUFFERS];
+    size_t lengths[STREAM_BUFFERS];
+    bool full[STREAM_BUFFERS];
+    int32_t current;                    //buffer, který právě zpracovává volající, -1 = žádný
+    int32_t next;                       //buffer, který volající dostane příště
+    bool done;                          //čtecí vlákno skončilo (konec souboru nebo chyba)
+    bool error;
+    bool stop;                          //volající končí předčasně
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    pthread_t thread;
+} stream_reader_t;
+
+// Otevře běžný soubor a začne ho číst po blocích chunk_size, false pokud ho nelze otevřít
+bool stream_open(stream_reader_t *reader, const char *path, size_t chunk_size);
+
+// Uvolní předchozí blok a vrátí další načtený, false na konci dat nebo při chybě čtení
+bool stream_next(stream_reader_t *reader, const uint8_t **data, size_t *length);
+
+// Ukončí čtecí vlákno, zavře soubor a uvolní buffery, vrací false pokud se nepřečetl celý soubor
+bool stream_close(stream_reader_t *reader);
@@ -5,6 +5,7 @@
 #include <string.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <stdatomic.h>
 
 
 #define CLUSTER_SIZE 4096
@@ -13,36 +14,127 @@
 #define DIRECT_LINKS 5
 #define SIGNATURE "ZOSFS25"
 #define ID_ITEM_FREE 0
+#define BITMAP_DIRTY_CHUNK 512
 
 
+// kdy se změny metadat zapisují na disk
+typedef enum {
+    SYNC_ALWAYS,                //po každé změně (původní chování)
+    SYNC_COMMAND,               //na konci každého příkazu
+    SYNC_MANUAL                 //pouze příkazem sync a při ukončení
+} sync_policy_t;
+
+// způsob přístupu k souboru s fs
+typedef enum {
+    IO_ENGINE_STDIO,            //fseek + fread/fwrite
+    IO_ENGINE_MMAP              //celý soubor namapovaný do paměti
+} io_engine_t;
+
+
+// verze formátu na disku - ukládá se na místo disk_size formátu 1, který je vždy alespoň 1 MB
+#define FS_VERSION_32 1             //32bitové velikosti a adresy (původní formát)
+#define FS_VERSION_64 2             //64bitové velikosti a adresy
+#define FS_MAX_VERSION_VALUE (1024 * 1024)  //menší hodnota na místě disk_size je číslo verze
+
+// volitelné části formátu FS_VERSION_64 (superblock_t.features)
+#define FS_FEATURE_REFCOUNT 0x1     //tabulka čítačů odkazů na clustery za tabulkou i-uzlů (cp --reflink)
+#define FS_FEATURE_JOURNAL 0x2      //žurnál metadat těsně před datovými bloky
+#define FS_FEATURE_COUNTERS 0x4     //superblok obsahuje počty obsazených clusterů, inodů a adresářů
+
+
+// superblok formátu FS_VERSION_32 (pouze pro načtení a uložení starších obrazů)
+typedef struct {
+    char signature[9];
+    char description[251];
+    int32_t disk_size;
+    int32_t cluster_size;
+    int32_t cluster_count;
+    int32_t inode_count;
+    int32_t bitmapi_start;
+    int32_t bitmap_start;
+    int32_t inode_start;
+    int32_t data_start;
+    int32_t cluster_cursor;
+    int32_t inode_cursor;
+} superblock_v1_t;
+
 typedef struct {
     char signature[9];           //login autora FS
     char description[251];       //popis vygenerovaného FS (cokoliv)
-    int32_t disk_size;          //celkova velikost VFS 
+    int32_t version;            //verze formátu na disku (FS_VERSION_*)
     int32_t cluster_size;       //velikost clusteru
     int32_t cluster_count;      //pocet clusteru
     int32_t inode_count;        //pocet inodů
-    int32_t bitmapi_start;      //adresa pocatku bitmapy i-uzlů
-    int32_t bitmap_start;       //adresa pocatku bitmapy datových bloků
-    int32_t inode_start;        //adresa pocatku  i-uzlů
-    int32_t data_start;         //adresa pocatku datovych bloku  
+    int32_t features;           //volitelné části formátu (FS_FEATURE_*), dříve nevyužité zarovnání
+    int64_t disk_size;          //celkova velikost VFS
+    int64_t bitmapi_start;      //adresa pocatku bitmapy i-uzlů
+    int64_t bitmap_start;       //adresa pocatku bitmapy datových bloků
+    int64_t inode_start;        //adresa pocatku  i-uzlů
+    int64_t data_start;         //adresa pocatku datovych bloku
+    int32_t cluster_cursor;     //next-fit kurzor alokace clusterů
+    int32_t inode_cursor;       //next-fit kurzor alokace inodů
+    int32_t used_clusters;      //obsazené datové clustery (bez rezervovaného clusteru 0)
+    int32_t used_inodes;        //obsazené inody
+    int32_t dir_count;          //počet adresářů
+    int32_t reserved;
 } superblock_t;
 
+// formát mapování clusterů souboru (inode_t.format)
+#define INODE_FORMAT_BLOCKMAP 0     //přímé a nepřímé odkazy (původní formát)
+#define INODE_FORMAT_EXTENTS 'E'    //souvislé úseky clusterů
+#define INLINE_EXTENTS 2            //počet úseků uložených přímo v i-uzlu
+
+
+typedef struct {
+    int32_t logical;            //první index clusteru v souboru
+    int32_t physical;           //první cluster na disku
+    int32_t length;             //počet clusterů, 0 = nepoužitý úsek
+} extent_t;
+
+#define EXTENTS_PER_CLUSTER ((CLUSTER_SIZE - 2 * sizeof(int32_t)) / sizeof(extent_t))
+
+typedef struct {
+    int32_t count;              //počet úseků v clusteru
+    int32_t reserved;
+    extent_t extents[EXTENTS_PER_CLUSTER]; //úseky seřazené podle logical
+} extent_block_t;
+
 typedef struct {
     int32_t nodeid;             //ID i-uzlu, pokud ID = ID_ITEM_FREE, je polozka volna
     bool is_directory;          //soubor, nebo adresar
     int8_t references;          //počet odkazů na i-uzel, používá se pro hardlinky
-    int32_t file_size;          //velikost souboru v bytech
+    uint8_t format;             //formát mapování clusterů, využívá dříve nevyužitou výplň
+    int64_t file_size;          //velikost souboru v bytech
     int32_t parent;             //i-uzel nadřazené složky
-    int32_t direct1;            // 1. přímý odkaz na datové bloky
-    int32_t direct2;            // 2. přímý odkaz na datové bloky
-    int32_t direct3;            // 3. přímý odkaz na datové bloky
-    int32_t direct4;            // 4. přímý odkaz na datové bloky
-    int32_t direct5;            // 5. přímý odkaz na datové bloky
-    int32_t indirect1;          // 1. nepřímý odkaz (odkaz -> datové bloky)
-    int32_t indirect2;          // 2. nepřímý odkaz (odkaz -> odkaz -> datové bloky)
+    union {
+        struct {
+            int32_t direct1;    // 1. přímý odkaz na datové bloky
+            int32_t direct2;    // 2. přímý odkaz na datové bloky
+            int32_t direct3;    // 3. přímý odkaz na datové bloky
+            int32_t direct4;    // 4. přímý odkaz na datové bloky
+            int32_t direct5;    // 5. přímý odkaz na datové bloky
+            int32_t indirect1;  // 1. nepřímý odkaz (odkaz -> datové bloky)
+            int32_t indirect2;  // 2. nepřímý odkaz (odkaz -> odkaz -> datové bloky)
+        };
+        struct {
+            extent_t extents[INLINE_EXTENTS]; //první úseky souboru
+            int32_t extent_tree;              //cluster s dalšími úseky (extent_block_t), 0 = žádný
+        };
+        int32_t map[7];         //mapování jako celek (převod mezi formáty)
+    };
 } inode_t;
 
+// i-uzel formátu FS_VERSION_32 - 32bitová velikost souboru
+typedef struct {
+    int32_t nodeid;
+    bool is_directory;
+    int8_t references;
+    uint8_t format;
+    int32_t file_size;
+    int32_t parent;
+    int32_t map[7];             //stejné mapování jako inode_t.map
+} inode_v1_t;
+
 typedef struct {
     int32_t inode;              // inode odpovídající souboru
     char name[NAME_SIZE];       //8+3 + /0 C/C++ ukoncovaci string znak
@@ -50,11 +142,218 @@ typedef struct {
 
 
 typedef struct {
+    uint64_t *words;            //bity uložené po 64bitových slovech
+    uint64_t *summary;          //1 bit na slovo - slovo obsahuje volný bit
+    int32_t bit_count;          //počet platných bitů
+    int32_t word_count;         //počet slov v poli words
+    int32_t summary_count;      //počet slov v poli summary
+    uint8_t *dirty;             //1 byte na BITMAP_DIRTY_CHUNK bytů bitmapy - úsek změněn
+    int32_t dirty_count;        //počet úseků v poli dirty
+    bool any_dirty;             //bitmapa obsahuje neuložené změny
+    int32_t used;               //počet nastavených platných bitů
+    uint64_t *reserved;         //bity, které hledání bere jako obsazené, ač v bitmapě volné (NULL dokud žádný není)
+    int32_t reserved_count;     //počet rezervovaných bitů
+} bitmap_t;
+
+
+typedef struct cache_entry {
+    int32_t cluster;            //číslo clusteru, -1 pokud je položka volná
+    int32_t pins;               //počet připnutí, připnutou položku nelze vyřadit
+    bool dirty;                 //obsah se liší od disku
+    bool referenced;            //příznak použití pro algoritmus CLOCK
+    struct cache_entry *next;   //další položka v řetězci hashovací tabulky
+    uint8_t *data;              //obsah clusteru
+} cache_entry_t;
+
+typedef struct {
+    cache_entry_t *entries;     //pole položek
+    int32_t capacity;           //počet položek
+    cache_entry_t **buckets;    //hashovací tabulka podle čísla clusteru
+    int32_t bucket_mask;        //počet kyblíků - 1 (mocnina dvou)
+    int32_t hand;               //ručička algoritmu CLOCK
+    uint8_t *memory;            //paměť pro obsah všech položek
+    uint64_t hits;              //počet nalezených clusterů
+    uint64_t misses;            //počet načtení z disku
+    uint64_t evictions;         //počet vyřazených položek
+    uint64_t writebacks;        //počet zapsaných změněných clusterů
+} cluster_cache_t;
+
+typedef struct {
+    uint8_t **chunks;           //načtené úseky tabulky inodů po INODES_PER_CLUSTER inodech, NULL = nenačteno
+    uint8_t *dirty;             //příznak změny úseku
+    int32_t chunk_count;        //počet úseků
+    bool any_dirty;             //tabulka obsahuje neuložené změny
+    bool fresh;                 //nově naformátovaná tabulka, nenačtené úseky jsou prázdné
+    uint8_t *stored;            //u fresh tabulky úsek už je zapsaný na disku a čte se z něj
+    int32_t *order;             //fronta načtených úseků v pořadí načtení (kruhová, chunk_count míst)
+    int32_t order_head;         //začátek fronty
+    int32_t loaded;             //počet načtených úseků
+    uint64_t loads;             //počet čtení tabulky z disku
+    uint64_t evictions;         //počet vyřazených úseků
+} inode_cache_t;
+
+typedef struct {
+    uint16_t **chunks;          //načtené úseky tabulky čítačů po CLUSTER_SIZE bytech, NULL = nenačteno
+    uint8_t *dirty;             //příznak změny úseku
+    int32_t chunk_count;        //počet úseků
+    bool any_dirty;             //tabulka obsahuje neuložené změny
+    bool fresh;                 //nově naformátovaná tabulka, nenačtené úseky jsou prázdné
+} refcount_cache_t;
+
+#define JOURNAL_MAGIC 0x4C4E524A       //"JRNL" - hlavička oblasti žurnálu
+#define JOURNAL_TXN_MAGIC 0x4E58544A   //"JTXN" - hlavička transakce
+
+// hlavička oblasti žurnálu, za ní následuje log transakcí
+typedef struct {
+    uint32_t magic;
+    uint32_t reserved;
+    uint64_t start_seq;         //pořadí první platné transakce na začátku logu
+} journal_super_t;
+
+// hlavička transakce v logu, za ní record_count záznamů
+typedef struct {
+    uint32_t magic;
+    uint32_t record_count;
+    uint64_t seq;               //pořadí transakce, transakce v logu na sebe navazují
+    uint64_t length;            //délka záznamů za hlavičkou
+    uint64_t checksum;          //FNV-1a hlavičky (s checksum = 0) a záznamů
+} journal_txn_t;
+
+// záznam transakce - nový obsah oblasti obrazu, za ním data zarovnaná na 8 bytů
+typedef struct {
+    int64_t offset;             //pozice v obrazu
+    uint32_t length;            //počet bytů dat
+    uint32_t reserved;
+} journal_record_t;
+
+// cluster uvolněný transakcí, která ještě nemusí být trvalá
+typedef struct {
+    int32_t cluster;
+    uint64_t seq;               //pořadí transakce, která cluster uvolnila
+} journal_freed_t;
+
+// zapsaná transakce, která do logu půjde až po fdatasync dat, na která odkazuje
+typedef struct {
+    size_t start;               //začátek záznamů v poli records
+    size_t length;              //délka záznamů
+    int32_t count;              //počet záznamů
+    uint64_t seq;               //pořadí transakce
+    int64_t head;               //vyhrazená pozice v logu
+} journal_deferred_t;
+
+// položka indexu záznamů žurnálu - záznam je zařazen pod každým blokem obrazu, který překrývá
+typedef struct {
+    int64_t block;              //blok obrazu (offset / CLUSTER_SIZE)
+    size_t pos;                 //pozice záznamu v poli records
+    int32_t next;               //další položka v řetězci, -1 = konec
+} journal_index_entry_t;
+
+typedef struct {
+    int64_t start;              //pozice oblasti žurnálu v obrazu
+    int64_t size;               //velikost oblasti včetně hlavičky
+    int64_t head;               //pozice další transakce v logu
+    uint64_t seq;               //pořadí další transakce
+    uint8_t *records;           //záznamy zapsaných, dosud nepřenesených transakcí a za nimi rozpracované transakce
+    size_t length;              //použitá délka pole records
+    size_t capacity;            //velikost pole records
+    size_t pending_start;       //začátek záznamů rozpracované transakce
+    int32_t pending_count;      //počet záznamů rozpracované transakce
+    int32_t group;              //zapsané transakce čekající na společný fdatasync
+    journal_index_entry_t *index; //záznamy v poli records podle bloků obrazu
+    int32_t index_count;
+    int32_t index_capacity;
+    int32_t *index_buckets;     //první položka řetězce podle hashe bloku, -1 = prázdný
+    int32_t index_bucket_mask;
+    int32_t *logged;            //hashovací množina clusterů dat zapsaných v logu od jeho vyprázdnění, -1 = volné místo
+    int32_t logged_count;
+    int32_t logged_mask;        //velikost množiny - 1 (mocnina dvou)
+    journal_deferred_t *deferred; //transakce, které čekají na zápis do logu (vzestupně podle pořadí)
+    int32_t deferred_count;
+    int32_t deferred_capacity;
+    _Atomic bool data_unsynced; //od posledního fdatasync se zapsala data souborů mimo žurnál
+    journal_freed_t *freed;     //uvolněné clustery rezervované v bitmapě dat, dokud nejsou trvalé (chrání je LOCK_ALLOC)
+    int32_t freed_count;
+    int32_t freed_capacity;
+    uint64_t durable;           //transakce s nižším pořadím jsou po fdatasync trvalé
+    uint64_t commits;           //počet zapsaných transakcí
+    uint64_t syncs;             //počet fdatasync
+    uint64_t oversized;         //transakce větší než log, zapsané bez atomicity
+} journal_t;
+
+typedef struct {
+    char name[NAME_SIZE];       //jméno položky
+    int32_t inode;              //inode položky
+    int32_t cluster;            //cluster adresáře s položkou
+    int32_t slot;               //pozice položky v clusteru
+    int32_t next;               //další položka v řetězci kyblíku, -1 = konec
+} dir_index_entry_t;
+
+typedef struct {
+    int32_t cluster;            //cluster adresáře s volnou pozicí
+    int32_t slot;               //volná pozice v clusteru
+} dir_slot_t;
+
+typedef struct dir_index {
+    int32_t dir_inode;          //inode indexovaného adresáře
+    struct dir_index *next;     //další index v řetězci tabulky indexů
+    struct dir_index *lru_prev; //naposledy použité indexy jsou na začátku seznamu
+    struct dir_index *lru_next;
+    size_t bytes;               //velikost započtená do rozpočtu indexů
+    dir_index_entry_t *entries; //pole položek (i smazaných, ty jsou v seznamu free_entry)
+    int32_t entry_capacity;     //velikost pole entries
+    int32_t entry_used;         //počet použitých prvků pole entries
+    int32_t free_entry;         //první nepoužitý prvek pole entries, -1 = žádný
+    int32_t count;              //počet platných položek adresáře
+    int32_t *buckets;           //hashovací tabulka podle jména
+    int32_t bucket_mask;        //počet kyblíků - 1 (mocnina dvou)
+    dir_slot_t *free_slots;     //volné pozice v clusterech adresáře
+    int32_t free_count;         //počet volných pozic
+    int32_t free_capacity;      //velikost pole free_slots
+} dir_index_t;
+
+typedef struct {
+    int32_t parent;             //inode rodičovského adresáře
+    int32_t child;              //nalezený inode, -1 = jméno neexistuje (negativní záznam)
+    char name[NAME_SIZE];       //jméno položky
+    bool valid;                 //záznam je platný
+} dentry_t;
+
+
+// struct zosfs je v zosfs.h neprůhledný zosfs_t
+typedef struct zosfs {
     superblock_t sb;            //superblok
-    uint8_t *inode_bitmap;      //bitmapa inodů
-    uint8_t *data_bitmap;       //bitmapa datových bloků
-    char current_path[256];     //cesta k aktuálnímu adresáři
-    int32_t current_inode;      //inode aktuálního adresáře
+    bitmap_t *inode_bitmap;     //bitmapa inodů
+    bitmap_t *data_bitmap;      //bitmapa datových bloků
+    bool sb_dirty;              //superblok obsahuje neuložené změny
+    sync_policy_t sync_policy;  //politika zápisu změn metadat
+    int32_t journal_group;      //počet transakcí žurnálu na jeden fdatasync
+    bool in_batch;              //běží load --batch, změny se ukládají až na konci dávky
+    cluster_cache_t *cache;     //cache clusterů
+    inode_cache_t *inode_cache; //cache tabulky inodů
+    refcount_cache_t *refcounts; //cache tabulky čítačů odkazů na clustery
+    journal_t *journal;         //žurnál metadat, NULL pokud ho fs nemá
+    dir_index_t **dir_indexes;  //hashovací tabulka indexů adresářů podle inodu
+    dir_index_t *dir_lru;       //naposledy použitý index
+    dir_index_t *dir_lru_tail;  //nejdéle nepoužitý index, vyřazuje se první
+    int32_t dir_index_count;    //počet indexů v paměti
+    size_t dir_index_bytes;     //paměť všech indexů
+    size_t dir_index_budget;    //rozpočet paměti indexů (část -c), používaný index se nevyřazuje
+    dentry_t *dcache;           //cache výsledků hledání (rodič, jméno) -> inode
+    uint64_t dcache_hits;       //počet zásahů cache
+    uint64_t dcache_misses;     //počet výpadků cache
+    struct fs_locks *locks;     //zámky pro souběžné příkazy (locks.h), NULL = jedno vlákno
     char *filename;             //jméno souboru s fs
     FILE *file;                 //soubor s fs
-} filesystem_t;
\ No newline at end of file
+    io_engine_t engine;         //zvolený způsob přístupu k souboru
+    uint8_t *map;               //namapovaný soubor, NULL pokud se nepoužívá mmap
+    size_t map_size;            //velikost namapované oblasti
+    _Atomic uint64_t bytes_read;    //byty přečtené z obrazu (i z mapování a logu žurnálu)
+    _Atomic uint64_t bytes_written; //byty zapsané do obrazu včetně logu žurnálu
+} filesystem_t;
+
+// relace nad fs - každé vlákno příkazů má vlastní aktuální adresář (zosfs_session_t)
+typedef struct zosfs_session {
+    filesystem_t *fs;           //sdílený fs
+    int32_t current_inode;      //inode aktuálního adresáře
+    char current_path[256];     //cesta k aktuálnímu adresáři
+} session_t;
\ No newline at end of file
@@ -0,0 +1,94 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "trace.h"
+
+
+// záznam kruhového bufferu
+typedef struct {
+    _Atomic uint64_t seq;           //pořadí záznamu + 1, 0 = záznam se právě zapisuje
+    uint8_t subsystem;
+    uint8_t level;
+    char message[TRACE_MESSAGE_SIZE];
+} trace_entry_t;
+
+static const char *subsystem_names[TRACE_SUBSYSTEMS] = { "alloc", "dir", "path", "io" };
+static const char *level_names[] = { "off", "error", "info", "debug" };
+
+uint8_t trace_levels[TRACE_SUBSYSTEMS];
+
+static trace_entry_t ring[TRACE_RING_SIZE];
+static _Atomic uint64_t ring_head;          //počet všech zapsaných záznamů
+static uint64_t ring_tail;                  //první dosud nevypsaný záznam
+
+
+void trace_record(int subsystem, int level, const char *format, ...) {
+    //každý zapisovatel si atomicky zabere vlastní pozici, zámek není potřeba
+    uint64_t index = atomic_fetch_add_explicit(&ring_head, 1, memory_order_relaxed);
+    trace_entry_t *entry = &ring[index & (TRACE_RING_SIZE - 1)];
+
+    atomic_store_explicit(&entry->seq, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    entry->subsystem = trace_index(subsystem);
+    entry->level = level;
+    va_list args;
+    va_start(args, format);
+    vsnprintf(entry->message, TRACE_MESSAGE_SIZE, format, args);
+    va_end(args);
+
+    //záznam je kompletní
+    atomic_store_explicit(&entry->seq, index + 1, memory_order_release);
+}
+
+bool trace_set_level(const char *subsystem, int level) {
+    if (level < TRACE_OFF || level > TRACE_DEBUG) return false;
+
+    bool all = strcmp(subsystem, "all") == 0;
+    bool found = all;
+    for (int i = 0; i < TRACE_SUBSYSTEMS; i++) {
+        if (all || strcmp(subsystem, subsystem_names[i]) == 0) {
+            trace_levels[i] = level;
+            found = true;
+        }
+    }
+    return found;
+}
+
+int trace_parse_level(const char *text) {
+    for (int i = TRACE_OFF; i <= TRACE_DEBUG; i++) {
+        if (strcmp(text, level_names[i]) == 0) return i;
+    }
+    if (text[0] >= '0' && text[0] <= '0' + TRACE_DEBUG && text[1] == '\0') return text[0] - '0';
+    return -1;
+}
+
+void trace_dump(void) {
+    uint64_t head = atomic_load_explicit(&ring_head, memory_order_acquire);
+    uint64_t start = ring_tail;
+
+    //starší záznamy už byly přepsány
+    if (head - start > TRACE_RING_SIZE) {
+        printf("... %llu records overwritten\n", (unsigned long long)(head - start - TRACE_RING_SIZE));
+        start = head - TRACE_RING_SIZE;
+    }
+
+    for (uint64_t i = start; i < head; i++) {
+        trace_entry_t *entry = &ring[i & (TRACE_RING_SIZE - 1)];
+        if (atomic_load_explicit(&entry->seq, memory_order_acquire) != i + 1) continue;
+
+        trace_entry_t copy;
+        copy.subsystem = entry->subsystem;
+        copy.level = entry->level;
+        memcpy(copy.message, entry->message, TRACE_MESSAGE_SIZE);
+
+        //záznam přepsaný během kopírování se vynechá
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&entry->seq, memory_order_relaxed) != i + 1) continue;
+
+        copy.message[TRACE_MESSAGE_SIZE - 1] = '\0';
+        printf("[%s:%s] %s\n", subsystem_names[copy.subsystem], level_names[copy.level], copy.message);
+    }
+    ring_tail = head;
+}
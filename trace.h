@@ -0,0 +1,54 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+
+// Subsystémy trasování (bitová maska)
+#define TRACE_ALLOC 0x1             //alokace a mapování clusterů
+#define TRACE_DIR 0x2               //hledání a změny v adresářích
+#define TRACE_PATH 0x4              //překlad cest
+#define TRACE_IO 0x8                //přenosy dat mezi obrazem a hostitelem
+#define TRACE_SUBSYSTEMS 4
+
+// Subsystémy, jejichž body trasování se vůbec přeloží, např. make TRACE_FLAGS=-DTRACE_COMPILED=0
+#ifndef TRACE_COMPILED
+#define TRACE_COMPILED (TRACE_ALLOC | TRACE_DIR | TRACE_PATH | TRACE_IO)
+#endif
+
+// Úrovně trasování, záznam se uloží, pokud je jeho úroveň nejvýše nastavená úroveň subsystému
+#define TRACE_OFF 0
+#define TRACE_ERROR 1               //selhání operace
+#define TRACE_INFO 2                //jednotlivé operace
+#define TRACE_DEBUG 3               //podrobnosti uvnitř operací
+
+// Počet záznamů kruhového bufferu (mocnina dvou) a nejdelší text záznamu
+#define TRACE_RING_SIZE 4096
+#define TRACE_MESSAGE_SIZE 112
+
+// aktuální úroveň každého subsystému, výchozí je TRACE_OFF
+extern uint8_t trace_levels[TRACE_SUBSYSTEMS];
+
+// Bod trasování - u nepřeloženého subsystému nezbyde žádný kód, u vypnutého jen porovnání úrovně,
+// argumenty se formátují až po kontrole
+#define TRACE(subsystem, level, ...) do { \
+        if ((TRACE_COMPILED & (subsystem)) && trace_levels[trace_index(subsystem)] >= (level)) { \
+            trace_record((subsystem), (level), __VA_ARGS__); \
+        } \
+    } while (0)
+
+// index subsystému v poli trace_levels
+static inline int trace_index(int subsystem) {
+    return subsystem == TRACE_ALLOC ? 0 : subsystem == TRACE_DIR ? 1 : subsystem == TRACE_PATH ? 2 : 3;
+}
+
+// Zapíše naformátovaný záznam do kruhového bufferu (bez zámku, lze volat z více vláken)
+void trace_record(int subsystem, int level, const char *format, ...) __attribute__((format(printf, 3, 4)));
+
+// Nastaví úroveň subsystému podle jména (alloc, dir, path, io, all), false pro neznámé jméno
+bool trace_set_level(const char *subsystem, int level);
+
+// Převede jméno (off, error, info, debug) nebo číslo úrovně, -1 pro neplatnou úroveň
+int trace_parse_level(const char *text);
+
+// Vypíše uložené záznamy od nejstaršího a buffer vyprázdní
+void trace_dump(void);
@@ -0,0 +1,802 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "structs.h"
+#include "zosfs.h"
+#include "filesystem.h"
+#include "inodes.h"
+#include "clusters.h"
+#include "refcount.h"
+#include "journal.h"
+#include "cache.h"
+#include "dirindex.h"
+#include "dcache.h"
+#include "locks.h"
+#include "trace.h"
+
+//zosfs_dirent_t se plní přímo ze záznamů adresáře
+_Static_assert(ZOSFS_NAME_SIZE == NAME_SIZE, "ZOSFS_NAME_SIZE != NAME_SIZE");
+
+
+void zosfs_default_options(zosfs_options_t *options) {
+    options->sync_policy = ZOSFS_SYNC_COMMAND;
+    options->cache_size = DEFAULT_CACHE_SIZE;
+    options->engine = ZOSFS_ENGINE_STDIO;
+    options->journal_group = JOURNAL_GROUP;
+}
+
+// otevření obrazu do vynulovaného fs, při chybě (kromě ZOSFS_ENOTFORMATTED) nezůstane nic otevřené
+static zosfs_status_t mount_image(filesystem_t *fs, const char *image, const zosfs_options_t *options, zosfs_mount_info_t *info) {
+    fs->filename = (char *)image;
+    fs->sync_policy = options->sync_policy == ZOSFS_SYNC_ALWAYS ? SYNC_ALWAYS
+                    : options->sync_policy == ZOSFS_SYNC_MANUAL ? SYNC_MANUAL : SYNC_COMMAND;
+    fs->journal_group = options->journal_group;
+    fs->engine = options->engine == ZOSFS_ENGINE_MMAP ? IO_ENGINE_MMAP : IO_ENGINE_STDIO;
+    fs->dir_index_budget = options->cache_size / DIR_INDEX_BUDGET_SHARE;
+
+    //pokus o otevření nebo vytvoření souboru
+    fs->file = fopen(image, "r+b");
+    if (!fs->file) {
+        fs->file = fopen(image, "w+b");
+        if (!fs->file) return ZOSFS_EIO;
+        info->created = true;
+    }
+
+    //vlákna sdílí fs, veškerý přístup k souboru je pozicovaný
+    if (!locks_init(fs)) {
+        fclose(fs->file);
+        fs->file = NULL;
+        return ZOSFS_ENOMEM;
+    }
+    //u mmap slouží jako cache samotné mapování
+    if (fs->engine == IO_ENGINE_STDIO) {
+        fs->cache = cache_create(options->cache_size - fs->dir_index_budget);
+    }
+
+    //soubor menší než superblock nemůže být validní fs
+    if (host_file_size(fs) < (int64_t)sizeof(superblock_t)) return ZOSFS_ENOTFORMATTED;
+    zosfs_status_t status = load_superblock(fs, &info->version);
+    if (status != ZOSFS_OK) {
+        info->unsupported = status == ZOSFS_ENOTSUP;
+        return ZOSFS_ENOTFORMATTED;
+    }
+
+    //dokončení transakcí přerušených pádem, mohly změnit i superblok
+    info->replayed = journal_open(fs);
+    if (info->replayed < 0) {
+        //neuložené změny z přehrávání se zahodí, log zůstane pro další pokus
+        cache_destroy(fs->cache);
+        locks_destroy(fs);
+        fclose(fs->file);
+        fs->file = NULL;
+        return ZOSFS_EIO;
+    }
+    if (info->replayed > 0) load_superblock(fs, NULL);
+    load_bitmaps(fs);
+    if (fs->engine == IO_ENGINE_MMAP && !map_image(fs, image_size(fs))) {
+        info->mmap_failed = true;
+        fs->engine = IO_ENGINE_STDIO;
+        fs->cache = cache_create(options->cache_size - fs->dir_index_budget);
+    }
+    inode_cache_init(fs, false);
+    refcount_init(fs, false);
+    verify_counters(fs);
+    return ZOSFS_OK;
+}
+
+zosfs_status_t zosfs_mount(const char *image, const zosfs_options_t *options, zosfs_t **fs, zosfs_mount_info_t *info) {
+    zosfs_mount_info_t unused;
+    if (!info) info = &unused;
+    memset(info, 0, sizeof(*info));
+    *fs = NULL;
+
+    if (options->sync_policy > ZOSFS_SYNC_MANUAL || options->engine > ZOSFS_ENGINE_MMAP ||
+        options->journal_group < 1) return ZOSFS_EINVAL;
+    filesystem_t *mounted = calloc(1, sizeof(filesystem_t));
+    if (!mounted) return ZOSFS_ENOMEM;
+
+    zosfs_status_t status = mount_image(mounted, image, options, info);
+    if (status != ZOSFS_OK && status != ZOSFS_ENOTFORMATTED) {
+        free(mounted);
+        return status;
+    }
+    *fs = mounted;
+    return status;
+}
+
+void zosfs_unmount(filesystem_t *fs) {
+    if (!fs) return;
+
+    sync_fs(fs);
+    journal_close(fs);
+
+    bitmap_destroy(fs->inode_bitmap);
+    bitmap_destroy(fs->data_bitmap);
+    cache_destroy(fs->cache);
+    inode_cache_free(fs);
+    refcount_free(fs);
+    dir_index_clear(fs);
+    dcache_clear(fs);
+    unmap_image(fs);
+    locks_destroy(fs);
+    fclose(fs->file);
+    free(fs);
+}
+
+zosfs_status_t zosfs_session_open(filesystem_t *fs, session_t **session) {
+    *session = malloc(sizeof(session_t));
+    if (!*session) return ZOSFS_ENOMEM;
+    (*session)->fs = fs;
+    (*session)->current_inode = 0;
+    strcpy((*session)->current_path, "/");
+    return ZOSFS_OK;
+}
+
+void zosfs_session_close(session_t *session) {
+    free(session);
+}
+
+zosfs_status_t zosfs_format(session_t *session, int64_t size) {
+    filesystem_t *fs = session->fs;
+    //čísla clusterů jsou 32bitová
+    if (size < CLUSTER_SIZE || size / CLUSTER_SIZE > INT32_MAX) return ZOSFS_EINVAL;
+
+    int32_t cluster_count = size / CLUSTER_SIZE;
+    int32_t inode_count = cluster_count / 8;
+
+    int64_t ibitmap_size = (inode_count + 7) / 8;
+    int64_t dbitmap_size = ((int64_t)cluster_count + 7) / 8;
+    int64_t inode_table_size = (int64_t)inode_count * sizeof(inode_t);
+
+    memset(&fs->sb, 0, sizeof(superblock_t));
+    strcpy(fs->sb.signature, SIGNATURE);
+    strcpy(fs->sb.description, "ZOS Inodesystem");
+    fs->sb.version = FS_VERSION_64;
+    fs->sb.disk_size = size;
+    fs->sb.cluster_size = CLUSTER_SIZE;
+    fs->sb.cluster_count = cluster_count;
+    fs->sb.inode_count = inode_count;
+
+    //obsah cache a indexy adresářů patří k předchozímu FS
+    cache_invalidate(fs);
+    dir_index_clear(fs);
+    dcache_clear(fs);
+
+    int64_t offset = sizeof(superblock_t);
+    fs->sb.bitmapi_start = offset; offset += ibitmap_size;
+    fs->sb.bitmap_start = offset; offset += dbitmap_size;
+    fs->sb.inode_start = offset; offset += inode_table_size;
+    //tabulka čítačů odkazů pro sdílené clustery (cp --reflink)
+    fs->sb.features = FS_FEATURE_REFCOUNT | FS_FEATURE_JOURNAL | FS_FEATURE_COUNTERS;
+    offset += refcount_table_size(cluster_count);
+    //žurnál metadat těsně před daty
+    offset += journal_region_size(cluster_count);
+    fs->sb.data_start = offset;
+
+    //soubor odpovídá nové velikosti fs (řídký soubor, nezapsané clustery nezabírají místo)
+    if (!resize_image(fs, image_size(fs))) return ZOSFS_EIO;
+    //superblok a hlavička žurnálu jdou na disk hned, zbytek formátování je už první transakcí
+    if (!journal_format(fs)) return ZOSFS_EIO;
+    inode_cache_init(fs, true);
+    refcount_init(fs, true);
+
+    bitmap_destroy(fs->inode_bitmap);
+    bitmap_destroy(fs->data_bitmap);
+
+    // vytvoření bitmap
+    fs->inode_bitmap = bitmap_create(inode_count);
+    fs->data_bitmap = bitmap_create(cluster_count);
+    //cluster 0 je rezervován pro "null" ukazatel
+    set_bit(fs->data_bitmap, 0);
+    save_bitmaps(fs);
+
+    // vytvoření root adresáře
+    int32_t root_id = alloc_inode(fs);
+    if (root_id < 0) return ZOSFS_ENOSPC;
+
+    inode_t root = {0};
+    root.nodeid = root_id;
+    root.is_directory = true;
+    root.references = 1;
+    init_file_map(&root);
+    root.parent = root_id;
+
+    if (!write_inode(fs, root_id, &root)) return ZOSFS_EIO;
+    directory_count_changed(fs, 1);
+
+    //bitmapy a root musí být trvalé nezávisle na politice synchronizace
+    sync_fs(fs);
+    if (!journal_checkpoint(fs)) return ZOSFS_EIO;
+
+    session->current_inode = root_id;
+    strcpy(session->current_path, "/");
+    return ZOSFS_OK;
+}
+
+zosfs_status_t zosfs_sync(filesystem_t *fs) {
+    sync_fs(fs);
+    return journal_checkpoint(fs) ? ZOSFS_OK : ZOSFS_EIO;
+}
+
+zosfs_status_t zosfs_chdir(session_t *session, const char *path) {
+    if (!path || !path[0]) return ZOSFS_ENOENT;
+    if (strcmp(path, "/") == 0) {  // jedná se o root složku
+        session->current_inode = 0;
+        strcpy(session->current_path, "/");
+        return ZOSFS_OK;
+    }
+
+    // hledání cílové složky
+    int32_t target_inode = resolve_path(session->fs, session->current_inode, path);
+    if (target_inode < 0) return ZOSFS_ENOENT;
+
+    // test, jestli se vůbec jedná o složku
+    inode_t target;
+    if (!read_inode(session->fs, target_inode, &target)) return ZOSFS_EIO;
+    if (!target.is_directory) return ZOSFS_ENOTDIR;
+
+    // absolutní cesta, začínáme od rootu
+    if (path[0] == '/') {
+        strcpy(session->current_path, "/");
+    }
+
+    char path_copy[256] = {0};
+    strncpy(path_copy, path, sizeof(path_copy) - 1);
+
+    //strtok_r - stav rozdělování je lokální, vlákna se navzájem neruší
+    char *saveptr;
+    char *token = strtok_r(path_copy, "/", &saveptr);
+    while (token != NULL) {
+        // aktualizace cesty po zpracování každého tokenu
+        update_path(session->current_path, token);
+        token = strtok_r(NULL, "/", &saveptr);
+    }
+
+    session->current_inode = target_inode;
+    return ZOSFS_OK;
+}
+
+// najde a sdíleně zamkne i-uzel cesty
+static zosfs_status_t lock_path(session_t *session, const char *path, inode_lock_set_t *locks, int32_t *inode_id) {
+    if (!path || !path[0]) return ZOSFS_ENOENT;
+    *inode_id = resolve_path(session->fs, session->current_inode, path);
+    if (*inode_id < 0) return ZOSFS_ENOENT;
+
+    lock_set_init(locks);
+    lock_set_add(locks, *inode_id, false);
+    return lock_set_acquire_checked(session->fs, locks) ? ZOSFS_OK : ZOSFS_ENOENT;
+}
+
+zosfs_status_t zosfs_open(session_t *session, const char *path, zosfs_file_t *file) {
+    inode_lock_set_t locks;
+    int32_t inode_id;
+    zosfs_status_t status = lock_path(session, path, &locks, &inode_id);
+    if (status != ZOSFS_OK) return status;
+
+    inode_t inode;
+    if (!read_inode(session->fs, inode_id, &inode)) status = ZOSFS_EIO;
+    else if (inode.is_directory) status = ZOSFS_EISDIR;
+    else file->inode = inode_id;
+    lock_set_release(session->fs, &locks);
+    return status;
+}
+
+// vytvoří soubor nebo adresář name v zamčeném adresáři parent
+static zosfs_status_t create_locked(filesystem_t *fs, int32_t parent, const char *name, bool directory, int32_t *out_inode) {
+    if (find_in_dir(fs, parent, name) >= 0) return ZOSFS_EEXIST;
+
+    int32_t new_inode_id = alloc_inode(fs);
+    if (new_inode_id < 0) return ZOSFS_ENOSPC;
+
+    inode_t new_inode = {0};
+    new_inode.nodeid = new_inode_id;
+    new_inode.is_directory = directory;
+    new_inode.references = 1;
+    init_file_map(&new_inode);
+    new_inode.file_size = 0;
+    if (directory) new_inode.parent = parent;
+    write_inode(fs, new_inode_id, &new_inode);
+    if (directory) directory_count_changed(fs, 1);
+
+    //adresář se nemusel dát prodloužit
+    if (!add_to_dir(fs, parent, name, new_inode_id)) {
+        if (directory) directory_count_changed(fs, -1);
+        free_inode(fs, new_inode_id);
+        return ZOSFS_ENOSPC;
+    }
+
+    TRACE(TRACE_DIR, TRACE_INFO, "create: '%s' -> inode %d in %d%s", name, new_inode_id, parent, directory ? " (dir)" : "");
+    *out_inode = new_inode_id;
+    return ZOSFS_OK;
+}
+
+// najde rodičovský adresář cesty a výhradně ho zamkne
+static zosfs_status_t lock_parent(session_t *session, const char *path, inode_lock_set_t *locks,
+                                  int32_t *parent, char *name) {
+    if (!path || !path[0]) return ZOSFS_EINVAL;
+    if (!split_path(session->fs, session->current_inode, path, parent, name)) return ZOSFS_ENOENT;
+
+    lock_set_init(locks);
+    lock_set_add(locks, *parent, true);
+    return lock_set_acquire_checked(session->fs, locks) ? ZOSFS_OK : ZOSFS_ENOENT;
+}
+
+zosfs_status_t zosfs_create(session_t *session, const char *path, zosfs_file_t *file) {
+    inode_lock_set_t locks;
+    int32_t parent;
+    char name[NAME_SIZE];
+    zosfs_status_t status = lock_parent(session, path, &locks, &parent, name);
+    if (status != ZOSFS_OK) return status;
+
+    status = create_locked(session->fs, parent, name, false, &file->inode);
+    lock_set_release(session->fs, &locks);
+    return status;
+}
+
+zosfs_status_t zosfs_mkdir(session_t *session, const char *path) {
+    inode_lock_set_t locks;
+    int32_t parent, inode_id;
+    char name[NAME_SIZE];
+    zosfs_status_t status = lock_parent(session, path, &locks, &parent, name);
+    if (status != ZOSFS_OK) return status;
+
+    status = create_locked(session->fs, parent, name, true, &inode_id);
+    lock_set_release(session->fs, &locks);
+    return status;
+}
+
+// čtení zamčeného souboru
+static zosfs_status_t read_locked(filesystem_t *fs, int32_t inode_id, int64_t offset, uint8_t *buffer, size_t size, size_t *done) {
+    inode_t inode;
+    if (!read_inode(fs, inode_id, &inode)) return ZOSFS_EIO;
+    if (inode.is_directory) return ZOSFS_EISDIR;
+    if (offset >= inode.file_size) return ZOSFS_OK;
+    if ((int64_t)size > inode.file_size - offset) size = inode.file_size - offset;
+
+    int32_t cluster_size = fs->sb.cluster_size;
+    uint8_t block[CLUSTER_SIZE];
+    size_t pos = 0;
+    while (pos < size) {
+        int64_t at = offset + pos;
+        int32_t index = at / cluster_size;
+        int32_t within = at % cluster_size;
+        //celé clustery nejvýše do konce požadované oblasti
+        int32_t max = (size - pos) / cluster_size;
+        if (max > IO_RUN_CLUSTERS) max = IO_RUN_CLUSTERS;
+        int32_t count;
+        int32_t cluster = get_file_run(fs, &inode, index, max > 0 ? max : 1, &count);
+        if (cluster < 0) return ZOSFS_EIO;
+
+        //začátek nebo konec uprostřed clusteru - přes pomocný buffer
+        if (within != 0 || max == 0) {
+            size_t bytes = cluster_size - within;
+            if (bytes > size - pos) bytes = size - pos;
+            if (cluster == 0) {
+                memset(buffer + pos, 0, bytes);
+            } else {
+                if (!read_cluster(fs, cluster, block)) return ZOSFS_EIO;
+                memcpy(buffer + pos, block + within, bytes);
+            }
+            pos += bytes;
+            *done = pos;
+            continue;
+        }
+
+        //celé fyzicky navazující clustery jedním voláním přímo do bufferu volajícího
+        size_t bytes = (size_t)count * cluster_size;
+        if (cluster == 0) memset(buffer + pos, 0, bytes);
+        else if (!read_clusters(fs, cluster, count, buffer + pos, bytes)) return ZOSFS_EIO;
+        pos += bytes;
+        *done = pos;
+    }
+    return ZOSFS_OK;
+}
+
+zosfs_status_t zosfs_read(filesystem_t *fs, const zosfs_file_t *file, int64_t offset, void *buffer, size_t size, size_t *done) {
+    *done = 0;
+    if (offset < 0) return ZOSFS_EINVAL;
+
+    //soubor se čte sdíleně, souběžné čtení ostatních vláken nečeká
+    inode_lock_set_t locks;
+    lock_set_init(&locks);
+    lock_set_add(&locks, file->inode, false);
+    if (!lock_set_acquire_checked(fs, &locks)) return ZOSFS_ENOENT;
+
+    zosfs_status_t status = read_locked(fs, file->inode, offset, buffer, size, done);
+    lock_set_release(fs, &locks);
+    return status;
+}
+
+// přepis již namapovaných clusterů zamčeného souboru od offset, vrací počet zapsaných bytů v *pos
+static zosfs_status_t overwrite_clusters(filesystem_t *fs, inode_t *inode, int32_t old_clusters,
+                                         int64_t offset, const uint8_t *data, size_t size, size_t *pos) {
+    int32_t cluster_size = fs->sb.cluster_size;
+    uint8_t block[CLUSTER_SIZE];
+
+    for (int32_t index = offset / cluster_size; index < old_clusters && *pos < size; index++) {
+        int32_t within = offset + *pos - (int64_t)index * cluster_size;
+        size_t bytes = cluster_size - within;
+        if (bytes > size - *pos) bytes = size - *pos;
+
+        //sdílený cluster (reflink) dostane vlastní kopii
+        int32_t cluster = own_file_cluster(fs, inode, index);
+        if (cluster < 0) return ZOSFS_ENOSPC;
+        if (cluster == 0) {
+            cluster = alloc_cluster(fs);
+            if (cluster < 0) return ZOSFS_ENOSPC;
+            if (set_file_cluster(fs, inode, index, cluster) < 0) {
+                free_cluster(fs, cluster);
+                return ZOSFS_ENOSPC;
+            }
+            memset(block, 0, cluster_size);
+        } else if (bytes < (size_t)cluster_size && !read_cluster(fs, cluster, block)) {
+            return ZOSFS_EIO;
+        }
+
+        const void *source = data + *pos;
+        if (bytes < (size_t)cluster_size) {
+            memcpy(block + within, data + *pos, bytes);
+            source = block;
+        }
+        if (!write_cluster(fs, cluster, source)) return ZOSFS_EIO;
+        *pos += bytes;
+    }
+    return ZOSFS_OK;
+}
+
+// prodloužení zamčeného souboru o clustery do end_clusters, data leží v souboru od offset do end,
+// vrací v *mapped_end konec namapovaných dat
+static zosfs_status_t extend_clusters(filesystem_t *fs, inode_t *inode, int32_t old_clusters, int32_t end_clusters,
+                                      int64_t offset, int64_t end, const uint8_t *data, int64_t *mapped_end) {
+    int32_t cluster_size = fs->sb.cluster_size;
+
+    //nové clustery pokud možno hned za posledním clusterem souboru
+    int32_t last = old_clusters > 0 ? get_file_cluster(fs, inode, old_clusters - 1) : 0;
+    cluster_run_t *runs = NULL;
+    int32_t run_count = alloc_clusters(fs, end_clusters - old_clusters, last > 0 ? last + 1 : 0, &runs);
+    if (run_count < 0) return ZOSFS_ENOSPC;
+
+    uint8_t *buffer = malloc(IO_RUN_CLUSTERS * cluster_size);
+    zosfs_status_t status = buffer ? ZOSFS_OK : ZOSFS_ENOMEM;
+    int32_t index = old_clusters;
+    for (int32_t r = 0; r < run_count; r++) {
+        for (int32_t done = 0; done < runs[r].length; ) {
+            int32_t count = runs[r].length - done;
+            if (count > IO_RUN_CLUSTERS) count = IO_RUN_CLUSTERS;
+
+            if (status == ZOSFS_OK) {
+                //mezera před offset zůstane vynulovaná
+                int64_t chunk_start = (int64_t)index * cluster_size;
+                int64_t chunk_end = chunk_start + (int64_t)count * cluster_size;
+                int64_t from = offset > chunk_start ? offset : chunk_start;
+                int64_t to = end < chunk_end ? end : chunk_end;
+                memset(buffer, 0, (size_t)count * cluster_size);
+                if (from < to) memcpy(buffer + (from - chunk_start), data + (from - offset), to - from);
+
+                if (!write_clusters(fs, runs[r].start + done, count, buffer, (size_t)count * cluster_size)) {
+                    status = ZOSFS_EIO;
+                } else if (set_file_run(fs, inode, index, runs[r].start + done, count) != 0) {
+                    status = ZOSFS_ENOSPC;
+                } else {
+                    index += count;
+                    *mapped_end = to > chunk_start ? to : chunk_end;
+                }
+            }
+            //po chybě se nenamapované clustery hned vrátí
+            if (status != ZOSFS_OK) {
+                for (int32_t i = 0; i < count; i++) free_cluster(fs, runs[r].start + done + i);
+            }
+            done += count;
+        }
+    }
+
+    free(runs);
+    free(buffer);
+    return status;
+}
+
+// zápis do zamčeného souboru
+static zosfs_status_t write_locked(filesystem_t *fs, int32_t inode_id, int64_t offset, const uint8_t *data, size_t size, size_t *done) {
+    inode_t inode;
+    if (!read_inode(fs, inode_id, &inode)) return ZOSFS_EIO;
+    if (inode.is_directory) return ZOSFS_EISDIR;
+    if (size == 0) return ZOSFS_OK;
+
+    int32_t cluster_size = fs->sb.cluster_size;
+    //obrazy formátu 1 mají v i-uzlu jen 32bitovou velikost, indexy clusterů jsou 32bitové
+    if ((int64_t)size > max_file_size(fs) - offset) return ZOSFS_EFBIG;
+    int64_t end = offset + size;
+    if ((end + cluster_size - 1) / cluster_size > INT32_MAX) return ZOSFS_EFBIG;
+
+    int32_t old_clusters = (inode.file_size + cluster_size - 1) / cluster_size;
+    int32_t end_clusters = (end + cluster_size - 1) / cluster_size;
+
+    size_t pos = 0;
+    int64_t mapped_end = 0;
+    zosfs_status_t status = overwrite_clusters(fs, &inode, old_clusters, offset, data, size, &pos);
+    if (status == ZOSFS_OK && end_clusters > old_clusters) {
+        status = extend_clusters(fs, &inode, old_clusters, end_clusters, offset, end, data, &mapped_end);
+        if (mapped_end > offset) pos = mapped_end - offset;
+    }
+
+    //soubor se prodlouží o zapsaná data (i při chybě), namapované nuly za koncem také patří k souboru
+    int64_t new_size = pos > 0 ? offset + (int64_t)pos : 0;
+    if (mapped_end > new_size) new_size = mapped_end;
+    if (new_size > inode.file_size) inode.file_size = new_size;
+    if (!write_inode(fs, inode_id, &inode) && status == ZOSFS_OK) status = ZOSFS_EIO;
+
+    *done = pos;
+    return status;
+}
+
+zosfs_status_t zosfs_write(filesystem_t *fs, const zosfs_file_t *file, int64_t offset, const void *buffer, size_t size, size_t *done) {
+    size_t unused;
+    if (!done) done = &unused;
+    *done = 0;
+    if (offset < 0) return ZOSFS_EINVAL;
+
+    inode_lock_set_t locks;
+    lock_set_init(&locks);
+    lock_set_add(&locks, file->inode, true);
+    if (!lock_set_acquire_checked(fs, &locks)) return ZOSFS_ENOENT;
+
+    zosfs_status_t status = write_locked(fs, file->inode, offset, buffer, size, done);
+    lock_set_release(fs, &locks);
+    return status;
+}
+
+// čtení položek zamčeného adresáře od pozice *cursor
+static zosfs_status_t readdir_locked(filesystem_t *fs, int32_t dir_id, int32_t *cursor,
+                                     zosfs_dirent_t *entries, int32_t capacity, int32_t *count) {
+    inode_t dir_inode;
+    if (!read_inode(fs, dir_id, &dir_inode)) return ZOSFS_EIO;
+    if (!dir_inode.is_directory) return ZOSFS_ENOTDIR;
+
+    TRACE(TRACE_DIR, TRACE_INFO, "readdir: inode %d, %lld bytes, from %d", dir_id, (long long)dir_inode.file_size, *cursor);
+
+    int32_t cluster_count = (dir_inode.file_size + fs->sb.cluster_size - 1) / fs->sb.cluster_size;
+
+    dir_item_t items[ENTRIES_PER_CLUSTER];
+    int32_t loaded = -1;
+    while (*count < capacity && *cursor < cluster_count * (int32_t)ENTRIES_PER_CLUSTER) {
+        int32_t index = *cursor / ENTRIES_PER_CLUSTER;
+        if (index != loaded) {
+            int32_t cluster = get_file_cluster(fs, &dir_inode, index);
+            if (cluster < 0) return ZOSFS_EIO;
+            //nenamapovaný cluster adresáře se přeskočí
+            if (cluster == 0) {
+                *cursor = (index + 1) * ENTRIES_PER_CLUSTER;
+                continue;
+            }
+            if (!read_cluster(fs, cluster, items)) return ZOSFS_EIO;
+            loaded = index;
+
+            //úseky tabulky s inody položek clusteru se načtou najednou
+            int32_t ids[ENTRIES_PER_CLUSTER], id_count = 0;
+            for (int32_t i = 0; i < (int32_t)ENTRIES_PER_CLUSTER; i++) {
+                if (items[i].inode != 0) ids[id_count++] = items[i].inode;
+            }
+            inode_cache_load(fs, ids, id_count);
+        }
+
+        dir_item_t *item = &items[*cursor % ENTRIES_PER_CLUSTER];
+        (*cursor)++;
+        if (item->inode == 0) continue;
+
+        inode_t entry_inode;
+        if (!read_inode(fs, item->inode, &entry_inode)) return ZOSFS_EIO;
+        zosfs_dirent_t *entry = &entries[(*count)++];
+        memcpy(entry->name, item->name, NAME_SIZE);
+        entry->name[NAME_SIZE - 1] = '\0';
+        entry->inode = item->inode;
+        entry->is_directory = entry_inode.is_directory;
+    }
+    return ZOSFS_OK;
+}
+
+zosfs_status_t zosfs_readdir(session_t *session, const char *path, int32_t *cursor,
+                             zosfs_dirent_t *entries, int32_t capacity, int32_t *count) {
+    *count = 0;
+    if (*cursor < 0 || capacity < 0) return ZOSFS_EINVAL;
+
+    //bez cesty aktuální adresář
+    int32_t dir_id = session->current_inode;
+    inode_lock_set_t locks;
+    zosfs_status_t status;
+    if (path && path[0]) {
+        status = lock_path(session, path, &locks, &dir_id);
+    } else {
+        lock_set_init(&locks);
+        lock_set_add(&locks, dir_id, false);
+        status = lock_set_acquire_checked(session->fs, &locks) ? ZOSFS_OK : ZOSFS_ENOENT;
+    }
+    if (status != ZOSFS_OK) return status;
+
+    status = readdir_locked(session->fs, dir_id, cursor, entries, capacity, count);
+    lock_set_release(session->fs, &locks);
+    return status;
+}
+
+zosfs_status_t zosfs_stat(session_t *session, const char *path, zosfs_stat_t *stat) {
+    inode_lock_set_t locks;
+    int32_t inode_id;
+    zosfs_status_t status = lock_path(session, path, &locks, &inode_id);
+    if (status != ZOSFS_OK) return status;
+
+    inode_t inode;
+    if (read_inode(session->fs, inode_id, &inode)) {
+        int32_t cluster_size = session->fs->sb.cluster_size;
+        stat->inode = inode_id;
+        stat->is_directory = inode.is_directory;
+        stat->size = inode.file_size;
+        stat->clusters = (inode.file_size + cluster_size - 1) / cluster_size;
+        stat->references = inode.references;
+    } else {
+        status = ZOSFS_EIO;
+    }
+    lock_set_release(session->fs, &locks);
+    return status;
+}
+
+void zosfs_statfs(filesystem_t *fs, zosfs_statfs_t *stat) {
+    //počty se udržují při alokaci, nic se neprochází
+    fs_lock(fs, LOCK_ALLOC);
+    stat->used_inodes = bitmap_used(fs->inode_bitmap);
+    stat->used_clusters = bitmap_used(fs->data_bitmap) - 1;
+    stat->dir_count = fs->sb.dir_count;
+    fs_unlock(fs, LOCK_ALLOC);
+
+    stat->disk_size = fs->sb.disk_size;
+    stat->cluster_size = fs->sb.cluster_size;
+    stat->cluster_count = fs->sb.cluster_count - 1;
+    stat->free_clusters = stat->cluster_count - stat->used_clusters;
+    stat->inode_count = fs->sb.inode_count;
+    stat->free_inodes = fs->sb.inode_count - stat->used_inodes;
+}
+
+void zosfs_io_stats(filesystem_t *fs, zosfs_io_stats_t *stats) {
+    stats->bytes_read = atomic_load_explicit(&fs->bytes_read, memory_order_relaxed);
+    stats->bytes_written = atomic_load_explicit(&fs->bytes_written, memory_order_relaxed);
+    stats->syncs = 0;
+    if (fs->journal) {
+        fs_rwlock(fs, RWLOCK_JOURNAL, false);
+        stats->syncs = fs->journal->syncs;
+        fs_rwunlock(fs, RWLOCK_JOURNAL);
+    }
+}
+
+// najde mazaný i-uzel a jeho rodičovský adresář a oba výhradně zamkne
+static zosfs_status_t lock_remove(session_t *session, const char *path, inode_lock_set_t *locks,
+                                  int32_t *inode_id, int32_t *parent_inode, char *name) {
+    filesystem_t *fs = session->fs;
+    if (!path || !path[0]) return ZOSFS_ENOENT;
+
+    //nemůže se jednat o root adresář
+    *inode_id = resolve_path(fs, session->current_inode, path);
+    if (*inode_id <= 0 || !split_path(fs, session->current_inode, path, parent_inode, name)) return ZOSFS_ENOENT;
+
+    lock_set_init(locks);
+    lock_set_add(locks, *parent_inode, true);
+    lock_set_add(locks, *inode_id, true);
+    return lock_set_acquire_checked(fs, locks) ? ZOSFS_OK : ZOSFS_ENOENT;
+}
+
+// smazání zamčeného souboru nebo prázdného adresáře
+static zosfs_status_t remove_locked(filesystem_t *fs, int32_t inode_id, int32_t parent_inode, const char *name, bool directory) {
+    inode_t inode;
+    if (!read_inode(fs, inode_id, &inode)) return ZOSFS_EIO;
+
+    //druh cíle musí odpovídat příkazu
+    if (inode.is_directory && !directory) return ZOSFS_EISDIR;
+    if (!inode.is_directory && directory) return ZOSFS_ENOTDIR;
+
+    if (directory) {
+        //počet položek udržuje index adresáře
+        int32_t count = dir_entry_count(fs, inode_id);
+        if (count < 0) return ZOSFS_EIO;
+        if (count > 0) return ZOSFS_ENOTEMPTY;
+    }
+
+    //nejdřív odstranění z nadřazeného adresáře - položka nesmí ukazovat na uvolněný i-uzel
+    if (!remove_from_dir(fs, parent_inode, name)) return ZOSFS_EIO;
+
+    //uvolnění clusterů (sdílené jen sníží čítač) a i-uzlu
+    free_file_clusters(fs, &inode);
+    free_inode(fs, inode_id);
+    if (directory) {
+        directory_count_changed(fs, -1);
+        forget_dir(fs, inode_id);
+    }
+    return ZOSFS_OK;
+}
+
+// smazání souboru nebo adresáře podle cesty
+static zosfs_status_t remove_path(session_t *session, const char *path, bool directory) {
+    inode_lock_set_t locks;
+    int32_t inode_id, parent_inode;
+    char name[NAME_SIZE];
+    zosfs_status_t status = lock_remove(session, path, &locks, &inode_id, &parent_inode, name);
+    if (status != ZOSFS_OK) return status;
+
+    status = remove_locked(session->fs, inode_id, parent_inode, name, directory);
+    lock_set_release(session->fs, &locks);
+    return status;
+}
+
+zosfs_status_t zosfs_unlink(session_t *session, const char *path) {
+    return remove_path(session, path, false);
+}
+
+zosfs_status_t zosfs_rmdir(session_t *session, const char *path) {
+    return remove_path(session, path, true);
+}
+
+zosfs_status_t zosfs_rename(session_t *session, const char *src_path, const char *dest_path) {
+    filesystem_t *fs = session->fs;
+    int32_t src_parent, src_id;
+    char src_name[NAME_SIZE];
+    if (!src_path || !src_path[0] || !dest_path || !dest_path[0]) return ZOSFS_ENOENT;
+
+    if (!split_path(fs, session->current_inode, src_path, &src_parent, src_name)) return ZOSFS_ENOENT;
+    src_id = find_in_dir(fs, src_parent, src_name);
+    if (src_id <= 0) return ZOSFS_ENOENT;
+
+    int32_t dest_parent;
+    char dest_name[NAME_SIZE];
+
+    //existující adresář jako cíl - přesun do něj pod stejným jménem
+    int32_t dest_check = resolve_path(fs, session->current_inode, dest_path);
+    if (dest_check >= 0) {
+        inode_t d_node;
+        if (!read_inode(fs, dest_check, &d_node)) return ZOSFS_EIO;
+        if (!d_node.is_directory) return ZOSFS_EEXIST;
+        dest_parent = dest_check;
+        strcpy(dest_name, src_name);
+    } else if (!split_path(fs, session->current_inode, dest_path, &dest_parent, dest_name)) {
+        return ZOSFS_ENOENT;
+    }
+
+    inode_lock_set_t locks;
+    lock_set_init(&locks);
+    lock_set_add(&locks, src_parent, true);
+    lock_set_add(&locks, dest_parent, true);
+    lock_set_add(&locks, src_id, true);
+    if (!lock_set_acquire_checked(fs, &locks)) return ZOSFS_ENOENT;
+
+    //položka se mohla mezi vyhledáním a zamčením změnit
+    zosfs_status_t status = ZOSFS_OK;
+    if (find_in_dir(fs, src_parent, src_name) != src_id) {
+        status = ZOSFS_ENOENT;
+    } else if (find_in_dir(fs, dest_parent, dest_name) >= 0) {
+        status = ZOSFS_EEXIST;
+    } else if (!remove_from_dir(fs, src_parent, src_name)) {
+        status = ZOSFS_EIO;
+    } else if (!add_to_dir(fs, dest_parent, dest_name, src_id)) {
+        //cílový adresář nejde prodloužit - položka se vrátí na původní místo
+        add_to_dir(fs, src_parent, src_name, src_id);
+        status = ZOSFS_ENOSPC;
+    }
+    lock_set_release(fs, &locks);
+    return status;
+}
+
+const char *zosfs_strerror(zosfs_status_t status) {
+    switch (status) {
+        case ZOSFS_OK: return "OK";
+        case ZOSFS_ENOENT: return "FILE NOT FOUND";
+        case ZOSFS_EEXIST: return "EXIST";
+        case ZOSFS_ENOTDIR: return "ERROR - TARGET IS NOT A DIRECTORY";
+        case ZOSFS_EISDIR: return "ERROR - TARGET IS A DIRECTORY";
+        case ZOSFS_ENOTEMPTY: return "ERROR - DIRECTORY IS NOT EMPTY";
+        case ZOSFS_ENOSPC: return "CANNOT CREATE FILE";
+        case ZOSFS_EFBIG: return "FILE TOO LARGE";
+        case ZOSFS_EINVAL: return "INVALID ARGUMENT";
+        case ZOSFS_ENOMEM: return "OUT OF MEMORY";
+        case ZOSFS_EIO: return "I/O ERROR";
+        case ZOSFS_ENOTSUP: return "NOT SUPPORTED";
+        case ZOSFS_ENOTFORMATTED: return "FILESYSTEM NOT FORMATTED";
+    }
+    return "UNKNOWN ERROR";
+}
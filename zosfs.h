@@ -0,0 +1,175 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+// Knihovna libzosfs - operace nad fs bez výpisů na konzoli. Výsledkem je stavový kód,
+// data se předávají přes buffery volajícího. Cesty jsou relativní k aktuálnímu adresáři sezení.
+
+
+// Připojený obraz a sezení nad ním, obsah zná jen knihovna
+typedef struct zosfs zosfs_t;
+typedef struct zosfs_session zosfs_session_t;
+
+// maximální délka jména položky včetně ukončovací nuly (8+3)
+#define ZOSFS_NAME_SIZE 12
+
+// Výsledek operace
+typedef enum {
+    ZOSFS_OK = 0,
+    ZOSFS_ENOENT,               //soubor nebo cesta neexistuje
+    ZOSFS_EEXIST,               //cíl už existuje
+    ZOSFS_ENOTDIR,              //cesta nepředstavuje adresář
+    ZOSFS_EISDIR,               //cesta představuje adresář
+    ZOSFS_ENOTEMPTY,            //adresář není prázdný
+    ZOSFS_ENOSPC,               //došly volné i-uzly nebo clustery
+    ZOSFS_EFBIG,                //soubor by byl větší, než formát dovoluje
+    ZOSFS_EINVAL,               //neplatný argument
+    ZOSFS_ENOMEM,
+    ZOSFS_EIO,                  //chyba čtení nebo zápisu obrazu
+    ZOSFS_ENOTSUP,              //obraz danou vlastnost nepodporuje
+    ZOSFS_ENOTFORMATTED         //obraz není naformátovaný
+} zosfs_status_t;
+
+// Kdy se změny metadat zapisují na disk
+typedef enum {
+    ZOSFS_SYNC_ALWAYS,          //po každé změně
+    ZOSFS_SYNC_COMMAND,         //na konci každé operace
+    ZOSFS_SYNC_MANUAL           //pouze voláním zosfs_sync a při odpojení
+} zosfs_sync_policy_t;
+
+// Způsob přístupu k souboru obrazu
+typedef enum {
+    ZOSFS_ENGINE_STDIO,         //pozicované čtení a zápis přes cache clusterů
+    ZOSFS_ENGINE_MMAP           //celý obraz namapovaný do paměti
+} zosfs_engine_t;
+
+// Nastavení připojení obrazu
+typedef struct {
+    zosfs_sync_policy_t sync_policy;
+    size_t cache_size;          //rozpočet cache clusterů a indexů adresářů v bytech
+    zosfs_engine_t engine;
+    int journal_group;          //počet transakcí žurnálu na jeden fdatasync
+} zosfs_options_t;
+
+// Co se stalo při připojení
+typedef struct {
+    bool created;               //soubor obrazu neexistoval a byl vytvořen
+    int32_t replayed;           //počet přehraných transakcí žurnálu, -1 = žurnál nelze přehrát
+    bool mmap_failed;           //mmap selhal, používá se stdio
+    bool unsupported;           //ZOSFS_ENOTFORMATTED kvůli neznámé verzi formátu v superbloku
+    int32_t version;            //ta neznámá verze
+} zosfs_mount_info_t;
+
+// Otevřený soubor - jen číslo i-uzlu, smazáním souboru se popisovač zneplatní (ZOSFS_ENOENT)
+typedef struct {
+    int32_t inode;
+} zosfs_file_t;
+
+// Položka adresáře
+typedef struct {
+    char name[ZOSFS_NAME_SIZE];
+    int32_t inode;
+    bool is_directory;
+} zosfs_dirent_t;
+
+// Informace o souboru nebo adresáři
+typedef struct {
+    int32_t inode;
+    bool is_directory;
+    int64_t size;
+    int32_t clusters;           //počet datových clusterů podle velikosti
+    int32_t references;
+} zosfs_stat_t;
+
+// Informace o celém fs
+typedef struct {
+    int64_t disk_size;
+    int32_t cluster_size;
+    int32_t cluster_count;      //bez rezervovaného clusteru 0
+    int32_t used_clusters;
+    int32_t free_clusters;
+    int32_t inode_count;
+    int32_t used_inodes;
+    int32_t free_inodes;
+    int32_t dir_count;
+} zosfs_statfs_t;
+
+// Přenosy mezi procesem a obrazem od připojení (rozdíl dvou volání = přenosy operace)
+typedef struct {
+    uint64_t bytes_read;
+    uint64_t bytes_written;     //včetně logu žurnálu
+    uint64_t syncs;             //počet fdatasync žurnálu
+} zosfs_io_stats_t;
+
+// funkce rozhraní knihovny, ostatní symboly libzosfs.so jsou skryté (-fvisibility=hidden)
+#define ZOSFS_API __attribute__((visibility("default")))
+
+
+// Výchozí nastavení připojení
+ZOSFS_API void zosfs_default_options(zosfs_options_t *options);
+
+// Otevře (případně vytvoří) obraz, načte fs a připojený obraz vrátí v *fs. ZOSFS_ENOTFORMATTED znamená,
+// že obraz je připojený, ale před použitím se musí naformátovat, ZOSFS_EIO s info->replayed < 0
+// nepřehratelný žurnál. Při jiném výsledku je *fs NULL. Jméno obrazu musí platit až do odpojení, info může být NULL
+ZOSFS_API zosfs_status_t zosfs_mount(const char *image, const zosfs_options_t *options, zosfs_t **fs, zosfs_mount_info_t *info);
+
+// Uloží změny a uvolní vše, co patří k připojenému obrazu, včetně fs samotného. Sezení musí být zavřená
+ZOSFS_API void zosfs_unmount(zosfs_t *fs);
+
+// Otevře sezení s aktuálním adresářem v kořeni, vrátí ho v *session
+ZOSFS_API zosfs_status_t zosfs_session_open(zosfs_t *fs, zosfs_session_t **session);
+
+// Zavře sezení, fs zůstává připojený
+ZOSFS_API void zosfs_session_close(zosfs_session_t *session);
+
+// Naformátuje obraz na size bytů, aktuální adresář sezení se přesune do kořene
+ZOSFS_API zosfs_status_t zosfs_format(zosfs_session_t *session, int64_t size);
+
+// Uloží všechny změny a transakce žurnálu na disk
+ZOSFS_API zosfs_status_t zosfs_sync(zosfs_t *fs);
+
+// Změní aktuální adresář sezení
+ZOSFS_API zosfs_status_t zosfs_chdir(zosfs_session_t *session, const char *path);
+
+// Otevře existující soubor
+ZOSFS_API zosfs_status_t zosfs_open(zosfs_session_t *session, const char *path, zosfs_file_t *file);
+
+// Vytvoří nový prázdný soubor a otevře ho
+ZOSFS_API zosfs_status_t zosfs_create(zosfs_session_t *session, const char *path, zosfs_file_t *file);
+
+// Přečte až size bytů od offset do buffer, počet přečtených bytů (0 na konci souboru) vrací v *done
+ZOSFS_API zosfs_status_t zosfs_read(zosfs_t *fs, const zosfs_file_t *file, int64_t offset, void *buffer, size_t size, size_t *done);
+
+// Zapíše size bytů od offset, soubor se podle potřeby prodlouží (mezera se vyplní nulami),
+// sdílené clustery se před zápisem zkopírují. Počet zapsaných bytů vrací v *done (done může být NULL)
+ZOSFS_API zosfs_status_t zosfs_write(zosfs_t *fs, const zosfs_file_t *file, int64_t offset, const void *buffer, size_t size, size_t *done);
+
+// Přečte až capacity položek adresáře. *cursor je pozice v adresáři (na začátku 0), po volání ukazuje
+// za poslední vrácenou položku. Počet položek vrací v *count, 0 = konec adresáře
+ZOSFS_API zosfs_status_t zosfs_readdir(zosfs_session_t *session, const char *path, int32_t *cursor,
+                             zosfs_dirent_t *entries, int32_t capacity, int32_t *count);
+
+// Informace o souboru nebo adresáři
+ZOSFS_API zosfs_status_t zosfs_stat(zosfs_session_t *session, const char *path, zosfs_stat_t *stat);
+
+// Informace o celém fs (konstantní čas, počty se udržují při alokaci)
+ZOSFS_API void zosfs_statfs(zosfs_t *fs, zosfs_statfs_t *stat);
+
+// Počty bytů přečtených z obrazu a zapsaných do něj
+ZOSFS_API void zosfs_io_stats(zosfs_t *fs, zosfs_io_stats_t *stats);
+
+// Vytvoří adresář
+ZOSFS_API zosfs_status_t zosfs_mkdir(zosfs_session_t *session, const char *path);
+
+// Smaže prázdný adresář
+ZOSFS_API zosfs_status_t zosfs_rmdir(zosfs_session_t *session, const char *path);
+
+// Smaže soubor
+ZOSFS_API zosfs_status_t zosfs_unlink(zosfs_session_t *session, const char *path);
+
+// Přesune nebo přejmenuje soubor či adresář, existující adresář jako cíl znamená přesun do něj
+ZOSFS_API zosfs_status_t zosfs_rename(zosfs_session_t *session, const char *src_path, const char *dest_path);
+
+// Text stavového kódu ve stylu hlášek konzole
+ZOSFS_API const char *zosfs_strerror(zosfs_status_t status);